@@ -0,0 +1,206 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <elf.h>
+#include <link.h>
+
+/**
+ * Minimal helpers shared by the benchmarks
+ */
+
+/**
+ * Prevent the compiler from optimizing away a value.  Anything
+ * bigger than a register is passed in memory: letting the compiler
+ * pick a register would make it copy the whole object (e.g. a 1.5 KB
+ * buffer) into the timed code.
+ */
+template<typename T>
+inline void doNotOptimize(const T& val) {
+    if constexpr (sizeof(T) <= sizeof(void*) && std::is_trivially_copyable_v<T>) {
+        asm volatile("" : : "r,m"(val) : "memory");
+    } else {
+        asm volatile("" : : "m"(val) : "memory");
+    }
+}
+
+/**
+ * Run the given function the given number of times and
+ * return the average nanoseconds per run
+ */
+template<typename F>
+double nsPerOp(std::size_t iterations, F&& f) {
+    // Warm up caches and branch predictors
+    for (std::size_t i = 0; i < iterations / 10 + 1; ++i) {
+        f();
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        f();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+inline void report(const char* name, double ns) {
+    printf("%-48s %10.2f ns/op %12.0f ops/s\n", name, ns, 1e9 / ns);
+}
+
+inline void reportThroughput(const char* name, double ns, std::size_t bytesPerOp) {
+    printf("%-48s %10.2f ns/op %10.2f GB/s\n", name, ns, bytesPerOp / ns);
+}
+
+/**
+ * For looking at the code a benchmark was compiled to, from the
+ * executable's own ELF image.  Nothing is found if the binary was
+ * stripped.
+ */
+namespace detail {
+    inline std::vector<char> selfImage() {
+        std::ifstream file("/proc/self/exe", std::ios::binary);
+        return std::vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+
+    // Addresses in the image are relative to where the executable
+    //  is loaded, which comes first in the list of loaded objects
+    inline uintptr_t loadBase() {
+        uintptr_t base = 0;
+        dl_iterate_phdr([](dl_phdr_info* info, std::size_t, void* data) {
+            *static_cast<uintptr_t*>(data) = info->dlpi_addr;
+            return 1;
+        }, &base);
+        return base;
+    }
+
+    // The image's section headers, or an empty span if they're missing
+    inline std::span<const ElfW(Shdr)> sections(const std::vector<char>& image) {
+        if (image.size() < sizeof(ElfW(Ehdr))) {
+            return {};
+        }
+        auto* header = reinterpret_cast<const ElfW(Ehdr)*>(image.data());
+        if (header->e_shoff + header->e_shnum * sizeof(ElfW(Shdr)) > image.size()) {
+            return {};
+        }
+        return { reinterpret_cast<const ElfW(Shdr)*>(image.data() + header->e_shoff), header->e_shnum };
+    }
+}
+
+/**
+ * The size of the function's code from the executable's own symbol
+ * table, or 0 if it isn't there
+ */
+inline std::size_t codeLength(const void* function) {
+    auto image = detail::selfImage();
+    uintptr_t address = reinterpret_cast<uintptr_t>(function) - detail::loadBase();
+    for (const ElfW(Shdr)& section : detail::sections(image)) {
+        if (section.sh_type != SHT_SYMTAB || section.sh_offset + section.sh_size > image.size()) {
+            continue;
+        }
+        auto* symbols = reinterpret_cast<const ElfW(Sym)*>(image.data() + section.sh_offset);
+        for (std::size_t i = 0; i < section.sh_size / sizeof(ElfW(Sym)); ++i) {
+            if (ELF64_ST_TYPE(symbols[i].st_info) == STT_FUNC && symbols[i].st_value == address) {
+                return symbols[i].st_size;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Whether the function's code (length bytes, see codeLength) calls
+ * or tail calls the named shared library function (x86-64 only).
+ * Calls to it go through its GOT slot: either directly (call
+ * *slot(%rip), with -fno-plt) or via a PLT stub (jmp *slot(%rip)),
+ * so every rel32 call or jmp whose target is in a PLT section is
+ * followed to its stub.  Only following targets in the PLT keeps a
+ * stray 0xE8 inside another instruction from being read as a call
+ * to anywhere else.
+ */
+inline bool callsFunction(const void* function, std::size_t length, const char* name) {
+    auto image = detail::selfImage();
+    auto all = detail::sections(image);
+    uintptr_t base = detail::loadBase();
+    auto* header = reinterpret_cast<const ElfW(Ehdr)*>(image.data());
+    if (all.empty() || header->e_machine != EM_X86_64 || header->e_shstrndx >= all.size()) {
+        return false;
+    }
+    const char* sectionNames = image.data() + all[header->e_shstrndx].sh_offset;
+
+    // The function's GOT slot, from its dynamic relocation
+    uintptr_t slot = 0;
+    std::vector<std::pair<uintptr_t, uintptr_t>> plt;
+    for (const ElfW(Shdr)& section : all) {
+        std::string_view sectionName = sectionNames + section.sh_name;
+        if (sectionName.starts_with(".plt")) {
+            plt.emplace_back(base + section.sh_addr, base + section.sh_addr + section.sh_size);
+        }
+        if (section.sh_type != SHT_RELA || section.sh_link >= all.size()) {
+            continue;
+        }
+        const ElfW(Shdr)& symbolSection = all[section.sh_link];
+        auto* symbols = reinterpret_cast<const ElfW(Sym)*>(image.data() + symbolSection.sh_offset);
+        const char* names = image.data() + all[symbolSection.sh_link].sh_offset;
+        auto* relocations = reinterpret_cast<const ElfW(Rela)*>(image.data() + section.sh_offset);
+        for (std::size_t i = 0; i < section.sh_size / sizeof(ElfW(Rela)); ++i) {
+            std::size_t symbol = ELF64_R_SYM(relocations[i].r_info);
+            if (symbol != 0 && strcmp(names + symbols[symbol].st_name, name) == 0) {
+                slot = base + relocations[i].r_offset;
+            }
+        }
+    }
+    if (slot == 0) {
+        return false;
+    }
+
+    // The address an indirect jmp/call through rip at code refers to
+    auto indirectSlot = [](const uint8_t* code) {
+        int32_t displacement;
+        memcpy(&displacement, code + 2, sizeof(displacement));
+        return reinterpret_cast<uintptr_t>(code + 6) + displacement;
+    };
+    auto inPlt = [&](uintptr_t address) {
+        for (auto [begin, end] : plt) {
+            if (address >= begin && address + 16 <= end) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    auto* code = static_cast<const uint8_t*>(function);
+    for (std::size_t i = 0; i + 6 <= length; ++i) {
+        if (code[i] == 0xFF && code[i + 1] == 0x15 && indirectSlot(code + i) == slot) {
+            return true;
+        }
+        if (code[i] != 0xE8 && code[i] != 0xE9) {
+            continue;
+        }
+        int32_t rel;
+        memcpy(&rel, code + i + 1, sizeof(rel));
+        uintptr_t target = reinterpret_cast<uintptr_t>(code + i + 5) + rel;
+        if (!inPlt(target)) {
+            continue;
+        }
+        // A stub is an optional endbr64 then a (bnd) jmp *slot(%rip)
+        auto* stub = reinterpret_cast<const uint8_t*>(target);
+        for (std::size_t j = 0; j + 6 <= 16; ++j) {
+            if (stub[j] == 0xFF && stub[j + 1] == 0x25) {
+                if (indirectSlot(stub + j) == slot) {
+                    return true;
+                }
+                break;
+            }
+        }
+    }
+    return false;
+}
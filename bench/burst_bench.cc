@@ -0,0 +1,126 @@
+#include "bench.hpp"
+#include "burst.hpp"
+#include "dns.hpp"
+#include "network_buffer.hpp"
+#include "rtp.hpp"
+#include "tlv.hpp"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+/**
+ * Parses bursts of 32 buffers picked at random from ~100 MB of
+ * buffers (far more than L2, or any cache), so every buffer's headers
+ * are a cache miss, walking each burst with a plain loop and with
+ * forEachPrefetched at several distances.  Reports time per buffer.
+ */
+namespace {
+    using Buffer = NetworkBuffer<1500>;
+    constexpr std::size_t poolSize = 65536;
+    constexpr std::size_t burstSize = 32;
+    constexpr std::size_t bursts = 1 << 15;
+
+    void writeRtp(Buffer& buffer, uint16_t seq) {
+        buffer.write(static_cast<uint8_t>(0x90));
+        buffer.write(static_cast<uint8_t>(96));
+        buffer.write(seq);
+        buffer.write(static_cast<uint32_t>(seq * 960));
+        buffer.write(static_cast<uint32_t>(0x12345678));
+        // One-byte header extensions: audio level and a transport sequence number
+        const uint8_t extension[] = { 0xBE, 0xDE, 0x00, 0x02, 0x10, 0x7F, 0x21, 0x00, 0x01, 0x00, 0x00, 0x00 };
+        buffer.write(extension, sizeof(extension));
+        uint8_t payload[160] = {};
+        buffer.write(payload, sizeof(payload));
+    }
+
+    void writeDns(Buffer& buffer, uint16_t id) {
+        DnsWriter writer(buffer);
+        writer.writeHeader({id, 0x0100, 1, 0, 0, 0});
+        writer.writeQuestion("www.example.com", 1);
+    }
+
+    void writeStun(Buffer& buffer, uint16_t) {
+        using Writer = TlvWriter<StunAttributeFormat>;
+        uint8_t header[20] = { 0x00, 0x01, 0x00, 0x00, 0x21, 0x12, 0xA4, 0x42 };
+        buffer.write(header, sizeof(header));
+        const char username[] = "abcd:efgh";
+        Writer::write(buffer, 0x0006, {reinterpret_cast<const uint8_t*>(username), 9});
+        uint8_t priority[4] = { 0x6e, 0x00, 0x01, 0xff };
+        Writer::write(buffer, 0x0024, priority);
+        uint8_t tieBreaker[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+        Writer::write(buffer, 0x802A, tieBreaker);
+        uint8_t integrity[20] = {};
+        Writer::write(buffer, 0x0008, integrity);
+    }
+
+    uint32_t parseRtp(Buffer& buffer) {
+        auto rtp = RtpPacket::parse(buffer);
+        auto level = rtp->findExtension(1);
+        return rtp->sequenceNumber() + (level ? (*level)[0] : 0);
+    }
+
+    uint32_t parseDns(Buffer& buffer) {
+        DnsReader reader(buffer);
+        auto header = reader.header();
+        auto question = reader.question();
+        return header->id + question->type;
+    }
+
+    uint32_t parseStun(Buffer& buffer) {
+        TlvReader<StunAttributeFormat> reader(buffer.getBuffer() + 20, buffer.size() - 20);
+        uint32_t sum = 0;
+        while (auto attribute = reader.next()) {
+            sum += attribute->type;
+        }
+        return sum;
+    }
+
+    template<typename Write, typename Parse>
+    void run(const char* protocol, Write&& write, Parse&& parse) {
+        auto pool = std::make_unique<Buffer[]>(poolSize);
+        for (std::size_t i = 0; i < poolSize; ++i) {
+            write(pool[i], static_cast<uint16_t>(i));
+        }
+        std::mt19937 rng(1234);
+        std::uniform_int_distribution<std::size_t> pick(0, poolSize - 1);
+        std::vector<Buffer*> order(bursts * burstSize);
+        for (auto& buffer : order) {
+            buffer = &pool[pick(rng)];
+        }
+
+        char name[128];
+        std::size_t next = 0;
+        auto nextBurst = [&] {
+            std::span<Buffer*> burst(&order[next], burstSize);
+            next = (next + burstSize) % order.size();
+            return burst;
+        };
+        double ns = nsPerOp(bursts, [&] {
+            uint32_t sum = 0;
+            for (Buffer* buffer : nextBurst()) {
+                sum += parse(*buffer);
+            }
+            doNotOptimize(sum);
+        });
+        snprintf(name, sizeof(name), "%s, plain loop", protocol);
+        report(name, ns / burstSize);
+        for (std::size_t distance : { 1, 2, 4, 8, 16 }) {
+            ns = nsPerOp(bursts, [&] {
+                uint32_t sum = 0;
+                forEachPrefetched(nextBurst(), [&](Buffer& buffer) {
+                    sum += parse(buffer);
+                }, distance);
+                doNotOptimize(sum);
+            });
+            snprintf(name, sizeof(name), "%s, prefetch distance %zu", protocol, distance);
+            report(name, ns / burstSize);
+        }
+    }
+}
+
+int main() {
+    run("RTP", writeRtp, parseRtp);
+    run("DNS", writeDns, parseDns);
+    run("STUN TLV", writeStun, parseStun);
+}
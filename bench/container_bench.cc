@@ -0,0 +1,70 @@
+#include "bench.hpp"
+#include "network_buffer.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Standard container operations on buffers holding a typical 200 byte
+ * message.  With the positions kept as offsets the buffers are
+ * trivially copyable, so containers relocate them with plain memory
+ * copies (and the results are correct, which they weren't when the
+ * positions were pointers into the object).
+ */
+namespace {
+    using Buffer = NetworkBuffer<1500>;
+    static_assert(std::is_trivially_copyable_v<Buffer>);
+
+    constexpr std::size_t count = 1024;
+}
+
+int main() {
+    Buffer message;
+    std::vector<uint8_t> payload(200, 0x77);
+    message.write(payload.data(), payload.size());
+    message.read(20);
+
+    report("vector push_back, growing (per buffer)", nsPerOp(200, [&] {
+        std::vector<Buffer> buffers;
+        for (std::size_t i = 0; i < count; ++i) {
+            buffers.push_back(message);
+        }
+        doNotOptimize(buffers.data());
+    }) / count);
+
+    std::vector<Buffer> source(count, message);
+    report("vector copy (per buffer)", nsPerOp(200, [&] {
+        std::vector<Buffer> copy = source;
+        doNotOptimize(copy.data());
+    }) / count);
+
+    report("vector erase front, 256 buffers (per erase)", nsPerOp(200, [&] {
+        std::vector<Buffer> buffers(256, message);
+        while (!buffers.empty()) {
+            buffers.erase(buffers.begin());
+        }
+        doNotOptimize(buffers.data());
+    }) / 256);
+
+    report("deque push_back/pop_front (per buffer)", nsPerOp(200, [&] {
+        std::deque<Buffer> queue;
+        for (std::size_t i = 0; i < count; ++i) {
+            queue.push_back(message);
+            if (queue.size() > 64) {
+                queue.pop_front();
+            }
+        }
+        doNotOptimize(queue.front());
+    }) / count);
+
+    Buffer a = message;
+    Buffer b = message;
+    report("std::swap", nsPerOp(1'000'000, [&] {
+        std::swap(a, b);
+        doNotOptimize(a);
+    }));
+
+    printf("sizeof(NetworkBuffer<1500>) = %zu, alignof = %zu\n", sizeof(Buffer), alignof(Buffer));
+}
@@ -0,0 +1,94 @@
+#include "bench.hpp"
+#include "dns.hpp"
+#include "network_buffer.hpp"
+
+#include <string>
+#include <vector>
+
+/**
+ * Replays a mix of queries through the parse-and-match path of a
+ * forwarder (find the question and compare it against a table of
+ * names) and builds compressed responses.  Compared against parsing
+ * with read16/read(n) into std::strings.
+ */
+namespace {
+    const std::vector<std::string> names = {
+        "www.example.com", "api.example.com", "cdn.images.example.net",
+        "mail.google.com", "a.very.deeply.nested.subdomain.example.org",
+        "example.com", "www.wikipedia.org", "login.microsoftonline.com",
+    };
+
+    std::vector<NetworkBuffer<512>> buildQueries() {
+        std::vector<NetworkBuffer<512>> queries(names.size());
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            DnsWriter writer(queries[i]);
+            writer.writeHeader({static_cast<uint16_t>(i), 0x0100, 1, 0, 0, 0});
+            writer.writeQuestion(names[i], 1);
+        }
+        return queries;
+    }
+
+    std::string readNameAsString(NetworkBuffer<512>& buffer) {
+        std::string name;
+        while (uint8_t len = buffer.read8()) {
+            if (!name.empty()) {
+                name += '.';
+            }
+            name.append(reinterpret_cast<const char*>(buffer.read(len)), len);
+        }
+        return name;
+    }
+}
+
+int main() {
+    auto queries = buildQueries();
+    constexpr std::size_t iterations = 2'000'000;
+
+    std::size_t next = 0;
+    report("DnsReader question + match (per query)", nsPerOp(iterations, [&] {
+        auto& query = queries[next++ % queries.size()];
+        DnsReader reader(query);
+        reader.header();
+        auto question = reader.question();
+        std::size_t match = names.size();
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            if (question->name.equals(names[i])) {
+                match = i;
+                break;
+            }
+        }
+        doNotOptimize(match);
+    }));
+
+    report("read16/read(n) into std::string (per query)", nsPerOp(iterations, [&] {
+        NetworkBuffer<512> copy;
+        auto& query = queries[next++ % queries.size()];
+        copy.write(query.getBuffer(), query.size());
+        copy.read(12);
+        std::string name = readNameAsString(copy);
+        copy.read16();
+        copy.read16();
+        std::size_t match = names.size();
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            if (name == names[i]) {
+                match = i;
+                break;
+            }
+        }
+        doNotOptimize(match);
+    }));
+
+    uint8_t addr[4] = { 10, 0, 0, 1 };
+    report("DnsWriter response, 4 compressed answers", nsPerOp(iterations, [&] {
+        NetworkBuffer<512> response;
+        DnsWriter writer(response);
+        const std::string& name = names[next++ % names.size()];
+        writer.writeHeader({1, 0x8180, 1, 4, 0, 0});
+        writer.writeQuestion(name, 1);
+        writer.writeNameRecord(name, 5, 1, 300, "edge.cdn.example.net");
+        for (int i = 0; i < 3; ++i) {
+            writer.writeRecord("edge.cdn.example.net", 1, 1, 60, addr);
+        }
+        doNotOptimize(response);
+    }));
+}
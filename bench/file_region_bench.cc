@@ -0,0 +1,102 @@
+#include "bench.hpp"
+#include "file_region_writer.hpp"
+#include "network_buffer.hpp"
+
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Sends media-segment-like messages (a 32 byte header and a 1 MB file
+ * region) over loopback TCP, with the file in the page cache: read()
+ * into buffers and send them, versus FileRegionWriter with sendfile
+ * and with splice
+ */
+namespace {
+    constexpr std::size_t fileSize = 32 << 20;
+    constexpr std::size_t regionSize = 1 << 20;
+    constexpr std::size_t headerSize = 32;
+    constexpr std::size_t iterations = 500;
+
+    std::pair<int, int> tcpPair() {
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+        listen(listener, 1);
+        int client = socket(AF_INET, SOCK_STREAM, 0);
+        connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        int server = accept(listener, nullptr, nullptr);
+        close(listener);
+        return {client, server};
+    }
+
+    void writeHeader(NetworkBuffer<64>& header, std::size_t segment) {
+        for (std::size_t i = 0; i < headerSize / 8; ++i) {
+            header.write(static_cast<uint64_t>(segment));
+        }
+    }
+}
+
+int main() {
+    char path[] = "/tmp/file_region_bench_XXXXXX";
+    int file = mkstemp(path);
+    unlink(path);
+    std::vector<uint8_t> contents(fileSize, 0x5A);
+    write(file, contents.data(), contents.size());
+
+    auto [sender, receiver] = tcpPair();
+    std::atomic<bool> stop = false;
+    std::thread drain([receiver = receiver, &stop] {
+        std::vector<uint8_t> chunk(1 << 20);
+        while (!stop && recv(receiver, chunk.data(), chunk.size(), 0) > 0) {}
+    });
+
+    std::size_t segment = 0;
+    auto copyBuffer = std::make_unique<NetworkBuffer<65536>>();
+    reportThroughput("read() + send() through buffers", nsPerOp(iterations, [&] {
+        NetworkBuffer<64> header;
+        writeHeader(header, segment);
+        send(sender, header.getBuffer(), header.size(), MSG_MORE);
+        off_t offset = (segment++ * regionSize) % fileSize;
+        for (std::size_t done = 0; done < regionSize;) {
+            ssize_t res = pread(file, copyBuffer->getWriteBuffer(), copyBuffer->remainingCapacity(), offset + done);
+            copyBuffer->setSize(res);
+            while (!copyBuffer->empty()) {
+                copyBuffer->read(send(sender, copyBuffer->getBuffer(), copyBuffer->size(), 0));
+            }
+            copyBuffer->compact();
+            done += res;
+        }
+    }), headerSize + regionSize);
+
+    using Writer = FileRegionWriter<NetworkBuffer<64>>;
+    auto bench = [&](const char* name, Writer::Coalesce coalesce, Writer::Transfer transfer) {
+        Writer writer(sender, coalesce, transfer);
+        reportThroughput(name, nsPerOp(iterations, [&] {
+            NetworkBuffer<64> header;
+            writeHeader(header, segment);
+            writer.start(header, file, (segment++ * regionSize) % fileSize, regionSize);
+            while (!writer.done() && writer.send() >= 0) {}
+        }), headerSize + regionSize);
+    };
+    bench("FileRegionWriter sendfile + MSG_MORE", Writer::Coalesce::MsgMore, Writer::Transfer::Sendfile);
+    bench("FileRegionWriter sendfile + TCP_CORK", Writer::Coalesce::Cork, Writer::Transfer::Sendfile);
+    bench("FileRegionWriter splice + MSG_MORE", Writer::Coalesce::MsgMore, Writer::Transfer::Splice);
+
+    stop = true;
+    shutdown(sender, SHUT_WR);
+    drain.join();
+    close(sender);
+    close(receiver);
+    close(file);
+}
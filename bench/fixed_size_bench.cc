@@ -0,0 +1,95 @@
+#include "bench.hpp"
+#include "network_buffer.hpp"
+
+#include <array>
+#include <cstring>
+
+/**
+ * Writes and reads back the fixed-size fields of an Ethernet header
+ * and a STUN-like header (MAC addresses, a 12 byte transaction ID, a
+ * 16 byte ID) three ways: with write(buf, numBytes) where the lengths
+ * come from a table at run time (as generic field writers end up
+ * doing), with write(buf, numBytes) and constant lengths, and with
+ * the fixed-size overloads.  Reports each function's code size (from
+ * the symbol table) and whether it calls memcpy, then times them.
+ *
+ * Once inlined, write(buf, numBytes) with a constant length is
+ * already turned into fixed moves; the fixed-size overloads make
+ * that independent of what the optimizer can see, and check the
+ * size against the buffer at compile time.
+ */
+namespace {
+    using Buffer = NetworkBuffer<1500>;
+
+    struct Fields {
+        uint8_t dst[6];
+        uint8_t src[6];
+        uint8_t transactionId[12];
+        std::array<uint8_t, 16> id;
+    };
+
+    const Fields fields = {
+        { 0x02, 0x42, 0xAC, 0x11, 0x00, 0x02 },
+        { 0x02, 0x42, 0xAC, 0x11, 0x00, 0x03 },
+        { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 },
+        { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 },
+    };
+
+    const std::size_t fieldLengths[] = { 6, 6, 12, 16 };
+
+    // noipa: otherwise the compiler propagates the lengths in and
+    //  this compiles to the same code as constantLengths
+    __attribute__((noipa)) uint32_t runtimeLengths(Buffer& buffer, const Fields& f, const std::size_t* lengths) {
+        buffer.write(f.dst, lengths[0]);
+        buffer.write(f.src, lengths[1]);
+        buffer.write(f.transactionId, lengths[2]);
+        buffer.write(f.id.data(), lengths[3]);
+        uint32_t sum = buffer.read(lengths[0])[5] + buffer.read(lengths[1])[5];
+        sum += buffer.read(lengths[2])[11] + buffer.read(lengths[3])[15];
+        return sum;
+    }
+
+    __attribute__((noinline)) uint32_t constantLengths(Buffer& buffer, const Fields& f, const std::size_t*) {
+        buffer.write(f.dst, 6);
+        buffer.write(f.src, 6);
+        buffer.write(f.transactionId, 12);
+        buffer.write(f.id.data(), 16);
+        uint32_t sum = buffer.read(6)[5] + buffer.read(6)[5];
+        sum += buffer.read(12)[11] + buffer.read(16)[15];
+        return sum;
+    }
+
+    __attribute__((noinline)) uint32_t fixedSize(Buffer& buffer, const Fields& f, const std::size_t*) {
+        buffer.write(f.dst);
+        buffer.write(f.src);
+        buffer.write(f.transactionId);
+        buffer.write(f.id);
+        uint32_t sum = buffer.read<6>()[5] + buffer.read<6>()[5];
+        sum += buffer.read<12>()[11] + buffer.read<16>()[15];
+        return sum;
+    }
+
+    using Function = uint32_t (*)(Buffer&, const Fields&, const std::size_t*);
+
+    void run(const char* name, Function function) {
+        auto* code = reinterpret_cast<const void*>(function);
+        std::size_t length = codeLength(code);
+        if (length == 0) {
+            printf("%-48s can't inspect code, no symbol table\n", name);
+        } else {
+            printf("%-48s %10zu bytes of code%s\n", name, length,
+                   callsFunction(code, length, "memcpy") ? ", calls memcpy" : "");
+        }
+        Buffer buffer;
+        report(name, nsPerOp(10'000'000, [&] {
+            doNotOptimize(function(buffer, fields, fieldLengths));
+            buffer.compact();
+        }));
+    }
+}
+
+int main() {
+    run("Runtime lengths", runtimeLengths);
+    run("Constant lengths, write(buf, numBytes)", constantLengths);
+    run("Fixed-size overloads", fixedSize);
+}
@@ -0,0 +1,133 @@
+#include "bench.hpp"
+#include "fragment_reassembler.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Reassembles a stream of IPv4 fragments: 9000 byte datagrams in 7
+ * fragments, 16 in flight at a time with their fragments shuffled
+ * together.  In the adversarial mix, a quarter of the datagrams get an
+ * extra fragment overlapping another and a stream of first fragments
+ * that never complete is mixed in.  Compared against collecting each
+ * fragment in a vector and copying them all out once complete.
+ */
+namespace {
+    constexpr std::size_t datagramSize = 9000;
+    constexpr std::size_t fragmentSize = 1480;
+    constexpr std::size_t inFlight = 16;
+    constexpr std::size_t datagrams = 4096;
+
+    std::vector<uint8_t> ipv4Fragment(uint16_t id, std::size_t offset, bool more, const uint8_t* data, std::size_t size) {
+        NetworkBuffer<2048> packet;
+        packet.write(static_cast<uint8_t>(0x45));
+        packet.write(static_cast<uint8_t>(0));
+        packet.write(static_cast<uint16_t>(20 + size));
+        packet.write(id);
+        packet.write(static_cast<uint16_t>((more ? 0x2000 : 0) | (offset / 8)));
+        packet.write(static_cast<uint8_t>(64));
+        packet.write(static_cast<uint8_t>(17));
+        packet.write(static_cast<uint16_t>(0));
+        packet.write(static_cast<uint32_t>(0x0A000001));
+        packet.write(static_cast<uint32_t>(0x0A000002));
+        packet.write(data, size);
+        return std::vector<uint8_t>(packet.getBuffer(), packet.getBuffer() + packet.size());
+    }
+
+    std::vector<std::vector<uint8_t>> buildStream(bool adversarial) {
+        std::mt19937 rng(42);
+        std::vector<uint8_t> payload(datagramSize, 0x33);
+        std::vector<std::vector<uint8_t>> stream;
+        uint16_t junkId = 40000;
+        for (std::size_t group = 0; group < datagrams / inFlight; ++group) {
+            std::vector<std::vector<uint8_t>> fragments;
+            for (std::size_t i = 0; i < inFlight; ++i) {
+                uint16_t id = static_cast<uint16_t>(group * inFlight + i);
+                for (std::size_t offset = 0; offset < datagramSize; offset += fragmentSize) {
+                    std::size_t size = std::min(fragmentSize, datagramSize - offset);
+                    fragments.push_back(ipv4Fragment(id, offset, offset + size < datagramSize, payload.data() + offset, size));
+                }
+                if (adversarial && i % 4 == 0) {
+                    fragments.push_back(ipv4Fragment(id, fragmentSize - 8, true, payload.data(), 16));
+                }
+                if (adversarial) {
+                    fragments.push_back(ipv4Fragment(junkId++, 0, true, payload.data(), fragmentSize));
+                }
+            }
+            std::shuffle(fragments.begin(), fragments.end(), rng);
+            for (auto& fragment : fragments) {
+                stream.push_back(std::move(fragment));
+            }
+        }
+        return stream;
+    }
+
+    struct Collected {
+        std::vector<std::pair<std::size_t, std::vector<uint8_t>>> fragments;
+        std::size_t received = 0;
+        std::size_t total = 0;
+    };
+
+    void run(const char* name, bool adversarial) {
+        auto stream = buildStream(adversarial);
+        auto reassembler = std::make_unique<FragmentReassembler<>>(std::chrono::milliseconds(1));
+        std::size_t completed = 0;
+        std::size_t iterations = 4;
+
+        double ns = nsPerOp(iterations, [&] {
+            auto now = FragmentReassembler<>::Clock::now();
+            for (std::size_t i = 0; i < stream.size(); ++i) {
+                auto fragment = FragmentReassembler<>::parseIpv4(stream[i]);
+                if (auto datagram = reassembler->add(*fragment, now)) {
+                    completed += datagram->buffer->size() == datagramSize;
+                }
+                if (i % 1024 == 0) {
+                    // Let the junk time out
+                    reassembler->expire(now + std::chrono::milliseconds(2));
+                }
+            }
+        });
+        char label[128];
+        snprintf(label, sizeof(label), "FragmentReassembler, %s (per fragment)", name);
+        report(label, ns / stream.size());
+        doNotOptimize(completed);
+
+        std::unordered_map<uint64_t, Collected> pending;
+        std::vector<uint8_t> out;
+        double baselineNs = nsPerOp(iterations, [&] {
+            for (auto& packet : stream) {
+                auto fragment = FragmentReassembler<>::parseIpv4(packet);
+                uint64_t key = uint64_t(fragment->key.id) << 8 | fragment->key.protocol;
+                Collected& collected = pending[key];
+                collected.fragments.emplace_back(fragment->offset,
+                    std::vector<uint8_t>(fragment->payload.begin(), fragment->payload.end()));
+                collected.received += fragment->payload.size();
+                if (!fragment->moreFragments) {
+                    collected.total = fragment->offset + fragment->payload.size();
+                }
+                if (collected.total && collected.received >= collected.total) {
+                    out.resize(collected.total);
+                    for (auto& [offset, data] : collected.fragments) {
+                        if (offset + data.size() <= out.size()) {
+                            memcpy(out.data() + offset, data.data(), data.size());
+                        }
+                    }
+                    completed += out.size() == datagramSize;
+                    pending.erase(key);
+                }
+            }
+            pending.clear();
+        });
+        snprintf(label, sizeof(label), "vector per fragment + copy, %s (per fragment)", name);
+        report(label, baselineNs / stream.size());
+    }
+}
+
+int main() {
+    run("clean", false);
+    run("adversarial", true);
+}
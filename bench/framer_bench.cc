@@ -0,0 +1,88 @@
+#include "bench.hpp"
+#include "network_buffer.hpp"
+#include "stream_framer.hpp"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+/**
+ * Drives a framer with a stream of small length-prefixed messages
+ * delivered in randomly sized pieces, as TCP reads would be.
+ * Compared against copying the leftover partial message into a
+ * fresh buffer after every read.
+ */
+namespace {
+    constexpr std::size_t numMessages = 100'000;
+
+    std::vector<uint8_t> buildStream(std::mt19937& rng) {
+        std::uniform_int_distribution<std::size_t> msgSize(16, 200);
+        std::vector<uint8_t> stream;
+        for (std::size_t i = 0; i < numMessages; ++i) {
+            std::size_t len = msgSize(rng);
+            stream.push_back(static_cast<uint8_t>(len >> 8));
+            stream.push_back(static_cast<uint8_t>(len));
+            stream.insert(stream.end(), len, static_cast<uint8_t>(i));
+        }
+        return stream;
+    }
+
+    std::vector<std::size_t> buildReadSizes(std::mt19937& rng, std::size_t total) {
+        std::uniform_int_distribution<std::size_t> readSize(1, 4096);
+        std::vector<std::size_t> sizes;
+        for (std::size_t pos = 0; pos < total;) {
+            std::size_t len = std::min(readSize(rng), total - pos);
+            sizes.push_back(len);
+            pos += len;
+        }
+        return sizes;
+    }
+}
+
+int main() {
+    std::mt19937 rng(42);
+    auto stream = buildStream(rng);
+    auto readSizes = buildReadSizes(rng, stream.size());
+
+    auto framer = std::make_unique<StreamFramer<FixedHeaderDecoder<uint16_t>>>();
+    auto framerNs = nsPerOp(10, [&] {
+        std::size_t pos = 0;
+        std::size_t frames = 0;
+        for (auto len : readSizes) {
+            auto space = framer->writable();
+            memcpy(space.data(), stream.data() + pos, len);
+            framer->commit(len);
+            pos += len;
+            while (auto frame = framer->next()) {
+                frames += frame->size();
+            }
+        }
+        doNotOptimize(frames);
+    });
+    report("StreamFramer (per message)", framerNs / numMessages);
+
+    // The leftover bytes of each read are copied into a new buffer
+    auto copyNs = nsPerOp(10, [&] {
+        auto buffer = std::make_unique<NetworkBuffer<65536>>();
+        std::size_t pos = 0;
+        std::size_t frames = 0;
+        for (auto len : readSizes) {
+            buffer->write(stream.data() + pos, len);
+            pos += len;
+            while (buffer->size() >= 2) {
+                std::size_t msgLen = loadNetwork<uint16_t>(buffer->getBuffer());
+                if (buffer->size() < 2 + msgLen) {
+                    break;
+                }
+                buffer->read(2);
+                frames += msgLen;
+                buffer->read(msgLen);
+            }
+            auto next = std::make_unique<NetworkBuffer<65536>>();
+            next->write(buffer->getBuffer(), buffer->size());
+            buffer = std::move(next);
+        }
+        doNotOptimize(frames);
+    });
+    report("copy leftovers to a new buffer (per message)", copyNs / numMessages);
+}
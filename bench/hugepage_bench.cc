@@ -0,0 +1,69 @@
+#include "bench.hpp"
+#include "buffer_pool.hpp"
+#include "hugepage_arena.hpp"
+#include "network_buffer.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/**
+ * Touches the header of randomly chosen buffers in a pool of 1M
+ * NetworkBuffer<1500> (~1.5 GB) placed in an arena of 4 KB pages and
+ * in one of huge pages.  Each buffer is a cache miss either way; with
+ * 4 KB pages it's nearly always a TLB miss as well.  Also reports how
+ * long the arena took to map and fault in.
+ */
+namespace {
+    using Buffer = NetworkBuffer<1500>;
+    constexpr std::size_t poolSize = 1 << 20;
+    constexpr std::size_t accesses = 1 << 22;
+
+    void run(const char* name, HugePageArena::Pages pages, const std::vector<uint32_t>& order) {
+        auto start = std::chrono::steady_clock::now();
+        auto arena = HugePageArena::create(poolSize * sizeof(Buffer), pages);
+        double setupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!arena) {
+            printf("%s: couldn't map the arena\n", name);
+            return;
+        }
+        BufferPool<Buffer> pool(poolSize, *arena);
+        std::vector<BufferPool<Buffer>::Handle> handles;
+        handles.reserve(poolSize);
+        while (auto handle = pool.acquire()) {
+            (*handle)->write(static_cast<uint32_t>(handles.size()));
+            handles.push_back(std::move(*handle));
+        }
+
+        std::vector<Buffer*> buffers;
+        buffers.reserve(poolSize);
+        for (auto& handle : handles) {
+            buffers.push_back(&*handle);
+        }
+        double ns = nsPerOp(1, [&] {
+            uint64_t sum = 0;
+            for (uint32_t index : order) {
+                const Buffer& buffer = *buffers[index];
+                sum += buffer.size() + buffer.getBuffer()[0];
+            }
+            doNotOptimize(sum);
+        }) / order.size();
+
+        char label[128];
+        snprintf(label, sizeof(label), "%s (%zu huge pages)", name, arena->hugePages());
+        report(label, ns);
+        printf("  mapped and faulted %zu MB in %.0f ms\n", arena->size() >> 20, setupMs);
+    }
+}
+
+int main() {
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<uint32_t> pick(0, poolSize - 1);
+    std::vector<uint32_t> order(accesses);
+    for (auto& index : order) {
+        index = pick(rng);
+    }
+    run("Random buffer access, 4 KB pages", HugePageArena::Pages::Small, order);
+    run("Random buffer access, huge pages", HugePageArena::Pages::HugeTlb, order);
+}
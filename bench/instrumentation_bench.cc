@@ -0,0 +1,162 @@
+#include "bench.hpp"
+#include "buffer_instrumentation.hpp"
+#include "network_buffer.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#include <arpa/inet.h>
+
+/**
+ * Builds and parses an RTP-like header plus a small fixed payload
+ * in buffers with each instrumentation policy.  First checks that
+ * the default buffer compiles to exactly the same code as a copy of
+ * its read and write paths with no hook calls at all (which the
+ * compiler may even merge into one function), comparing the bytes
+ * of each instantiation as sized by the executable's symbol table.
+ * The round trip makes no calls, so its code doesn't depend on
+ * where it's placed.  Then times each against the hook-free copy.
+ */
+namespace {
+    /**
+     * NetworkBuffer's layout and the read/write code the round trip
+     * uses, as they were before instrumentation: nothing is called
+     * after the positions are updated
+     */
+    template<unsigned int BUF_SIZE>
+    class alignas(64) HookFreeBuffer {
+    public:
+        using Index = typename NetworkBuffer<BUF_SIZE>::Index;
+
+        HookFreeBuffer() :
+            _head(0), _tail(0) {}
+
+        void write(const uint8_t& val) {
+            _write(val);
+        }
+
+        void write(const uint16_t& val) {
+            uint16_t networkVal = htons(val);
+            _write(networkVal);
+        }
+
+        void write(const uint32_t& val) {
+            uint32_t networkVal = htonl(val);
+            _write(networkVal);
+        }
+
+        void write(const uint8_t* const buf, std::size_t numBytes) {
+            if (numBytes > 0) {
+                memcpy(_buffer + _tail, buf, numBytes);
+            }
+            _tail += numBytes;
+        }
+
+        uint8_t read8() {
+            return _read<uint8_t>();
+        }
+
+        uint16_t read16() {
+            uint16_t res = _read<uint16_t>();
+            return ntohs(res);
+        }
+
+        uint32_t read32() {
+            uint32_t res = _read<uint32_t>();
+            return ntohl(res);
+        }
+
+        uint8_t* read(std::size_t numBytes) {
+            uint8_t* currPos = _buffer + _head;
+            _head += numBytes;
+            return currPos;
+        }
+
+        void compact() {
+            if (_head == 0) {
+                return;
+            }
+            std::size_t len = _tail - _head;
+            memmove(_buffer, _buffer + _head, len);
+            _head = 0;
+            _tail = len;
+        }
+
+    private:
+        Index _head;
+        Index _tail;
+        uint8_t _buffer[BUF_SIZE];
+
+        template<typename T>
+        void _write(const T& val) {
+            memcpy(_buffer + _tail, &val, sizeof(T));
+            _tail += sizeof(T);
+        }
+
+        template<typename T>
+        T _read() {
+            T val;
+            memcpy(&val, _buffer + _head, sizeof(T));
+            _head += sizeof(T);
+            return val;
+        }
+    };
+
+    static_assert(sizeof(HookFreeBuffer<1500>) == sizeof(NetworkBuffer<1500>));
+
+    alignas(64) const uint8_t payload[32] = {};
+
+    template<typename Buffer>
+    __attribute__((noinline)) uint32_t roundTrip(Buffer& buffer) {
+        buffer.write(static_cast<uint8_t>(0x80));
+        buffer.write(static_cast<uint8_t>(96));
+        buffer.write(static_cast<uint16_t>(1234));
+        buffer.write(static_cast<uint32_t>(5678));
+        buffer.write(static_cast<uint32_t>(0xDEADBEEF));
+        buffer.write(payload, sizeof(payload));
+        uint32_t sum = buffer.read8() + buffer.read8() + buffer.read16();
+        sum += buffer.read32() + buffer.read32();
+        sum += buffer.read(sizeof(payload))[0];
+        return sum;
+    }
+
+    void compareCode(const char* name, const void* a, const void* b) {
+        if (a == b) {
+            printf("%s: merged into one function\n", name);
+            return;
+        }
+        std::size_t length = codeLength(a);
+        std::size_t otherLength = codeLength(b);
+        if (length == 0 || otherLength == 0) {
+            printf("%s: can't compare, no symbol table\n", name);
+        } else if (length == otherLength && memcmp(a, b, length) == 0) {
+            printf("%s: identical code (%zu bytes)\n", name, length);
+        } else {
+            printf("%s: different code (%zu vs %zu bytes)\n", name, length, otherLength);
+        }
+    }
+
+    template<typename Buffer>
+    void run(const char* name) {
+        Buffer buffer;
+        report(name, nsPerOp(10'000'000, [&] {
+            doNotOptimize(roundTrip(buffer));
+            buffer.compact();
+        }));
+    }
+}
+
+int main() {
+    using HookFree = HookFreeBuffer<1500>;
+    using Default = NetworkBuffer<1500>;
+    using Counting = NetworkBuffer<1500, CountingInstrumentation<>>;
+    auto* hookFreeCode = reinterpret_cast<const void*>(&roundTrip<HookFree>);
+    compareCode("No hooks vs default policy", hookFreeCode, reinterpret_cast<const void*>(&roundTrip<Default>));
+    compareCode("No hooks vs counting policy", hookFreeCode, reinterpret_cast<const void*>(&roundTrip<Counting>));
+
+    run<HookFree>("Round trip, no hooks");
+    run<Default>("Round trip, default");
+    run<Counting>("Round trip, per-thread counters");
+    run<NetworkBuffer<1500, HistogramInstrumentation>>("Round trip, histograms");
+    run<NetworkBuffer<1500, UsdtInstrumentation>>("Round trip, USDT probes (unattached)");
+}
@@ -0,0 +1,120 @@
+#include "bench.hpp"
+#include "network_buffer.hpp"
+#include "packet_builder.hpp"
+
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <vector>
+
+/**
+ * Builds IPv4/UDP packets with 64 and 1400 byte payloads: field by
+ * field with write(uint16_t)/write(uint32_t) and full checksums, with
+ * UdpFlow one packet at a time, and with UdpFlow::writeBatch 32 at a
+ * time.  Also sends them through a raw socket when one can be opened.
+ */
+namespace {
+    constexpr std::size_t batch = 32;
+
+    template<typename Buffer>
+    void writeFieldByField(Buffer& buffer, uint16_t id, const std::vector<uint8_t>& payload) {
+        uint8_t* start = buffer.getWriteBuffer();
+        uint16_t totalSize = 28 + payload.size();
+        buffer.write(static_cast<uint8_t>(0x45));
+        buffer.write(static_cast<uint8_t>(0));
+        buffer.write(totalSize);
+        buffer.write(id);
+        buffer.write(static_cast<uint16_t>(0x4000));
+        buffer.write(static_cast<uint8_t>(64));
+        buffer.write(static_cast<uint8_t>(17));
+        buffer.write(static_cast<uint16_t>(0));
+        buffer.write(static_cast<uint32_t>(0x0A000001));
+        buffer.write(static_cast<uint32_t>(0x0A000002));
+        buffer.write(static_cast<uint16_t>(5000));
+        buffer.write(static_cast<uint16_t>(6000));
+        buffer.write(static_cast<uint16_t>(totalSize - 20));
+        buffer.write(static_cast<uint16_t>(0));
+        buffer.write(payload.data(), payload.size());
+        checksum_detail::store(start + 10, checksum_detail::checksum(start, 20));
+        // Pseudo-header, then the UDP header and payload
+        uint64_t sum = checksum_detail::sum(start + 12, 8);
+        sum = checksum_detail::add(sum, toNetwork<uint16_t>(17));
+        sum = checksum_detail::add(sum, toNetwork<uint16_t>(totalSize - 20));
+        sum = checksum_detail::sum(start + 20, totalSize - 20, sum);
+        checksum_detail::store(start + 26, ~checksum_detail::fold(sum));
+    }
+
+    template<typename Buffer>
+    void reset(Buffer& buffer) {
+        buffer.clear();
+    }
+
+    void run(std::size_t payloadSize) {
+        std::vector<uint8_t> payload(payloadSize, 0x61);
+        std::vector<NetworkBuffer<1500>> buffers(batch);
+        std::size_t iterations = 100'000;
+        char name[128];
+
+        uint16_t id = 0;
+        double fieldNs = nsPerOp(iterations, [&] {
+            for (auto& buffer : buffers) {
+                reset(buffer);
+                writeFieldByField(buffer, id++, payload);
+            }
+            doNotOptimize(buffers[0]);
+        });
+        snprintf(name, sizeof(name), "field by field, %zu B payload (per packet)", payloadSize);
+        report(name, fieldNs / batch);
+
+        UdpFlow flow(0x0A000001, 5000, 0x0A000002, 6000);
+        double flowNs = nsPerOp(iterations, [&] {
+            for (auto& buffer : buffers) {
+                reset(buffer);
+                flow.write(buffer, payload);
+            }
+            doNotOptimize(buffers[0]);
+        });
+        snprintf(name, sizeof(name), "UdpFlow::write, %zu B payload (per packet)", payloadSize);
+        report(name, flowNs / batch);
+
+        double batchNs = nsPerOp(iterations, [&] {
+            for (auto& buffer : buffers) {
+                reset(buffer);
+            }
+            flow.writeBatch(std::span(buffers), std::span<const uint8_t>(payload));
+            doNotOptimize(buffers[0]);
+        });
+        snprintf(name, sizeof(name), "UdpFlow::writeBatch, %zu B payload (per packet)", payloadSize);
+        report(name, batchNs / batch);
+    }
+}
+
+int main() {
+    run(64);
+    run(1400);
+
+    int raw = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
+    if (raw < 0) {
+        printf("raw socket unavailable, not measuring sends\n");
+        return 0;
+    }
+    // To a loopback port nothing listens on: the packets are built and
+    //  sent in full, then dropped by the receiving side
+    sockaddr_in loopback{};
+    loopback.sin_family = AF_INET;
+    loopback.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    UdpFlow flow(INADDR_LOOPBACK, 5000, INADDR_LOOPBACK, 9);
+    std::vector<NetworkBuffer<1500>> buffers(batch);
+    std::vector<uint8_t> payload(64, 0x61);
+    double sendNs = nsPerOp(10'000, [&] {
+        for (auto& buffer : buffers) {
+            reset(buffer);
+        }
+        flow.writeBatch(std::span(buffers), std::span<const uint8_t>(payload));
+        for (auto& buffer : buffers) {
+            sendto(raw, buffer.getBuffer(), buffer.size(), 0, reinterpret_cast<sockaddr*>(&loopback), sizeof(loopback));
+        }
+    });
+    report("writeBatch + raw sendto, 64 B payload (per packet)", sendNs / batch);
+    close(raw);
+}
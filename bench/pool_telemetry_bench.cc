@@ -0,0 +1,41 @@
+#include "bench.hpp"
+#include "buffer_pool.hpp"
+#include "network_buffer.hpp"
+
+#include <vector>
+
+/**
+ * The cost of the pool's telemetry: acquire and release with the
+ * counters and hold-time histogram maintained (timing a sample of
+ * buffers), next to the cost of one timestamp, and of taking a
+ * snapshot from the reader's side.  Then a summary of the hold
+ * times for buffers held across a window of 256 acquires.
+ */
+int main() {
+    BufferPool<NetworkBuffer<1500>> pool(1024);
+
+    report("Acquire and release", nsPerOp(10'000'000, [&] {
+        auto handle = pool.acquire();
+        doNotOptimize(handle);
+    }));
+    report("Timestamp (one of two per acquire/release)", nsPerOp(10'000'000, [&] {
+        doNotOptimize(pool_detail::ticks());
+    }));
+    report("Snapshot of the stats", nsPerOp(1'000'000, [&] {
+        auto stats = pool.stats();
+        doNotOptimize(stats);
+    }));
+
+    std::vector<BufferPool<NetworkBuffer<1500>>::Handle> window(256);
+    for (std::size_t i = 0; i < 1'000'000; ++i) {
+        window[i % window.size()] = std::move(*pool.acquire());
+    }
+    auto stats = pool.stats();
+    printf("acquires %lu, failures %lu, in use %zu, peak %zu\n",
+           stats.acquires, stats.failures, stats.inUse, stats.peakInUse);
+    for (std::size_t i = 0; i < stats.heldTicks.size(); ++i) {
+        if (stats.heldTicks[i] > 0) {
+            printf("  held < %10.0f ns: %lu\n", stats.heldNs(i), stats.heldTicks[i]);
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#include "bench.hpp"
+#include "network_buffer.hpp"
+#include "rtcp.hpp"
+
+#include <random>
+#include <vector>
+
+/**
+ * Feedback generation for many streams: transport-wide CC with
+ * typical loss and jitter, and generic NACKs.  The TWCC writer is
+ * compared against a symbol-at-a-time encoder of the same chunks
+ * and deltas.
+ */
+namespace {
+    constexpr std::size_t numStreams = 1000;
+    constexpr std::size_t packetsPerFeedback = 100;
+
+    uint8_t symbolOf(int32_t delta) {
+        if (delta == RtcpWriter::notReceived) {
+            return 0;
+        }
+        return (delta >= 0 && delta <= 0xFF) ? 1 : 2;
+    }
+
+    template<typename Buffer>
+    void scalarEncode(Buffer& buffer, std::span<const int32_t> deltas) {
+        std::size_t n = deltas.size();
+        for (std::size_t i = 0; i < n;) {
+            uint8_t symbol = symbolOf(deltas[i]);
+            std::size_t run = 1;
+            while (i + run < n && run < 0x1FFF && symbolOf(deltas[i + run]) == symbol) {
+                ++run;
+            }
+            if (run >= 7) {
+                buffer.write(static_cast<uint16_t>((symbol << 13) | run));
+                i += run;
+                continue;
+            }
+            bool oneBit = true;
+            for (std::size_t j = i; j < i + 14 && j < n; ++j) {
+                oneBit &= symbolOf(deltas[j]) < 2;
+            }
+            uint16_t chunk = oneBit ? 0x8000 : 0xC000;
+            std::size_t count = oneBit ? 14 : 7;
+            for (std::size_t j = 0; j < count && i + j < n; ++j) {
+                uint16_t sym = symbolOf(deltas[i + j]);
+                chunk |= oneBit ? sym << (13 - j) : sym << (12 - 2 * j);
+            }
+            buffer.write(chunk);
+            i += count;
+        }
+        for (int32_t delta : deltas) {
+            uint8_t symbol = symbolOf(delta);
+            if (symbol == 1) {
+                buffer.write(static_cast<uint8_t>(delta));
+            } else if (symbol == 2) {
+                buffer.write(static_cast<uint16_t>(delta));
+            }
+        }
+    }
+}
+
+int main() {
+    std::mt19937 rng(7);
+    std::bernoulli_distribution loss(0.02);
+    std::normal_distribution<double> jitter(20, 30);
+    std::vector<std::vector<int32_t>> feedback(numStreams);
+    for (auto& deltas : feedback) {
+        for (std::size_t i = 0; i < packetsPerFeedback; ++i) {
+            deltas.push_back(loss(rng) ? RtcpWriter::notReceived : static_cast<int32_t>(jitter(rng)));
+        }
+    }
+
+    NetworkBuffer<1500> buffer;
+    auto twccNs = nsPerOp(200, [&] {
+        for (std::size_t s = 0; s < numStreams; ++s) {
+            NetworkBuffer<1500> out;
+            RtcpWriter::writeTransportCc(out, 1, s, 0, 0, 0, feedback[s]);
+            doNotOptimize(out);
+        }
+    });
+    report("writeTransportCc (100 packets, per stream)", twccNs / numStreams);
+
+    auto scalarNs = nsPerOp(200, [&] {
+        for (std::size_t s = 0; s < numStreams; ++s) {
+            NetworkBuffer<1500> out;
+            scalarEncode(out, feedback[s]);
+            doNotOptimize(out);
+        }
+    });
+    report("symbol-at-a-time encoder (per stream)", scalarNs / numStreams);
+
+    std::vector<uint16_t> lost;
+    for (uint16_t seq = 0; seq < 200; seq += 3) {
+        lost.push_back(seq);
+    }
+    report("writeNack (67 lost packets)", nsPerOp(1'000'000, [&] {
+        NetworkBuffer<1500> out;
+        RtcpWriter::writeNack(out, 1, 2, lost);
+        doNotOptimize(out);
+    }));
+
+    RtcpWriter::writeTransportCc(buffer, 1, 2, 0, 0, 0, feedback[0]);
+    RtcpWriter::writePli(buffer, 1, 2);
+    RtcpWriter::writeNack(buffer, 1, 2, lost);
+    report("RtcpCompoundReader (3 packets)", nsPerOp(10'000'000, [&] {
+        RtcpCompoundReader reader(buffer);
+        std::size_t n = 0;
+        while (auto packet = reader.next()) {
+            n += packet->body.size();
+        }
+        doNotOptimize(n);
+    }));
+}
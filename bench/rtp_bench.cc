@@ -0,0 +1,61 @@
+#include "bench.hpp"
+#include "network_buffer.hpp"
+#include "rtp.hpp"
+
+#include <vector>
+
+/**
+ * Parses RTP headers and rewrites their SSRC and sequence
+ * number, as a relay does for every forwarded packet
+ */
+int main() {
+    std::vector<uint8_t> packet = {
+        0x90, 0xE0, 0x12, 0x34,
+        0xDE, 0xAD, 0xBE, 0xEF,
+        0xCA, 0xFE, 0xBA, 0xBE,
+        0xBE, 0xDE, 0x00, 0x02,
+        0x10, 0xAA, 0x22, 0x01,
+        0x02, 0x03, 0x00, 0x00,
+    };
+    packet.resize(1200);
+    constexpr std::size_t iterations = 50'000'000;
+
+    uint16_t seq = 0;
+    report("RtpPacket parse + header()", nsPerOp(iterations, [&] {
+        auto rtp = RtpPacket::parse(packet);
+        auto header = rtp->header();
+        doNotOptimize(header);
+    }));
+
+    report("RtpPacket parse + rewrite ssrc/seq", nsPerOp(iterations, [&] {
+        auto rtp = RtpPacket::parse(packet);
+        rtp->setSsrc(rtp->ssrc() ^ 1);
+        rtp->setSequenceNumber(++seq);
+        doNotOptimize(packet[0]);
+    }));
+
+    report("RtpPacket findExtension", nsPerOp(iterations, [&] {
+        auto rtp = RtpPacket::parse(packet);
+        doNotOptimize(rtp->findExtension(2));
+    }));
+
+    // What the relay did before: read field by field, then build a new packet
+    report("read8/16/32 + rebuild into a new buffer", nsPerOp(1'000'000, [&] {
+        NetworkBuffer<1500> src;
+        src.write(packet.data(), packet.size());
+        uint8_t b0 = src.read8();
+        uint8_t b1 = src.read8();
+        uint16_t seqNum = src.read16();
+        uint32_t timestamp = src.read32();
+        uint32_t ssrc = src.read32();
+        NetworkBuffer<1500> out;
+        out.write(b0);
+        out.write(b1);
+        out.write(static_cast<uint16_t>(seqNum + 1));
+        out.write(timestamp);
+        out.write(static_cast<uint32_t>(ssrc ^ 1));
+        std::size_t rest = src.size();
+        out.write(src.read(rest), rest);
+        doNotOptimize(out);
+    }));
+}
@@ -0,0 +1,130 @@
+#include "bench.hpp"
+#include "network_buffer.hpp"
+#include "rtp_jitter_buffer.hpp"
+
+#include <map>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+/**
+ * Feeds a stream with synthetic loss and reordering through the
+ * jitter ring and through a std::map<uint16_t, NetworkBuffer<1500>>,
+ * popping in order as packets become available, skipping a missing
+ * packet once 32 later ones are held and collecting the gaps for
+ * NACK every 64 packets
+ */
+namespace {
+    using Buffer = NetworkBuffer<1500>;
+    constexpr std::size_t payloadSize = 1200;
+    constexpr std::size_t maxHeld = 32;
+
+    /**
+     * Arrival order of sequence numbers: each is lost with probability
+     * loss, and otherwise swapped with a nearby one with probability
+     * reorder
+     */
+    std::vector<uint16_t> arrivals(std::size_t count, double loss, double reorder) {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<double> chance(0, 1);
+        std::uniform_int_distribution<int> distance(1, 8);
+        std::vector<uint16_t> seqs;
+        for (std::size_t i = 0; i < count; ++i) {
+            if (chance(rng) >= loss) {
+                seqs.push_back(static_cast<uint16_t>(i));
+            }
+        }
+        for (std::size_t i = 0; i + 8 < seqs.size(); ++i) {
+            if (chance(rng) < reorder) {
+                std::swap(seqs[i], seqs[i + distance(rng)]);
+            }
+        }
+        return seqs;
+    }
+
+    void run(const char* pattern, double loss, double reorder) {
+        // Enough to wrap the sequence number space a few times
+        auto seqs = arrivals(1 << 18, loss, reorder);
+        std::vector<uint8_t> payload(payloadSize, 0x42);
+        std::size_t iterations = 4;
+        char name[128];
+
+        auto pool = std::make_unique<BufferPool<Buffer>>(1024);
+        auto jitter = std::make_unique<RtpJitterBuffer<Buffer>>();
+        uint16_t lost[512];
+        double ringNs = nsPerOp(iterations, [&] {
+            std::size_t played = 0;
+            for (std::size_t i = 0; i < seqs.size(); ++i) {
+                auto handle = pool->acquire();
+                (*handle)->write(payload.data(), payload.size());
+                jitter->insert(seqs[i], std::move(*handle));
+                while (true) {
+                    if (auto packet = jitter->pop()) {
+                        played += (*packet)->size();
+                    } else if (jitter->size() > maxHeld) {
+                        jitter->skip();
+                    } else {
+                        break;
+                    }
+                }
+                if (i % 64 == 0) {
+                    doNotOptimize(jitter->missing(lost));
+                }
+            }
+            doNotOptimize(played);
+        });
+        snprintf(name, sizeof(name), "ring, %s (per packet)", pattern);
+        report(name, ringNs / seqs.size());
+
+        std::map<uint16_t, Buffer> held;
+        uint16_t next = seqs[0];
+        std::vector<uint16_t> lostSeqs;
+        double mapNs = nsPerOp(iterations, [&] {
+            std::size_t played = 0;
+            for (std::size_t i = 0; i < seqs.size(); ++i) {
+                if (static_cast<int16_t>(seqs[i] - next) < 0) {
+                    continue;
+                }
+                held[seqs[i]].write(payload.data(), payload.size());
+                while (true) {
+                    auto it = held.find(next);
+                    if (it != held.end()) {
+                        played += it->second.size();
+                        held.erase(it);
+                        ++next;
+                    } else if (held.size() > maxHeld) {
+                        ++next;
+                    } else {
+                        break;
+                    }
+                }
+                if (i % 64 == 0) {
+                    // The newest held is the one furthest ahead of next
+                    lostSeqs.clear();
+                    uint16_t newest = next;
+                    for (auto& [seq, buffer] : held) {
+                        if (static_cast<int16_t>(seq - newest) > 0) {
+                            newest = seq;
+                        }
+                    }
+                    for (uint16_t seq = next; seq != newest; ++seq) {
+                        if (!held.count(seq)) {
+                            lostSeqs.push_back(seq);
+                        }
+                    }
+                    doNotOptimize(lostSeqs.data());
+                }
+            }
+            doNotOptimize(played);
+        });
+        snprintf(name, sizeof(name), "std::map, %s (per packet)", pattern);
+        report(name, mapNs / seqs.size());
+    }
+}
+
+int main() {
+    run("in order", 0, 0);
+    run("2% loss, 5% reordered", 0.02, 0.05);
+    run("10% loss, 20% reordered", 0.10, 0.20);
+}
@@ -0,0 +1,86 @@
+#include "bench.hpp"
+#include "network_buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/**
+ * Splits a SIP/HTTP style header block into lines, comparing
+ * readUntil against memchr and std::search
+ */
+namespace {
+    const std::string headers =
+        "INVITE sip:bob@biloxi.example.com SIP/2.0\r\n"
+        "Via: SIP/2.0/TCP client.atlanta.example.com:5060;branch=z9hG4bK74bf9\r\n"
+        "Max-Forwards: 70\r\n"
+        "From: Alice <sip:alice@atlanta.example.com>;tag=9fxced76sl\r\n"
+        "To: Bob <sip:bob@biloxi.example.com>\r\n"
+        "Call-ID: 3848276298220188511@atlanta.example.com\r\n"
+        "CSeq: 2 INVITE\r\n"
+        "Contact: <sip:alice@client.atlanta.example.com;transport=tcp>\r\n"
+        "User-Agent: Example/1.0 (some rather long product token and comment)\r\n"
+        "Content-Type: application/sdp\r\n"
+        "Content-Length: 151\r\n"
+        "\r\n";
+    constexpr std::size_t iterations = 2'000'000;
+}
+
+int main() {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(headers.data());
+
+    auto readUntilNs = nsPerOp(iterations, [&] {
+        NetworkBuffer<1500> buffer;
+        buffer.write(data, headers.size());
+        std::size_t lines = 0;
+        while (auto line = buffer.readUntil("\r\n")) {
+            if (line->empty()) {
+                break;
+            }
+            ++lines;
+        }
+        doNotOptimize(lines);
+    });
+    reportThroughput("NetworkBuffer::readUntil(\"\\r\\n\")", readUntilNs, headers.size());
+
+    // The buffer write is part of the readUntil run, so include a copy here too
+    uint8_t copy[1500];
+    auto memchrNs = nsPerOp(iterations, [&] {
+        memcpy(copy, data, headers.size());
+        const uint8_t* pos = copy;
+        const uint8_t* copyEnd = copy + headers.size();
+        std::size_t lines = 0;
+        while (auto cr = static_cast<const uint8_t*>(memchr(pos, '\r', copyEnd - pos))) {
+            if (cr + 1 < copyEnd && cr[1] == '\n') {
+                if (cr == pos) {
+                    break;
+                }
+                ++lines;
+                pos = cr + 2;
+            } else {
+                pos = cr + 1;
+            }
+        }
+        doNotOptimize(lines);
+    });
+    reportThroughput("memchr('\\r')", memchrNs, headers.size());
+
+    const std::string_view crlf{"\r\n"};
+    auto searchNs = nsPerOp(iterations, [&] {
+        memcpy(copy, data, headers.size());
+        const uint8_t* pos = copy;
+        const uint8_t* copyEnd = copy + headers.size();
+        std::size_t lines = 0;
+        while (true) {
+            auto match = std::search(pos, copyEnd, crlf.begin(), crlf.end());
+            if (match == copyEnd || match == pos) {
+                break;
+            }
+            ++lines;
+            pos = match + 2;
+        }
+        doNotOptimize(lines);
+    });
+    reportThroughput("std::search(\"\\r\\n\")", searchNs, headers.size());
+}
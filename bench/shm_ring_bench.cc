@@ -0,0 +1,103 @@
+#include "bench.hpp"
+#include "shm_ring.hpp"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+
+/**
+ * Streams messages from a forked producer process to the consumer,
+ * through a ShmRing (consumer reads in place) and through a Unix
+ * SOCK_SEQPACKET socket pair (copied in by send and out by recv).
+ * Reports the consumer's wall time per message.
+ */
+namespace {
+    using Ring = ShmRing<2048, 1024>;
+    constexpr std::size_t count = 500'000;
+
+    /**
+     * Time from fork until the consumer has seen all messages
+     */
+    template<typename Produce, typename Consume>
+    double nsPerMessage(Produce&& produce, Consume&& consume) {
+        auto start = std::chrono::steady_clock::now();
+        pid_t child = fork();
+        if (child == 0) {
+            produce();
+            _exit(0);
+        }
+        consume();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        waitpid(child, nullptr, 0);
+        return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+    }
+
+    void run(std::size_t size) {
+        std::vector<uint8_t> message(size, 0x5A);
+        char name[128];
+
+        auto ring = Ring::create();
+        double ringNs = nsPerMessage([&] {
+            for (std::size_t i = 0; i < count; ++i) {
+                while (!ring->push(message)) {
+                    ring->waitForSpace(-1);
+                }
+            }
+        }, [&] {
+            std::size_t received = 0;
+            uint64_t checksum = 0;
+            while (received < count && ring->waitForData(-1)) {
+                while (auto view = ring->peek()) {
+                    // Touch the message as a real consumer would
+                    checksum += (*view)[0] + (*view)[view->size() - 1];
+                    ++received;
+                    ring->release();
+                }
+            }
+            doNotOptimize(checksum);
+        });
+        snprintf(name, sizeof(name), "ShmRing, %zu B messages", size);
+        report(name, ringNs);
+
+        int fds[2];
+        socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds);
+        int bufferSize = 4 << 20;
+        setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+        setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+        double socketNs = nsPerMessage([&] {
+            close(fds[1]);
+            NetworkBuffer<2048> buffer;
+            buffer.write(message.data(), message.size());
+            for (std::size_t i = 0; i < count; ++i) {
+                send(fds[0], buffer.getBuffer(), buffer.size(), 0);
+            }
+        }, [&] {
+            NetworkBuffer<2048> buffer;
+            uint64_t checksum = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                ssize_t res = recv(fds[1], buffer.getWriteBuffer(), buffer.remainingCapacity(), 0);
+                if (res <= 0) {
+                    break;
+                }
+                buffer.setSize(res);
+                checksum += buffer.getBuffer()[0] + buffer.getBuffer()[res - 1];
+                buffer.read(res);
+                buffer.compact();
+            }
+            doNotOptimize(checksum);
+        });
+        close(fds[0]);
+        close(fds[1]);
+        snprintf(name, sizeof(name), "Unix SOCK_SEQPACKET, %zu B messages", size);
+        report(name, socketNs);
+    }
+}
+
+int main() {
+    for (std::size_t size : { 64, 512, 1500 }) {
+        run(size);
+    }
+}
@@ -0,0 +1,119 @@
+#include "bench.hpp"
+#include "buffer_pool.hpp"
+#include "network_buffer.hpp"
+#include "size_class_pool.hpp"
+
+#include <cstdio>
+#include <malloc.h>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+
+/**
+ * Bimodal traffic (90% of messages under 200 bytes, 9% around 1200 and
+ * 1% around 9 KB) with 2048 messages held at a time, through one
+ * BufferPool of 9 KB buffers and through a SizeClassPool, first with
+ * guessed capacities and then with the ones it suggests from the first
+ * run.  Reports time per message, the pool's footprint and how much
+ * resident memory the pool ended up with.
+ */
+namespace {
+    using Classes = SizeClassPool<256, 1500, 9216, 65536>;
+    constexpr std::size_t held = 2048;
+    constexpr std::size_t iterations = 1 << 20;
+
+    std::vector<uint16_t> messageSizes(std::size_t count) {
+        std::mt19937 rng(1234);
+        std::uniform_int_distribution<int> kind(0, 99);
+        std::uniform_int_distribution<int> small(40, 199), medium(1000, 1400), large(8000, 9200);
+        std::vector<uint16_t> sizes(count);
+        for (auto& size : sizes) {
+            int k = kind(rng);
+            size = k < 90 ? small(rng) : k < 99 ? medium(rng) : large(rng);
+        }
+        return sizes;
+    }
+
+    std::size_t residentBytes() {
+        long pages = 0, resident = 0;
+        FILE* statm = fopen("/proc/self/statm", "r");
+        if (statm) {
+            if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+                resident = 0;
+            }
+            fclose(statm);
+        }
+        return resident * sysconf(_SC_PAGESIZE);
+    }
+
+    void reportMemory(std::size_t footprint, std::size_t resident) {
+        printf("  footprint %.1f MB, resident %.1f MB\n", footprint / 1e6, resident / 1e6);
+    }
+
+    /**
+     * Acquire a buffer for each message, write it, and release it once
+     * held more messages have come after it
+     */
+    template<typename Acquire, typename Write>
+    double run(const std::vector<uint16_t>& sizes, Acquire&& acquire, Write&& write) {
+        using Handle = typename decltype(acquire(0))::value_type;
+        std::vector<Handle> window(held);
+        std::vector<uint8_t> payload(9216, 0x42);
+        std::size_t next = 0;
+        return nsPerOp(iterations, [&] {
+            uint16_t size = sizes[next % sizes.size()];
+            auto& slot = window[next % held];
+            slot.reset();
+            if (auto handle = acquire(size)) {
+                write(*handle, payload.data(), size);
+                slot = std::move(*handle);
+            }
+            ++next;
+        });
+    }
+
+    std::array<std::size_t, Classes::classes> runClasses(const char* name, const std::vector<uint16_t>& sizes,
+                                                           const std::array<std::size_t, Classes::classes>& capacities) {
+        std::size_t before = residentBytes();
+        std::optional<Classes> pool(std::in_place, capacities);
+        double ns = run(sizes, [&](std::size_t size) {
+            return pool->acquire(size);
+        }, [](Classes::Handle& handle, const uint8_t* data, std::size_t size) {
+            handle.visit([&](auto& buffer) {
+                buffer.write(data, size);
+            });
+        });
+        report(name, ns);
+        reportMemory(pool->footprint(), residentBytes() - before);
+        printf("  capacities %zu/%zu/%zu/%zu, fallbacks %zu, failures %zu\n",
+               capacities[0], capacities[1], capacities[2], capacities[3],
+               pool->fallbacks(), pool->failures());
+        return pool->suggestCapacities();
+    }
+}
+
+int main() {
+    // Keep glibc from raising its mmap threshold as the pools are
+    //  freed, so each pool gets fresh pages and resident memory
+    //  measures that pool alone
+    mallopt(M_MMAP_THRESHOLD, 128 << 10);
+    auto sizes = messageSizes(1 << 16);
+
+    {
+        using Buffer = NetworkBuffer<9216>;
+        std::size_t before = residentBytes();
+        std::optional<BufferPool<Buffer>> pool(std::in_place, held + 1);
+        double ns = run(sizes, [&](std::size_t) {
+            return pool->acquire();
+        }, [](BufferPool<Buffer>::Handle& handle, const uint8_t* data, std::size_t size) {
+            handle->write(data, size);
+        });
+        report("BufferPool<NetworkBuffer<9216>>", ns);
+        reportMemory(pool->capacity() * sizeof(Buffer), residentBytes() - before);
+    }
+
+    auto suggested = runClasses("SizeClassPool, guessed capacities", sizes, { held, 512, 128, 4 });
+    runClasses("SizeClassPool, suggested capacities", sizes, suggested);
+}
@@ -0,0 +1,148 @@
+#include "bench.hpp"
+#include "network_buffer.hpp"
+
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+
+/**
+ * A protocol sniffer trying several decoders (STUN, DNS, RTP, in that
+ * order) on a mix of datagrams until one accepts.  Each decoder reads
+ * fields as it checks them, so a decoder that gives up must leave the
+ * buffer as it found it.  Compares giving each attempt a copy of the
+ * buffer with trying them all on the one buffer, rewinding to a mark
+ * after each failure.  Also times resetting a buffer for reuse.
+ */
+namespace {
+    using Buffer = NetworkBuffer<1500>;
+    constexpr std::size_t datagrams = 1024;
+
+    std::optional<uint32_t> decodeStun(Buffer& buffer) {
+        if (buffer.size() < 20) {
+            return std::nullopt;
+        }
+        uint16_t type = buffer.read16();
+        uint16_t length = buffer.read16();
+        if ((type & 0xC000) != 0 || buffer.read32() != 0x2112A442 || length != buffer.size() - 12) {
+            return std::nullopt;
+        }
+        return type + length;
+    }
+
+    std::optional<uint32_t> decodeDns(Buffer& buffer) {
+        if (buffer.size() < 12) {
+            return std::nullopt;
+        }
+        uint16_t id = buffer.read16();
+        uint16_t flags = buffer.read16();
+        uint16_t questions = buffer.read16();
+        // A standard query or response, with a question or two
+        if ((flags & 0x7800) != 0 || questions == 0 || questions > 2) {
+            return std::nullopt;
+        }
+        return id + questions;
+    }
+
+    std::optional<uint32_t> decodeRtp(Buffer& buffer) {
+        if (buffer.size() < 12 || (buffer.peek<uint8_t>() >> 6) != 2) {
+            return std::nullopt;
+        }
+        buffer.read8();
+        uint8_t payloadType = buffer.read8() & 0x7F;
+        // 72-76 would be RTCP
+        if (payloadType >= 72 && payloadType <= 76) {
+            return std::nullopt;
+        }
+        uint16_t seq = buffer.read16();
+        return seq + buffer.read32();
+    }
+
+    std::optional<uint32_t> (*const decoders[])(Buffer&) = { decodeStun, decodeDns, decodeRtp };
+
+    uint32_t sniffByCopy(const Buffer& buffer) {
+        for (auto decoder : decoders) {
+            Buffer attempt = buffer;
+            if (auto res = decoder(attempt)) {
+                return *res;
+            }
+        }
+        return 0;
+    }
+
+    uint32_t sniffByRewind(Buffer& buffer) {
+        auto mark = buffer.mark();
+        for (auto decoder : decoders) {
+            if (auto res = decoder(buffer)) {
+                buffer.rewind(mark);
+                return *res;
+            }
+            buffer.rewind(mark);
+        }
+        return 0;
+    }
+
+    void writeDatagram(Buffer& buffer, std::size_t kind, uint16_t n) {
+        uint8_t payload[160] = {};
+        switch (kind) {
+            case 0: // STUN binding request
+                buffer.write(static_cast<uint16_t>(0x0001));
+                buffer.write(static_cast<uint16_t>(8));
+                buffer.write(static_cast<uint32_t>(0x2112A442));
+                buffer.write(payload, 12 + 8);
+                break;
+            case 1: // DNS query
+                buffer.write(n);
+                buffer.write(static_cast<uint16_t>(0x0100));
+                buffer.write(static_cast<uint16_t>(1));
+                buffer.write(payload, 6 + 33);
+                break;
+            default: // RTP
+                buffer.write(static_cast<uint8_t>(0x80));
+                buffer.write(static_cast<uint8_t>(96));
+                buffer.write(n);
+                buffer.write(static_cast<uint32_t>(n * 960));
+                buffer.write(static_cast<uint32_t>(0x12345678));
+                buffer.write(payload, sizeof(payload));
+                break;
+        }
+    }
+}
+
+int main() {
+    // Mostly media, as on a typical WebRTC port
+    auto buffers = std::make_unique<Buffer[]>(datagrams);
+    std::mt19937 rng(1234);
+    std::discrete_distribution<std::size_t> kind({ 1, 1, 8 });
+    for (std::size_t i = 0; i < datagrams; ++i) {
+        writeDatagram(buffers[i], kind(rng), static_cast<uint16_t>(i));
+    }
+
+    std::size_t next = 0;
+    report("Sniff, copy per attempt", nsPerOp(1'000'000, [&] {
+        doNotOptimize(sniffByCopy(buffers[next++ % datagrams]));
+    }));
+    report("Sniff, mark and rewind", nsPerOp(1'000'000, [&] {
+        doNotOptimize(sniffByRewind(buffers[next++ % datagrams]));
+    }));
+
+    // Resetting a buffer that had a datagram in it
+    Buffer buffer;
+    report("Reset, assign a new buffer", nsPerOp(10'000'000, [&] {
+        buffer.write(static_cast<uint32_t>(next++));
+        buffer = Buffer();
+        doNotOptimize(&buffer);
+    }));
+    report("Reset, read everything and compact", nsPerOp(10'000'000, [&] {
+        buffer.write(static_cast<uint32_t>(next++));
+        buffer.read(buffer.size());
+        buffer.compact();
+        doNotOptimize(&buffer);
+    }));
+    report("Reset, clear", nsPerOp(10'000'000, [&] {
+        buffer.write(static_cast<uint32_t>(next++));
+        buffer.clear();
+        doNotOptimize(&buffer);
+    }));
+}
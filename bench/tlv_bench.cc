@@ -0,0 +1,61 @@
+#include "bench.hpp"
+#include "network_buffer.hpp"
+#include "tlv.hpp"
+
+#include <cstring>
+
+/**
+ * Walks the attributes of a typical ICE connectivity check
+ * (STUN binding request)
+ */
+namespace {
+    void buildBindingRequest(NetworkBuffer<1500>& buffer) {
+        using Writer = TlvWriter<StunAttributeFormat>;
+        uint8_t header[20] = { 0x00, 0x01, 0x00, 0x00, 0x21, 0x12, 0xA4, 0x42 };
+        buffer.write(header, sizeof(header));
+        const char username[] = "abcd:efgh";
+        Writer::write(buffer, 0x0006, {reinterpret_cast<const uint8_t*>(username), 9});
+        uint8_t priority[4] = { 0x6e, 0x00, 0x01, 0xff };
+        Writer::write(buffer, 0x0024, priority);
+        uint8_t tieBreaker[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+        Writer::write(buffer, 0x802A, tieBreaker);
+        Writer::write(buffer, 0x0025, {});
+        uint8_t integrity[20] = {};
+        Writer::write(buffer, 0x0008, integrity);
+        uint8_t fingerprint[4] = {};
+        Writer::write(buffer, 0x8028, fingerprint);
+    }
+}
+
+int main() {
+    NetworkBuffer<1500> buffer;
+    buildBindingRequest(buffer);
+    const uint8_t* attrs = buffer.getBuffer() + 20;
+    std::size_t attrsLen = buffer.size() - 20;
+    constexpr std::size_t iterations = 10'000'000;
+
+    report("TlvReader (STUN binding request)", nsPerOp(iterations, [&] {
+        uint32_t sum = 0;
+        TlvReader<StunAttributeFormat> reader(attrs, attrsLen);
+        while (auto attr = reader.next()) {
+            sum += attr->type + attr->value.size();
+        }
+        doNotOptimize(sum);
+    }));
+
+    report("hand-written loop (STUN binding request)", nsPerOp(iterations, [&] {
+        uint32_t sum = 0;
+        const uint8_t* pos = attrs;
+        const uint8_t* end = attrs + attrsLen;
+        while (end - pos >= 4) {
+            uint16_t type = loadNetwork<uint16_t>(pos);
+            uint16_t len = loadNetwork<uint16_t>(pos + 2);
+            if (len > end - pos - 4) {
+                break;
+            }
+            sum += type + len;
+            pos += 4 + ((len + 3) & ~3);
+        }
+        doNotOptimize(sum);
+    }));
+}
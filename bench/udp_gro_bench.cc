@@ -0,0 +1,121 @@
+#include "bench.hpp"
+#include "udp_gro.hpp"
+#include "udp_gso.hpp"
+
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+/**
+ * Receives bursts of 40 x 1200 byte datagrams over loopback: one
+ * recv per datagram, recvmmsg, and GRO.  Every burst is sent with
+ * GSO, so the send cost is the same for each.
+ */
+namespace {
+    constexpr std::size_t burst = 40;
+    constexpr std::size_t datagramSize = 1200;
+    constexpr std::size_t iterations = 20'000;
+
+    struct Sockets {
+        int sender;
+        int receiver;
+        sockaddr_in addr{};
+
+        Sockets() {
+            sender = socket(AF_INET, SOCK_DGRAM, 0);
+            receiver = socket(AF_INET, SOCK_DGRAM, 0);
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            bind(receiver, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+            socklen_t len = sizeof(addr);
+            getsockname(receiver, reinterpret_cast<sockaddr*>(&addr), &len);
+        }
+
+        ~Sockets() {
+            close(sender);
+            close(receiver);
+        }
+    };
+}
+
+int main() {
+    std::vector<uint8_t> payload(datagramSize, 0xAB);
+
+    {
+        Sockets sockets;
+        auto writer = std::make_unique<GsoWriter<>>(sockets.sender,
+            reinterpret_cast<sockaddr*>(&sockets.addr), sizeof(sockets.addr), datagramSize);
+        std::vector<NetworkBuffer<1500>> buffers(burst);
+        auto ns = nsPerOp(iterations, [&] {
+            for (std::size_t i = 0; i < burst; ++i) {
+                writer->append(payload);
+            }
+            writer->flush();
+            for (auto& buffer : buffers) {
+                buffer.clear();
+                buffer.setSize(recv(sockets.receiver, buffer.getBuffer(), buffer.remainingCapacity(), 0));
+            }
+        });
+        report("recv per datagram", ns / burst);
+    }
+
+    {
+        Sockets sockets;
+        auto writer = std::make_unique<GsoWriter<>>(sockets.sender,
+            reinterpret_cast<sockaddr*>(&sockets.addr), sizeof(sockets.addr), datagramSize);
+        std::vector<NetworkBuffer<1500>> buffers(burst);
+        iovec iovs[burst];
+        mmsghdr msgs[burst] = {};
+        auto ns = nsPerOp(iterations, [&] {
+            for (std::size_t i = 0; i < burst; ++i) {
+                writer->append(payload);
+            }
+            writer->flush();
+            for (std::size_t i = 0; i < burst; ++i) {
+                buffers[i].clear();
+                iovs[i] = {buffers[i].getBuffer(), buffers[i].remainingCapacity()};
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            std::size_t received = 0;
+            while (received < burst) {
+                int res = recvmmsg(sockets.receiver, msgs + received, burst - received, 0, nullptr);
+                for (int i = 0; i < res; ++i) {
+                    buffers[received + i].setSize(msgs[received + i].msg_len);
+                }
+                received += res;
+            }
+        });
+        report("recvmmsg (per datagram)", ns / burst);
+    }
+
+    {
+        Sockets sockets;
+        bool groEnabled = GroReader<>::enable(sockets.receiver);
+        auto writer = std::make_unique<GsoWriter<>>(sockets.sender,
+            reinterpret_cast<sockaddr*>(&sockets.addr), sizeof(sockets.addr), datagramSize);
+        auto reader = std::make_unique<GroReader<>>();
+        std::size_t reads = 0;
+        std::size_t total = 0;
+        auto ns = nsPerOp(iterations, [&] {
+            for (std::size_t i = 0; i < burst; ++i) {
+                writer->append(payload);
+            }
+            writer->flush();
+            std::size_t received = 0;
+            while (received < burst) {
+                reader->receive(sockets.receiver);
+                ++reads;
+                while (auto datagram = reader->next()) {
+                    doNotOptimize(datagram->data());
+                    ++received;
+                }
+            }
+            total += received;
+        });
+        report(groEnabled ? "GRO (per datagram)" : "GRO unavailable (per datagram)", ns / burst);
+        printf("  %.1f datagrams per read\n", static_cast<double>(total) / reads);
+    }
+}
@@ -0,0 +1,70 @@
+#include "bench.hpp"
+#include "udp_gso.hpp"
+
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+/**
+ * Sends bursts of 40 x 1200 byte datagrams over loopback: one send
+ * per datagram, sendmmsg, and GSO
+ */
+namespace {
+    constexpr std::size_t burst = 40;
+    constexpr std::size_t datagramSize = 1200;
+    constexpr std::size_t iterations = 20'000;
+}
+
+int main() {
+    int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+    int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(receiver, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(receiver, reinterpret_cast<sockaddr*>(&addr), &len);
+    // Datagrams are never read: once the receive queue is full the
+    //  kernel drops them, which is fine for measuring the send side
+    connect(sender, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+
+    std::vector<NetworkBuffer<1500>> buffers(burst);
+    std::vector<uint8_t> payload(datagramSize, 0xAB);
+    for (auto& buffer : buffers) {
+        buffer.write(payload.data(), payload.size());
+    }
+
+    auto sendNs = nsPerOp(iterations, [&] {
+        for (auto& buffer : buffers) {
+            send(sender, buffer.getBuffer(), buffer.size(), 0);
+        }
+    });
+    report("send per datagram", sendNs / burst);
+
+    auto mmsgWriter = std::make_unique<GsoWriter<>>(sender,
+        reinterpret_cast<sockaddr*>(&addr), sizeof(addr), datagramSize);
+    mmsgWriter->disableGso();
+    auto mmsgNs = nsPerOp(iterations, [&] {
+        for (std::size_t i = 0; i < burst; ++i) {
+            mmsgWriter->append(payload);
+        }
+        mmsgWriter->flush();
+    });
+    report("sendmmsg (per datagram)", mmsgNs / burst);
+
+    auto gsoWriter = std::make_unique<GsoWriter<>>(sender,
+        reinterpret_cast<sockaddr*>(&addr), sizeof(addr), datagramSize);
+    auto gsoNs = nsPerOp(iterations, [&] {
+        for (std::size_t i = 0; i < burst; ++i) {
+            gsoWriter->append(payload);
+        }
+        gsoWriter->flush();
+    });
+    report(gsoWriter->gsoAvailable() ? "GSO (per datagram)" : "GSO unavailable, fell back (per datagram)",
+           gsoNs / burst);
+
+    close(sender);
+    close(receiver);
+}
@@ -0,0 +1,49 @@
+#include "bench.hpp"
+#include "network_buffer.hpp"
+#include "websocket.hpp"
+
+#include <memory>
+#include <vector>
+
+/**
+ * Masking throughput for 64B to 1MB frames, and the cost of
+ * decoding a header and unmasking a small frame
+ */
+int main() {
+    const std::array<uint8_t, 4> key = {0x37, 0xfa, 0x21, 0x3d};
+    std::vector<uint8_t> payload(1 << 20);
+
+    for (std::size_t size = 64; size <= payload.size(); size *= 4) {
+        std::size_t iterations = (1 << 28) / size;
+        std::span<uint8_t> data{payload.data(), size};
+        char name[64];
+
+        snprintf(name, sizeof(name), "WebSocketCodec::mask %zuB", size);
+        reportThroughput(name, nsPerOp(iterations, [&] {
+            WebSocketCodec::mask(data, key);
+            doNotOptimize(payload[0]);
+        }), size);
+
+        snprintf(name, sizeof(name), "byte at a time mask %zuB", size);
+        reportThroughput(name, nsPerOp(iterations, [&] {
+            for (std::size_t i = 0; i < size; ++i) {
+                data[i] ^= key[i & 3];
+                // Keep the compiler from vectorizing the baseline
+                asm volatile("" : : : "memory");
+            }
+        }), size);
+    }
+
+    auto buffer = std::make_unique<NetworkBuffer<1500>>();
+    WebSocketFrameHeader header;
+    header.masked = true;
+    header.maskingKey = key;
+    WebSocketCodec::writeFrame(*buffer, header, {payload.data(), 64});
+    std::vector<uint8_t> frame(buffer->getBuffer(), buffer->getBuffer() + buffer->size());
+    report("readFrame (64B masked)", nsPerOp(10'000'000, [&] {
+        NetworkBuffer<128> buf;
+        buf.write(frame.data(), frame.size());
+        WebSocketFrameHeader parsed;
+        doNotOptimize(WebSocketCodec::readFrame(buf, parsed));
+    }));
+}
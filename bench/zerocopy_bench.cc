@@ -0,0 +1,133 @@
+#include "bench.hpp"
+#include "network_buffer.hpp"
+#include "zerocopy.hpp"
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Sends 1 GB over loopback TCP in 64 KB buffers with plain send and
+ * with ZeroCopyWriter, reporting the sending thread's CPU time per GB.
+ * Loopback always falls back to copying, so this measures the cost of
+ * the completion bookkeeping rather than the savings of zero copy,
+ * which only show up on a real NIC.
+ */
+namespace {
+    using Buffer = NetworkBuffer<65536>;
+    constexpr std::size_t totalBytes = 1ull << 30;
+
+    std::pair<int, int> tcpPair() {
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+        listen(listener, 1);
+        int client = socket(AF_INET, SOCK_STREAM, 0);
+        connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        int server = accept(listener, nullptr, nullptr);
+        close(listener);
+        return {client, server};
+    }
+
+    double threadCpuSeconds() {
+        rusage usage;
+        getrusage(RUSAGE_THREAD, &usage);
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+            (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    }
+
+    /**
+     * Run send() on the calling thread while another drains the
+     * receiving socket, returning the sender's CPU seconds per GB
+     */
+    template<typename F>
+    double cpuPerGb(F&& send) {
+        auto [sender, receiver] = tcpPair();
+        std::thread drain([receiver = receiver] {
+            std::vector<uint8_t> chunk(1 << 20);
+            std::size_t received = 0;
+            while (received < totalBytes) {
+                ssize_t res = recv(receiver, chunk.data(), chunk.size(), 0);
+                if (res <= 0) {
+                    break;
+                }
+                received += res;
+            }
+        });
+        double start = threadCpuSeconds();
+        send(sender);
+        double cpu = threadCpuSeconds() - start;
+        drain.join();
+        close(sender);
+        close(receiver);
+        return cpu / (totalBytes / double(1 << 30));
+    }
+}
+
+int main() {
+    std::vector<uint8_t> payload(Buffer{}.remainingCapacity(), 0xAB);
+
+    double copyCpu = cpuPerGb([&](int fd) {
+        // Both fill a buffer per send, as an application building
+        //  its payloads would
+        auto buffer = std::make_unique<Buffer>();
+        for (std::size_t sent = 0; sent < totalBytes;) {
+            buffer->write(payload.data(), payload.size());
+            while (!buffer->empty()) {
+                ssize_t res = send(fd, buffer->getBuffer(), buffer->size(), 0);
+                if (res <= 0) {
+                    return;
+                }
+                buffer->read(res);
+                sent += res;
+            }
+            buffer->compact();
+        }
+    });
+    printf("%-48s %10.3f CPU s/GB\n", "send (copy)", copyCpu);
+
+    bool enabled = true;
+    std::size_t copied = 0;
+    std::size_t completions = 0;
+    double zeroCopyCpu = cpuPerGb([&](int fd) {
+        enabled = ZeroCopyWriter<Buffer>::enable(fd);
+        BufferPool<Buffer> pool(64);
+        ZeroCopyWriter<Buffer> writer(fd);
+        for (std::size_t sent = 0; sent < totalBytes;) {
+            auto buffer = pool.acquire();
+            while (!buffer) {
+                pollfd pfd{fd, 0, 0};
+                poll(&pfd, 1, 10);
+                writer.reap();
+                buffer = pool.acquire();
+            }
+            (*buffer)->write(payload.data(), payload.size());
+            sent += payload.size();
+            writer.send(std::move(*buffer));
+            if (pool.available() < 16) {
+                writer.reap();
+            }
+        }
+        while (writer.inFlight() > 0) {
+            writer.flush();
+            pollfd pfd{fd, 0, 0};
+            poll(&pfd, 1, 10);
+            writer.reap();
+        }
+        copied = writer.copiedCompletions();
+        completions = writer.completions();
+    });
+    printf("%-48s %10.3f CPU s/GB (%zu of %zu sends copied)\n",
+           enabled ? "ZeroCopyWriter" : "ZeroCopyWriter (SO_ZEROCOPY unavailable)",
+           zeroCopyCpu, copied, completions);
+}
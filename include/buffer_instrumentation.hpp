@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#endif
+
+#include "network_buffer.hpp"
+
+/**
+ * Instrumentation policies for NetworkBuffer (see NoInstrumentation):
+ *
+ *   using Buffer = NetworkBuffer<1500, CountingInstrumentation<>>;
+ *   ...
+ *   auto& counters = CountingInstrumentation<>::counters();
+ *
+ * The counting and histogram policies keep their data per thread, so
+ * the hooks never contend; each thread reads (and resets) its own.
+ */
+
+struct BufferCounters {
+    uint64_t writes = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t reads = 0;
+    uint64_t bytesRead = 0;
+    uint64_t setSizes = 0;
+    uint64_t bytesSet = 0;
+    // Writes (and setSizes) that left less than the policy's
+    //  threshold of the capacity free
+    uint64_t lowCapacity = 0;
+};
+
+/**
+ * Counts calls and bytes, and how often a buffer gets close to full
+ * (less than LowCapacityPercent of its capacity left)
+ */
+template<unsigned int LowCapacityPercent = 10>
+struct CountingInstrumentation {
+    /**
+     * This thread's counters
+     */
+    static BufferCounters& counters() {
+        thread_local BufferCounters counters;
+        return counters;
+    }
+
+    static void onWrite(std::size_t numBytes, std::size_t used, std::size_t capacity) {
+        auto& c = counters();
+        ++c.writes;
+        c.bytesWritten += numBytes;
+        c.lowCapacity += _isLow(used, capacity);
+    }
+
+    static void onRead(std::size_t numBytes, std::size_t) {
+        auto& c = counters();
+        ++c.reads;
+        c.bytesRead += numBytes;
+    }
+
+    static void onSetSize(std::size_t numBytes, std::size_t used, std::size_t capacity) {
+        auto& c = counters();
+        ++c.setSizes;
+        c.bytesSet += numBytes;
+        c.lowCapacity += _isLow(used, capacity);
+    }
+
+    static bool _isLow(std::size_t used, std::size_t capacity) {
+        return (capacity - used) * 100 < capacity * LowCapacityPercent;
+    }
+};
+
+struct BufferHistograms {
+    // Bucket b counts calls of [2^(b-1), 2^b) bytes (bucket 0: none)
+    static constexpr std::size_t sizeBuckets = 33;
+    // Bucket b counts buffers from b to b+1 tenths full (10: full)
+    static constexpr std::size_t fillBuckets = 11;
+
+    std::array<uint64_t, sizeBuckets> writeSizes = {};
+    std::array<uint64_t, sizeBuckets> readSizes = {};
+    // How full each write (or setSize) left the buffer
+    std::array<uint64_t, fillBuckets> fill = {};
+};
+
+/**
+ * Histograms of write and read sizes and of how full writes leave
+ * buffers
+ */
+struct HistogramInstrumentation {
+    /**
+     * This thread's histograms
+     */
+    static BufferHistograms& histograms() {
+        thread_local BufferHistograms histograms;
+        return histograms;
+    }
+
+    static void onWrite(std::size_t numBytes, std::size_t used, std::size_t capacity) {
+        auto& h = histograms();
+        ++h.writeSizes[_bucket(numBytes)];
+        ++h.fill[used * 10 / capacity];
+    }
+
+    static void onRead(std::size_t numBytes, std::size_t) {
+        ++histograms().readSizes[_bucket(numBytes)];
+    }
+
+    static void onSetSize(std::size_t numBytes, std::size_t used, std::size_t capacity) {
+        onWrite(numBytes, used, capacity);
+    }
+
+    static std::size_t _bucket(std::size_t numBytes) {
+        return std::min<std::size_t>(std::bit_width(numBytes), BufferHistograms::sizeBuckets - 1);
+    }
+};
+
+#if __has_include(<sys/sdt.h>)
+#define NETWORK_BUFFER_PROBE(name, a, b) DTRACE_PROBE2(network_buffer, name, a, b)
+#elif defined(__x86_64__)
+// What <sys/sdt.h> would emit: a nop at the probe site and a
+//  .note.stapsdt entry telling tracers where it is and where to
+//  find the arguments
+#define NETWORK_BUFFER_PROBE(name, a, b) \
+    __asm__ __volatile__( \
+        "990: nop\n" \
+        ".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+        ".balign 4\n" \
+        ".4byte 992f-991f, 994f-993f, 3\n" \
+        "991: .asciz \"stapsdt\"\n" \
+        "992: .balign 4\n" \
+        "993: .8byte 990b\n" \
+        ".8byte _.stapsdt.base\n" \
+        ".8byte 0\n" \
+        ".asciz \"network_buffer\"\n" \
+        ".asciz \"" #name "\"\n" \
+        ".asciz \"8@%0 8@%1\"\n" \
+        "994: .balign 4\n" \
+        ".popsection\n" \
+        ".ifndef _.stapsdt.base\n" \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+        ".weak _.stapsdt.base\n" \
+        ".hidden _.stapsdt.base\n" \
+        "_.stapsdt.base: .space 1\n" \
+        ".size _.stapsdt.base, 1\n" \
+        ".popsection\n" \
+        ".endif\n" \
+        : : "nor"(static_cast<uint64_t>(a)), "nor"(static_cast<uint64_t>(b)))
+#else
+#define NETWORK_BUFFER_PROBE(name, a, b) ((void)(a), (void)(b))
+#endif
+
+/**
+ * Linux USDT (static tracepoint) probes, for bpftrace, perf or
+ * SystemTap to attach to in a running process:
+ *
+ *   network_buffer:write     (numBytes, used)
+ *   network_buffer:read      (numBytes, unread)
+ *   network_buffer:set_size  (numBytes, used)
+ *
+ *   bpftrace -e 'usdt:./server:network_buffer:write { @ = hist(arg0); }'
+ *
+ * Each probe is a single nop when nothing is attached.
+ */
+struct UsdtInstrumentation {
+    static void onWrite(std::size_t numBytes, std::size_t used, std::size_t) {
+        NETWORK_BUFFER_PROBE(write, numBytes, used);
+    }
+
+    static void onRead(std::size_t numBytes, std::size_t unread) {
+        NETWORK_BUFFER_PROBE(read, numBytes, unread);
+    }
+
+    static void onSetSize(std::size_t numBytes, std::size_t used, std::size_t) {
+        NETWORK_BUFFER_PROBE(set_size, numBytes, used);
+    }
+};
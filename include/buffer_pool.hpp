@@ -0,0 +1,382 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <source_location>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace pool_detail {
+    /**
+     * A cheap timestamp: the TSC where there is one, nanoseconds
+     * otherwise
+     */
+    inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    inline uint64_t nanoseconds() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * Add to a counter only this thread writes, without the cost of
+     * an atomic read-modify-write, so other threads can read it
+     */
+    inline void add(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * A snapshot of a BufferPool's counters (see BufferPool::stats)
+ */
+struct BufferPoolStats {
+    static constexpr std::size_t heldBuckets = 65;
+
+    std::size_t capacity = 0;
+    std::size_t inUse = 0;
+    std::size_t peakInUse = 0;
+    uint64_t acquires = 0;
+    // Acquires that found the pool empty
+    uint64_t failures = 0;
+    // Bucket b counts buffers that were held for [2^(b-1), 2^b)
+    //  clock ticks before being released, of those timed (see
+    //  BufferPoolTelemetry::timeEvery)
+    std::array<uint64_t, heldBuckets> heldTicks = {};
+    // For converting ticks to time
+    double ticksPerNs = 1;
+
+    std::size_t free() const {
+        return capacity - inUse;
+    }
+
+    /**
+     * The upper bound of a heldTicks bucket, in nanoseconds
+     */
+    double heldNs(std::size_t bucket) const {
+        return static_cast<double>(uint64_t(1) << std::min<std::size_t>(bucket, 63)) / ticksPerNs;
+    }
+};
+
+/**
+ * What a BufferPool records beyond its counters, chosen when it's
+ * constructed.  The pool's layout is the same either way.
+ */
+struct BufferPoolTelemetry {
+    // One in this many acquires (a power of 2) is timed for the held
+    //  time histogram.  Reading the clock can cost more than the rest
+    //  of acquire and release together.
+    uint64_t timeEvery = 64;
+    // Remember where each buffer was acquired, for forEachHeld
+    bool recordSites = false;
+};
+
+/**
+ * A fixed number of buffers allocated up front and handed out by
+ * index, so that holding on to a buffer (e.g. until the kernel is
+ * done with it, or until a packet is played out) never copies it
+ * or touches the allocator.
+ *
+ *   BufferPool<NetworkBuffer<1500>> pool(1024);
+ *   if (auto buffer = pool.acquire()) {
+ *       (*buffer)->write(...);
+ *   }   // back in the pool
+ *
+ * Buffers come out of the pool empty.  The pool must outlive
+ * its handles.
+ *
+ * By default the buffers are one heap allocation.  They can instead
+ * be placed in an arena (anything with allocate(size, align), e.g. a
+ * HugePageArena), which must outlive the pool.
+ *
+ * The pool is used from one thread, but its counters (see stats) can
+ * be read from any, e.g. by a metrics exporter.  It can also record
+ * where each buffer was acquired, to find leaks with forEachHeld:
+ *
+ *   BufferPool<NetworkBuffer<1500>> pool(1024, {.timeEvery = 1, .recordSites = true});
+ */
+template<typename Buffer>
+class BufferPool {
+public:
+    /**
+     * Owns one buffer of the pool, returning it when destroyed
+     */
+    class Handle {
+    public:
+        Handle() = default;
+
+        Handle(Handle&& other) :
+            _pool(other._pool), _index(other._index) {
+            other._pool = nullptr;
+        }
+
+        Handle& operator=(Handle&& other) {
+            if (this != &other) {
+                reset();
+                _pool = other._pool;
+                _index = other._index;
+                other._pool = nullptr;
+            }
+            return *this;
+        }
+
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+
+        ~Handle() {
+            reset();
+        }
+
+        /**
+         * Return the buffer to the pool now
+         */
+        void reset() {
+            if (_pool) {
+                _pool->_release(_index);
+                _pool = nullptr;
+            }
+        }
+
+        explicit operator bool() const {
+            return _pool != nullptr;
+        }
+
+        Buffer& operator*() const {
+            assert(_pool);
+            return _pool->_buffers[_index];
+        }
+
+        Buffer* operator->() const {
+            return &**this;
+        }
+
+        /**
+         * The buffer's position in the pool, stable for as long as
+         * the handle is held
+         */
+        uint32_t index() const {
+            return _index;
+        }
+
+        /**
+         * Give up ownership without returning the buffer: it stays
+         * checked out until passed to BufferPool::release.  Returns
+         * its index.
+         */
+        uint32_t release() {
+            assert(_pool);
+            _pool = nullptr;
+            return _index;
+        }
+
+    protected:
+        friend class BufferPool;
+
+        Handle(BufferPool* pool, uint32_t index) :
+            _pool(pool), _index(index) {}
+
+        BufferPool* _pool = nullptr;
+        uint32_t _index = 0;
+    };
+
+    explicit BufferPool(std::size_t capacity, BufferPoolTelemetry telemetry = {}) :
+        _owned(std::make_unique<Buffer[]>(capacity)), _buffers(_owned.get()), _capacity(capacity) {
+        _init(telemetry);
+    }
+
+    /**
+     * Place the buffers in the given arena.  Throws std::bad_alloc if
+     * the arena doesn't have room.
+     */
+    template<typename Arena>
+        requires requires(Arena& a) { a.allocate(std::size_t(), std::size_t()); }
+    BufferPool(std::size_t capacity, Arena& arena, BufferPoolTelemetry telemetry = {}) :
+        _capacity(capacity) {
+        void* memory = arena.allocate(sizeof(Buffer) * capacity, alignof(Buffer));
+        if (!memory) {
+            throw std::bad_alloc();
+        }
+        _buffers = static_cast<Buffer*>(memory);
+        for (std::size_t i = 0; i < capacity; ++i) {
+            new (&_buffers[i]) Buffer;
+        }
+        _init(telemetry);
+    }
+
+    ~BufferPool() {
+        if (!_owned) {
+            if constexpr (!std::is_trivially_destructible_v<Buffer>) {
+                for (std::size_t i = 0; i < _capacity; ++i) {
+                    _buffers[i].~Buffer();
+                }
+            }
+        }
+    }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /**
+     * Take an empty buffer, or nullopt if all are in use
+     */
+    std::optional<Handle> acquire(std::source_location site = std::source_location::current()) {
+        if (_free.empty()) {
+            pool_detail::add(_failures);
+            return std::nullopt;
+        }
+        uint32_t index = _free.back();
+        _free.pop_back();
+        pool_detail::add(_acquires);
+        std::size_t inUse = _capacity - _free.size();
+        if (inUse > _peakInUse.load(std::memory_order_relaxed)) {
+            _peakInUse.store(inUse, std::memory_order_relaxed);
+        }
+        // Only a sample of buffers are timed (see BufferPoolTelemetry)
+        uint64_t acquires = _acquires.load(std::memory_order_relaxed);
+        _acquiredAt[index] = (acquires & _timeMask) == 0 ? pool_detail::ticks() : 0;
+        if (!_sites.empty()) {
+            _sites[index] = site;
+        }
+        return Handle(this, index);
+    }
+
+    /**
+     * The buffer at the given index, for owners that keep indices
+     * (see Handle::release) rather than handles
+     */
+    Buffer& buffer(uint32_t index) const {
+        assert(index < _capacity);
+        return _buffers[index];
+    }
+
+    /**
+     * Return a buffer given up by Handle::release
+     */
+    void release(uint32_t index) {
+        _release(index);
+    }
+
+    std::size_t capacity() const {
+        return _capacity;
+    }
+
+    std::size_t available() const {
+        return _free.size();
+    }
+
+    /**
+     * The pool's counters.  Safe to call from any thread; each counter
+     * is read atomically, but they're not read all at the same instant.
+     */
+    BufferPoolStats stats() const {
+        BufferPoolStats stats;
+        stats.capacity = _capacity;
+        stats.acquires = _acquires.load(std::memory_order_relaxed);
+        uint64_t releases = _releases.load(std::memory_order_relaxed);
+        stats.inUse = stats.acquires > releases ? stats.acquires - releases : 0;
+        stats.peakInUse = _peakInUse.load(std::memory_order_relaxed);
+        stats.failures = _failures.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < stats.heldTicks.size(); ++i) {
+            stats.heldTicks[i] = _heldTicks[i].load(std::memory_order_relaxed);
+        }
+        // Calibrated over the pool's lifetime so far
+        double elapsedNs = static_cast<double>(pool_detail::nanoseconds() - _startNs);
+        if (elapsedNs > 0) {
+            stats.ticksPerNs = (pool_detail::ticks() - _startTicks) / elapsedNs;
+        }
+        return stats;
+    }
+
+    /**
+     * Call f(index, site, heldTicks) for each buffer currently held,
+     * with where it was acquired (only known if the pool records
+     * sites, see BufferPoolTelemetry) and for how long (0 if it
+     * isn't timed), e.g. to find leaks at shutdown.  Call from the
+     * pool's thread.
+     */
+    template<typename F>
+    void forEachHeld(F&& f) const {
+        std::vector<bool> free(_capacity);
+        for (uint32_t index : _free) {
+            free[index] = true;
+        }
+        uint64_t now = pool_detail::ticks();
+        for (uint32_t index = 0; index < _capacity; ++index) {
+            if (!free[index]) {
+                f(index, _sites.empty() ? std::source_location() : _sites[index],
+                  _acquiredAt[index] ? now - _acquiredAt[index] : 0);
+            }
+        }
+    }
+
+protected:
+    // Set unless the buffers are in an arena
+    std::unique_ptr<Buffer[]> _owned;
+    Buffer* _buffers = nullptr;
+    std::size_t _capacity;
+    std::vector<uint32_t> _free;
+    // When each buffer was acquired, in ticks, or 0 if it isn't timed
+    std::vector<uint64_t> _acquiredAt;
+    // Where each buffer was acquired, if recorded (otherwise empty)
+    std::vector<std::source_location> _sites;
+    // Acquires with these bits of their count clear are timed
+    uint64_t _timeMask = 0;
+
+    // Written only by the pool's thread, read by any
+    std::atomic<uint64_t> _acquires = 0;
+    std::atomic<uint64_t> _releases = 0;
+    std::atomic<uint64_t> _failures = 0;
+    std::atomic<std::size_t> _peakInUse = 0;
+    std::array<std::atomic<uint64_t>, BufferPoolStats::heldBuckets> _heldTicks = {};
+    uint64_t _startTicks = 0;
+    uint64_t _startNs = 0;
+
+    void _init(const BufferPoolTelemetry& telemetry) {
+        assert(telemetry.timeEvery > 0 && std::has_single_bit(telemetry.timeEvery));
+        _timeMask = telemetry.timeEvery - 1;
+        _free.reserve(_capacity);
+        // Hand out low indices first
+        for (std::size_t i = _capacity; i > 0; --i) {
+            _free.push_back(static_cast<uint32_t>(i - 1));
+        }
+        _acquiredAt.resize(_capacity);
+        if (telemetry.recordSites) {
+            _sites.resize(_capacity);
+        }
+        _startTicks = pool_detail::ticks();
+        _startNs = pool_detail::nanoseconds();
+    }
+
+    void _release(uint32_t index) {
+        Buffer& buffer = _buffers[index];
+        // Empty it for the next user
+        buffer.clear();
+        assert(_free.size() < _capacity);
+        _free.push_back(index);
+        pool_detail::add(_releases);
+        if (_acquiredAt[index]) {
+            uint64_t held = pool_detail::ticks() - _acquiredAt[index];
+            pool_detail::add(_heldTicks[std::bit_width(held)]);
+        }
+    }
+};
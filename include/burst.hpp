@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+namespace burst_detail {
+    constexpr std::size_t cacheLine = 64;
+
+    /**
+     * The buffer an element of a burst refers to: the element itself,
+     * or what it points to (a Buffer* or a pool handle)
+     */
+    template<typename T>
+    decltype(auto) bufferOf(T& item) {
+        if constexpr (requires { item.getBuffer(); }) {
+            return (item);
+        } else {
+            return (*item);
+        }
+    }
+
+    template<typename T>
+    void prefetch(T& item, std::size_t lines) {
+        // The buffer's positions are at its front, followed by its
+        //  data, so its first lines are what a parser touches first
+        auto* start = reinterpret_cast<const char*>(&bufferOf(item));
+        for (std::size_t line = 0; line < lines; ++line) {
+            __builtin_prefetch(start + line * cacheLine, 0, 3);
+        }
+    }
+}
+
+/**
+ * Call f(buffer) for each buffer of a burst (e.g. a batch received
+ * with recvmmsg) in order, while prefetching the first cache lines of
+ * the buffer distance places ahead, so that by the time f gets to a
+ * buffer its headers are in cache:
+ *
+ *   std::array<NetworkBuffer<1500>*, 32> burst;
+ *   forEachPrefetched(std::span(burst), [&](auto& buffer) {
+ *       if (auto rtp = RtpPacket::parse(buffer)) { ... }
+ *   });
+ *
+ * The burst can hold buffers, pointers to them or pool handles.  The
+ * best distance is about how many buffers f gets through in the time
+ * it takes to fetch one from memory; lines is how far into each
+ * buffer f reads.
+ */
+template<typename T, std::size_t Extent, typename F>
+void forEachPrefetched(std::span<T, Extent> burst, F&& f, std::size_t distance = 4, std::size_t lines = 2) {
+    std::size_t ahead = distance < burst.size() ? distance : burst.size();
+    for (std::size_t i = 0; i < ahead; ++i) {
+        burst_detail::prefetch(burst[i], lines);
+    }
+    for (std::size_t i = 0; i < burst.size(); ++i) {
+        if (i + distance < burst.size()) {
+            burst_detail::prefetch(burst[i + distance], lines);
+        }
+        f(burst_detail::bufferOf(burst[i]));
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Copies that bypass the cache, for large payloads that are written
+ * once and then handed off (to the kernel, to another core) rather
+ * than read again soon.  A normal copy pulls every destination line
+ * into L1 and L2, evicting whatever was there (e.g. the headers about
+ * to be parsed); non-temporal stores write whole cache lines straight
+ * to memory instead.
+ *
+ * The widest instruction set enabled at compile time is used (AVX2,
+ * then SSE2).  Without either, or for copies too small to be worth
+ * it, this is memcpy.
+ *
+ * Whether it pays off depends heavily on the machine: streaming stores
+ * are only cheap when the memory controller can take full lines, and
+ * some (notably virtualized) hosts make them several times slower
+ * than a cached copy.  Measure with bench/streaming_bench first.
+ */
+
+namespace byte_copy_detail {
+    constexpr std::size_t cacheLine = 64;
+
+#if defined(__AVX2__)
+    struct Avx2 {
+        using Vec = __m256i;
+        static constexpr std::size_t width = 32;
+        static Vec load(const uint8_t* src) { return _mm256_loadu_si256(reinterpret_cast<const Vec*>(src)); }
+        static void stream(uint8_t* dst, Vec v) { _mm256_stream_si256(reinterpret_cast<Vec*>(dst), v); }
+    };
+#endif
+
+#if defined(__SSE2__)
+    struct Sse2 {
+        using Vec = __m128i;
+        static constexpr std::size_t width = 16;
+        static Vec load(const uint8_t* src) { return _mm_loadu_si128(reinterpret_cast<const Vec*>(src)); }
+        static void stream(uint8_t* dst, Vec v) { _mm_stream_si128(reinterpret_cast<Vec*>(dst), v); }
+    };
+#endif
+
+    /**
+     * Stream whole cache lines to a line aligned destination.
+     * Returns the number of bytes copied.
+     */
+    template<typename V>
+    inline std::size_t streamLines(uint8_t* dst, const uint8_t* src, std::size_t numBytes) {
+        constexpr std::size_t perLine = cacheLine / V::width;
+        std::size_t copied = 0;
+        for (; numBytes - copied >= cacheLine; copied += cacheLine) {
+            typename V::Vec line[perLine];
+            for (std::size_t i = 0; i < perLine; ++i) {
+                line[i] = V::load(src + copied + i * V::width);
+            }
+            for (std::size_t i = 0; i < perLine; ++i) {
+                V::stream(dst + copied + i * V::width, line[i]);
+            }
+        }
+        return copied;
+    }
+}
+
+// Below this a streaming copy isn't worth its fence
+constexpr std::size_t minStreamingCopy = 1024;
+
+/**
+ * memcpy, but with non-temporal stores: the destination is not left
+ * in the cache.  The stores are fenced before returning, so they're
+ * ordered before anything that follows (e.g. publishing the buffer
+ * to another thread).
+ */
+inline void copyStreaming(uint8_t* dst, const uint8_t* src, std::size_t numBytes) {
+#if defined(__SSE2__)
+    if (numBytes >= minStreamingCopy) {
+        // Normal stores up to the first line boundary, so that every
+        //  streamed line is written whole
+        std::size_t head = -reinterpret_cast<uintptr_t>(dst) & (byte_copy_detail::cacheLine - 1);
+        memcpy(dst, src, head);
+        dst += head;
+        src += head;
+        numBytes -= head;
+#if defined(__AVX2__)
+        std::size_t streamed = byte_copy_detail::streamLines<byte_copy_detail::Avx2>(dst, src, numBytes);
+#else
+        std::size_t streamed = byte_copy_detail::streamLines<byte_copy_detail::Sse2>(dst, src, numBytes);
+#endif
+        _mm_sfence();
+        dst += streamed;
+        src += streamed;
+        numBytes -= streamed;
+    }
+#endif
+    if (numBytes > 0) {
+        memcpy(dst, src, numBytes);
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * Convert an unsigned integer of any width between
+ * host and network order
+ */
+template<typename T>
+inline T toNetwork(T val) {
+    static_assert(std::is_unsigned_v<T>, "only unsigned types are supported");
+    if constexpr (sizeof(T) == 1) {
+        return val;
+    } else if constexpr (sizeof(T) == 2) {
+        return htons(val);
+    } else if constexpr (sizeof(T) == 4) {
+        return htonl(val);
+    } else {
+        static_assert(sizeof(T) == 8, "unsupported width");
+        return htobe64(val);
+    }
+}
+
+template<typename T>
+inline T fromNetwork(T val) {
+    // Byte swapping is its own inverse
+    return toNetwork(val);
+}
+
+/**
+ * Read a network order value from an arbitrary
+ * (possibly unaligned) location
+ */
+template<typename T>
+inline T loadNetwork(const uint8_t* src) {
+    T val;
+    memcpy(&val, src, sizeof(T));
+    return fromNetwork(val);
+}
+
+/**
+ * Write a value in network order to an arbitrary
+ * (possibly unaligned) location
+ */
+template<typename T>
+inline void storeNetwork(uint8_t* dst, T val) {
+    T networkVal = toNetwork(val);
+    memcpy(dst, &networkVal, sizeof(T));
+}
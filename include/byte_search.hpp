@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Vectorized searches over a range of bytes.  Each returns a
+ * pointer to the first match, or end if there is none.
+ *
+ * The widest instruction set enabled at compile time is used
+ * (AVX2, then SSE2), finishing with a scalar loop for the
+ * bytes that don't fill a whole vector.
+ */
+
+namespace byte_search_detail {
+#if defined(__AVX2__)
+    struct Avx2 {
+        using Vec = __m256i;
+        static constexpr std::size_t width = 32;
+        static Vec splat(uint8_t val) { return _mm256_set1_epi8(static_cast<char>(val)); }
+        static Vec load(const uint8_t* src) { return _mm256_loadu_si256(reinterpret_cast<const Vec*>(src)); }
+        static Vec eq(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+        static Vec bitAnd(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+        static Vec bitOr(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+        static Vec zero() { return _mm256_setzero_si256(); }
+        static uint32_t mask(Vec v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+    };
+#endif
+
+#if defined(__SSE2__)
+    struct Sse2 {
+        using Vec = __m128i;
+        static constexpr std::size_t width = 16;
+        static Vec splat(uint8_t val) { return _mm_set1_epi8(static_cast<char>(val)); }
+        static Vec load(const uint8_t* src) { return _mm_loadu_si128(reinterpret_cast<const Vec*>(src)); }
+        static Vec eq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+        static Vec bitAnd(Vec a, Vec b) { return _mm_and_si128(a, b); }
+        static Vec bitOr(Vec a, Vec b) { return _mm_or_si128(a, b); }
+        static Vec zero() { return _mm_setzero_si128(); }
+        static uint32_t mask(Vec v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+    };
+#endif
+
+    // Sets larger than this fall back to a lookup table
+    constexpr std::size_t maxVectorSetSize = 8;
+
+    template<typename V>
+    inline const uint8_t* findByte(const uint8_t*& pos, const uint8_t* end, uint8_t val) {
+        const auto needle = V::splat(val);
+        for (; static_cast<std::size_t>(end - pos) >= V::width; pos += V::width) {
+            uint32_t mask = V::mask(V::eq(V::load(pos), needle));
+            if (mask) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+        return nullptr;
+    }
+
+    template<typename V>
+    inline const uint8_t* findAnyByte(const uint8_t*& pos, const uint8_t* end, std::span<const uint8_t> set) {
+        typename V::Vec needles[maxVectorSetSize];
+        for (std::size_t i = 0; i < set.size(); ++i) {
+            needles[i] = V::splat(set[i]);
+        }
+        for (; static_cast<std::size_t>(end - pos) >= V::width; pos += V::width) {
+            auto chunk = V::load(pos);
+            auto matches = V::zero();
+            for (std::size_t i = 0; i < set.size(); ++i) {
+                matches = V::bitOr(matches, V::eq(chunk, needles[i]));
+            }
+            uint32_t mask = V::mask(matches);
+            if (mask) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * Filter candidate positions by comparing the first and last
+     * bytes of the needle at once, then confirm with memcmp
+     */
+    template<typename V>
+    inline const uint8_t* findBytes(const uint8_t*& pos, const uint8_t* end, std::span<const uint8_t> needle) {
+        const std::size_t lastOffset = needle.size() - 1;
+        const auto first = V::splat(needle.front());
+        const auto last = V::splat(needle.back());
+        for (; static_cast<std::size_t>(end - pos) >= V::width + lastOffset; pos += V::width) {
+            uint32_t mask = V::mask(V::bitAnd(V::eq(V::load(pos), first),
+                                              V::eq(V::load(pos + lastOffset), last)));
+            while (mask) {
+                const uint8_t* candidate = pos + __builtin_ctz(mask);
+                if (memcmp(candidate + 1, needle.data() + 1, lastOffset - 1) == 0) {
+                    return candidate;
+                }
+                mask &= mask - 1;
+            }
+        }
+        return nullptr;
+    }
+}
+
+inline const uint8_t* findByte(const uint8_t* pos, const uint8_t* end, uint8_t val) {
+#if defined(__AVX2__)
+    if (auto match = byte_search_detail::findByte<byte_search_detail::Avx2>(pos, end, val)) {
+        return match;
+    }
+#endif
+#if defined(__SSE2__)
+    if (auto match = byte_search_detail::findByte<byte_search_detail::Sse2>(pos, end, val)) {
+        return match;
+    }
+#endif
+    for (; pos < end; ++pos) {
+        if (*pos == val) {
+            return pos;
+        }
+    }
+    return end;
+}
+
+/**
+ * Find the first byte which is any of the bytes in set
+ */
+inline const uint8_t* findAnyByte(const uint8_t* pos, const uint8_t* end, std::span<const uint8_t> set) {
+    if (set.empty()) {
+        return end;
+    }
+    if (set.size() == 1) {
+        return findByte(pos, end, set[0]);
+    }
+    if (set.size() <= byte_search_detail::maxVectorSetSize) {
+#if defined(__AVX2__)
+        if (auto match = byte_search_detail::findAnyByte<byte_search_detail::Avx2>(pos, end, set)) {
+            return match;
+        }
+#endif
+#if defined(__SSE2__)
+        if (auto match = byte_search_detail::findAnyByte<byte_search_detail::Sse2>(pos, end, set)) {
+            return match;
+        }
+#endif
+    }
+    bool inSet[256] = {};
+    for (uint8_t b : set) {
+        inSet[b] = true;
+    }
+    for (; pos < end; ++pos) {
+        if (inSet[*pos]) {
+            return pos;
+        }
+    }
+    return end;
+}
+
+/**
+ * Find the first occurrence of needle.  An empty needle
+ * matches at pos.
+ */
+inline const uint8_t* findBytes(const uint8_t* pos, const uint8_t* end, std::span<const uint8_t> needle) {
+    if (needle.empty()) {
+        return pos;
+    }
+    if (needle.size() == 1) {
+        return findByte(pos, end, needle[0]);
+    }
+    if (static_cast<std::size_t>(end - pos) < needle.size()) {
+        return end;
+    }
+#if defined(__AVX2__)
+    if (auto match = byte_search_detail::findBytes<byte_search_detail::Avx2>(pos, end, needle)) {
+        return match;
+    }
+#endif
+#if defined(__SSE2__)
+    if (auto match = byte_search_detail::findBytes<byte_search_detail::Sse2>(pos, end, needle)) {
+        return match;
+    }
+#endif
+    for (const uint8_t* last = end - needle.size(); pos <= last; ++pos) {
+        if (*pos == needle[0] && memcmp(pos + 1, needle.data() + 1, needle.size() - 1) == 0) {
+            return pos;
+        }
+    }
+    return end;
+}
@@ -0,0 +1,454 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "byte_order.hpp"
+
+/**
+ * RFC 1035 DNS messages, parsed in place.  Names are never
+ * materialized: DnsName refers to the encoded labels in the
+ * message (following compression pointers as it goes) and can
+ * be compared against a dotted name without allocating.
+ */
+
+struct DnsHeader {
+    uint16_t id;
+    uint16_t flags;
+    uint16_t questionCount;
+    uint16_t answerCount;
+    uint16_t authorityCount;
+    uint16_t additionalCount;
+
+    static constexpr std::size_t size = 12;
+};
+
+namespace dns_detail {
+    constexpr std::size_t maxNameLength = 255;
+    // A name can't have more labels than this without exceeding
+    //  maxNameLength, so following more pointers means a loop
+    constexpr std::size_t maxLabels = 128;
+
+    inline uint8_t toLower(uint8_t c) {
+        return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
+    inline bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            // Only letters differ by 0x20 between cases, so check that first
+            uint8_t diff = a[i] ^ b[i];
+            if (diff && (diff != 0x20 || toLower(a[i]) != toLower(b[i]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+/**
+ * A name within a message.  Only valid while the message's bytes are.
+ */
+class DnsName {
+public:
+    DnsName(std::span<const uint8_t> message, std::size_t offset) :
+        _message(message), _offset(offset) {}
+
+    /**
+     * Call f(label) with each label in order, as a string_view into the
+     * message.  f returns false to stop early.  Returns false if the
+     * name is malformed (as far as it was walked): it runs off the end
+     * of the message, has a pointer loop or is too long.
+     */
+    template<typename F>
+    bool forEachLabel(F&& f) const {
+        std::size_t pos = _offset;
+        std::size_t length = 0;
+        for (std::size_t labels = 0; labels < dns_detail::maxLabels; ++labels) {
+            if (pos >= _message.size()) {
+                return false;
+            }
+            uint8_t len = _message[pos];
+            if ((len & 0xC0) == 0xC0) {
+                if (pos + 1 >= _message.size()) {
+                    return false;
+                }
+                pos = loadNetwork<uint16_t>(_message.data() + pos) & 0x3FFF;
+                continue;
+            }
+            if (len & 0xC0) {
+                // Extended label types are obsolete
+                return false;
+            }
+            if (len == 0) {
+                return true;
+            }
+            length += len + 1;
+            if (pos + 1 + len > _message.size() || length > dns_detail::maxNameLength) {
+                return false;
+            }
+            if (!f(std::string_view(reinterpret_cast<const char*>(_message.data() + pos + 1), len))) {
+                return true;
+            }
+            pos += 1 + len;
+        }
+        return false;
+    }
+
+    bool valid() const {
+        return forEachLabel([](std::string_view) { return true; });
+    }
+
+    /**
+     * Case-insensitive comparison with a dotted name ("example.com",
+     * a trailing dot is optional)
+     */
+    bool equals(std::string_view dotted) const {
+        if (!dotted.empty() && dotted.back() == '.') {
+            dotted.remove_suffix(1);
+        }
+        // Most mismatches differ in the length of the first label, which
+        //  can be checked without walking
+        if (_offset < _message.size() && !(_message[_offset] & 0xC0)) {
+            std::size_t len = _message[_offset];
+            if (dotted.size() < len || (dotted.size() > len && dotted[len] != '.')) {
+                return false;
+            }
+        }
+        bool match = true;
+        bool first = true;
+        bool valid = forEachLabel([&](std::string_view label) {
+            if (!first) {
+                if (dotted.empty() || dotted.front() != '.') {
+                    return match = false;
+                }
+                dotted.remove_prefix(1);
+            }
+            first = false;
+            if (dotted.size() < label.size() || !dns_detail::equalsIgnoreCase(label, dotted.substr(0, label.size()))) {
+                return match = false;
+            }
+            dotted.remove_prefix(label.size());
+            return true;
+        });
+        return valid && match && dotted.empty();
+    }
+
+    /**
+     * Case-insensitive comparison with another name, possibly in
+     * another message
+     */
+    bool equals(const DnsName& other) const {
+        // Compare label by label: collect ours first (no name has more
+        //  than maxLabels) then walk theirs
+        std::string_view labels[dns_detail::maxLabels];
+        std::size_t count = 0;
+        if (!forEachLabel([&](std::string_view label) { labels[count++] = label; return true; })) {
+            return false;
+        }
+        std::size_t index = 0;
+        bool match = true;
+        bool valid = other.forEachLabel([&](std::string_view label) {
+            if (index == count || !dns_detail::equalsIgnoreCase(label, labels[index])) {
+                return match = false;
+            }
+            ++index;
+            return true;
+        });
+        return valid && match && index == count;
+    }
+
+    /**
+     * Write the name in dotted form, returning its length, or nullopt
+     * if it's malformed or doesn't fit
+     */
+    std::optional<std::size_t> toDotted(std::span<char> out) const {
+        std::size_t len = 0;
+        bool fits = true;
+        bool valid = forEachLabel([&](std::string_view label) {
+            std::size_t needed = label.size() + (len ? 1 : 0);
+            if (len + needed > out.size()) {
+                return fits = false;
+            }
+            if (len) {
+                out[len++] = '.';
+            }
+            memcpy(out.data() + len, label.data(), label.size());
+            len += label.size();
+            return true;
+        });
+        if (!valid || !fits) {
+            return std::nullopt;
+        }
+        return len;
+    }
+
+    /**
+     * The offset of the name's first byte in the message
+     */
+    std::size_t offset() const {
+        return _offset;
+    }
+
+protected:
+    std::span<const uint8_t> _message;
+    std::size_t _offset;
+};
+
+struct DnsQuestion {
+    DnsName name;
+    uint16_t type;
+    uint16_t qclass;
+};
+
+struct DnsRecord {
+    DnsName name;
+    uint16_t type;
+    uint16_t rclass;
+    uint32_t ttl;
+    std::span<const uint8_t> data;
+    // Where data starts in the message, for names within record data
+    std::size_t dataOffset;
+};
+
+/**
+ * Walks a message's sections in order.  Every question and record
+ * refers into the message, nothing is copied.
+ */
+class DnsReader {
+public:
+    explicit DnsReader(std::span<const uint8_t> message) :
+        _message(message) {}
+
+    /**
+     * Read the unread bytes of a buffer (its position is not moved)
+     */
+    template<typename Buffer>
+        requires requires(const Buffer& b) { b.getBuffer(); b.size(); }
+    explicit DnsReader(const Buffer& buffer) :
+        DnsReader(std::span<const uint8_t>(buffer.getBuffer(), buffer.size())) {}
+
+    std::optional<DnsHeader> header() {
+        if (_message.size() < DnsHeader::size) {
+            return std::nullopt;
+        }
+        const uint8_t* data = _message.data();
+        _pos = DnsHeader::size;
+        return DnsHeader{
+            loadNetwork<uint16_t>(data), loadNetwork<uint16_t>(data + 2),
+            loadNetwork<uint16_t>(data + 4), loadNetwork<uint16_t>(data + 6),
+            loadNetwork<uint16_t>(data + 8), loadNetwork<uint16_t>(data + 10),
+        };
+    }
+
+    std::optional<DnsQuestion> question() {
+        auto name = _name();
+        if (!name || _pos + 4 > _message.size()) {
+            return std::nullopt;
+        }
+        DnsQuestion question{*name, loadNetwork<uint16_t>(_message.data() + _pos),
+                             loadNetwork<uint16_t>(_message.data() + _pos + 2)};
+        _pos += 4;
+        return question;
+    }
+
+    std::optional<DnsRecord> record() {
+        auto name = _name();
+        if (!name || _pos + 10 > _message.size()) {
+            return std::nullopt;
+        }
+        const uint8_t* data = _message.data() + _pos;
+        std::size_t dataLen = loadNetwork<uint16_t>(data + 8);
+        std::size_t dataOffset = _pos + 10;
+        if (dataOffset + dataLen > _message.size()) {
+            return std::nullopt;
+        }
+        _pos = dataOffset + dataLen;
+        return DnsRecord{*name, loadNetwork<uint16_t>(data), loadNetwork<uint16_t>(data + 2),
+                         loadNetwork<uint32_t>(data + 4), _message.subspan(dataOffset, dataLen), dataOffset};
+    }
+
+    /**
+     * A name within record data (e.g. of a CNAME)
+     */
+    DnsName nameAt(std::size_t offset) const {
+        return DnsName(_message, offset);
+    }
+
+protected:
+    std::span<const uint8_t> _message;
+    std::size_t _pos = DnsHeader::size;
+
+    /**
+     * Validate the name at the current position and skip past it (up
+     * to its terminating zero or first pointer)
+     */
+    std::optional<DnsName> _name() {
+        DnsName name(_message, _pos);
+        if (!name.valid()) {
+            return std::nullopt;
+        }
+        while (true) {
+            uint8_t len = _message[_pos];
+            if ((len & 0xC0) == 0xC0) {
+                _pos += 2;
+                break;
+            }
+            _pos += 1 + len;
+            if (len == 0) {
+                break;
+            }
+        }
+        return name;
+    }
+};
+
+/**
+ * Writes messages into a buffer, compressing names.  The suffix of
+ * every name written is remembered (by hash, in a small open-addressed
+ * table of offsets into the message) so that a later name ending in
+ * the same labels is written as a pointer.
+ *
+ * The message must start at the buffer's write position when the
+ * writer is created, and the buffer must not be compacted while
+ * the message is being written.
+ */
+template<typename Buffer, std::size_t TableSize = 64>
+class DnsWriter {
+public:
+    static_assert((TableSize & (TableSize - 1)) == 0, "table size must be a power of 2");
+
+    explicit DnsWriter(Buffer& buffer) :
+        _buffer(buffer), _start(buffer.getWriteBuffer()) {}
+
+    void writeHeader(const DnsHeader& header) {
+        _buffer.write(header.id);
+        _buffer.write(header.flags);
+        _buffer.write(header.questionCount);
+        _buffer.write(header.answerCount);
+        _buffer.write(header.authorityCount);
+        _buffer.write(header.additionalCount);
+    }
+
+    /**
+     * Write a dotted name, using a pointer for the longest suffix
+     * already in the message
+     */
+    void writeName(std::string_view dotted) {
+        if (!dotted.empty() && dotted.back() == '.') {
+            dotted.remove_suffix(1);
+        }
+        // Hash every suffix in one pass from the end: the hash of each
+        //  suffix continues from the hash of the one after it
+        std::size_t starts[dns_detail::maxLabels];
+        uint32_t hashes[dns_detail::maxLabels];
+        std::size_t count = 0;
+        uint32_t hash = 2166136261u;
+        for (std::size_t i = dotted.size(); i-- > 0;) {
+            hash = (hash ^ dns_detail::toLower(dotted[i])) * 16777619u;
+            if (i == 0 || dotted[i - 1] == '.') {
+                assert(count < dns_detail::maxLabels);
+                starts[count] = i;
+                hashes[count++] = hash;
+            }
+        }
+        // Starting from the whole name, look for the longest suffix
+        //  already written
+        while (count > 0) {
+            --count;
+            std::string_view suffix = dotted.substr(starts[count]);
+            if (auto offset = _find(suffix, hashes[count])) {
+                _buffer.write(static_cast<uint16_t>(0xC000 | *offset));
+                return;
+            }
+            std::size_t offset = size();
+            if (offset < 0x4000) {
+                _insert(hashes[count], offset);
+            }
+            std::string_view label = suffix.substr(0, suffix.find('.'));
+            assert(!label.empty() && label.size() < 64);
+            _buffer.write(static_cast<uint8_t>(label.size()));
+            _buffer.write(reinterpret_cast<const uint8_t*>(label.data()), label.size());
+        }
+        _buffer.write(static_cast<uint8_t>(0));
+    }
+
+    void writeQuestion(std::string_view name, uint16_t type, uint16_t qclass = 1) {
+        writeName(name);
+        _buffer.write(type);
+        _buffer.write(qclass);
+    }
+
+    void writeRecord(std::string_view name, uint16_t type, uint16_t rclass, uint32_t ttl,
+                     std::span<const uint8_t> data) {
+        writeName(name);
+        _buffer.write(type);
+        _buffer.write(rclass);
+        _buffer.write(ttl);
+        assert(data.size() <= 0xFFFF);
+        _buffer.write(static_cast<uint16_t>(data.size()));
+        _buffer.write(data.data(), data.size());
+    }
+
+    /**
+     * Write a record whose data is a (compressed) name, e.g. CNAME
+     */
+    void writeNameRecord(std::string_view name, uint16_t type, uint16_t rclass, uint32_t ttl,
+                         std::string_view target) {
+        writeName(name);
+        _buffer.write(type);
+        _buffer.write(rclass);
+        _buffer.write(ttl);
+        auto slot = _buffer.template beginLenPrefixed<uint16_t>();
+        writeName(target);
+        _buffer.endLenPrefixed(slot);
+    }
+
+    /**
+     * The number of bytes written so far
+     */
+    std::size_t size() const {
+        return _buffer.getWriteBuffer() - _start;
+    }
+
+protected:
+    Buffer& _buffer;
+    uint8_t* _start;
+    // Offsets of name suffixes in the message, 0 for an empty slot
+    //  (the header is at offset 0, so no name can be there)
+    uint16_t _offsets[TableSize] = {};
+    uint32_t _hashes[TableSize] = {};
+
+    std::optional<std::size_t> _find(std::string_view dotted, uint32_t hash) const {
+        std::span<const uint8_t> message{_start, size()};
+        for (std::size_t i = 0; i < TableSize; ++i) {
+            std::size_t slot = (hash + i) & (TableSize - 1);
+            if (_offsets[slot] == 0) {
+                return std::nullopt;
+            }
+            if (_hashes[slot] == hash && DnsName(message, _offsets[slot]).equals(dotted)) {
+                return _offsets[slot];
+            }
+        }
+        return std::nullopt;
+    }
+
+    void _insert(uint32_t hash, std::size_t offset) {
+        for (std::size_t i = 0; i < TableSize; ++i) {
+            std::size_t slot = (hash + i) & (TableSize - 1);
+            if (_offsets[slot] == 0) {
+                _offsets[slot] = static_cast<uint16_t>(offset);
+                _hashes[slot] = hash;
+                return;
+            }
+        }
+        // The table is full: later names just won't be compressed as well
+    }
+};
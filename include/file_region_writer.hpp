@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * Sends a message made of a header built in a buffer followed by a
+ * region of a file, without copying the file through userspace: the
+ * header is sent from the buffer and the file region with sendfile
+ * (or splice, through a pipe).  The header is held back until the
+ * file data follows it, either by sending it with MSG_MORE or by
+ * corking the socket, so a short header doesn't go out in a packet
+ * of its own.
+ *
+ *   FileRegionWriter<NetworkBuffer<64>> writer(sock);
+ *   writer.start(header, fileFd, offset, count);
+ *   while (!writer.done()) {
+ *       if (writer.send() < 0) { ... }   // EAGAIN: wait for POLLOUT
+ *   }
+ *
+ * The header is consumed from the buffer as it's sent, so the buffer
+ * must stay alive until the message is done.
+ *
+ * Unlike the header's send, sendfile and splice have no MSG_NOSIGNAL:
+ * writing to a socket the peer has closed raises SIGPIPE, so ignore it
+ * to get EPIPE instead.
+ */
+template<typename Buffer>
+class FileRegionWriter {
+public:
+    enum class Coalesce {
+        // Send the header with MSG_MORE
+        MsgMore,
+        // Set TCP_CORK for the whole message
+        Cork,
+    };
+
+    enum class Transfer {
+        Sendfile,
+        // Through a pipe, for files sendfile can't read from
+        Splice,
+    };
+
+    explicit FileRegionWriter(int sock, Coalesce coalesce = Coalesce::MsgMore,
+                              Transfer transfer = Transfer::Sendfile) :
+        _sock(sock), _coalesce(coalesce), _transfer(transfer) {}
+
+    ~FileRegionWriter() {
+        if (_pipe[0] >= 0) {
+            close(_pipe[0]);
+            close(_pipe[1]);
+        }
+    }
+
+    FileRegionWriter(const FileRegionWriter&) = delete;
+    FileRegionWriter& operator=(const FileRegionWriter&) = delete;
+
+    /**
+     * Begin a message of the header's unread bytes followed by count
+     * bytes of the file starting at offset.  The file's own position
+     * is not used or moved.  Returns false with errno set if the
+     * socket couldn't be corked, in which case no message is started.
+     */
+    bool start(Buffer& header, int fd, off_t offset, std::size_t count) {
+        assert(done());
+        if (_coalesce == Coalesce::Cork && !_setCork(1)) {
+            return false;
+        }
+        _header = &header;
+        _fd = fd;
+        _offset = offset;
+        _remaining = count;
+        return true;
+    }
+
+    /**
+     * Send as much of the message as the socket will take.  Returns
+     * the number of bytes sent, or -1 with errno set.  Any error but
+     * EAGAIN/EINTR ends the message where it is: the socket is uncorked,
+     * anything left in the pipe is dropped and done() becomes true, so
+     * the next message can be started (though the peer has only part
+     * of this one).  -1 is also returned if the message was sent in
+     * full but the socket couldn't be uncorked.
+     */
+    ssize_t send() {
+        std::size_t sent = 0;
+        while (_header && !_header->empty()) {
+            int flags = MSG_NOSIGNAL;
+            if (_coalesce == Coalesce::MsgMore && _remaining > 0) {
+                flags |= MSG_MORE;
+            }
+            ssize_t res = ::send(_sock, _header->getBuffer(), _header->size(), flags);
+            if (res < 0) {
+                return _fail(sent);
+            }
+            _header->read(res);
+            sent += res;
+        }
+        while (_remaining > 0) {
+            ssize_t res = _transfer == Transfer::Sendfile ? _sendfile() : _splice();
+            if (res == 0) {
+                // The file is shorter than the region
+                errno = EIO;
+            }
+            if (res <= 0) {
+                return _fail(sent);
+            }
+            sent += res;
+        }
+        if (_header) {
+            _header = nullptr;
+            if (_coalesce == Coalesce::Cork && !_setCork(0)) {
+                return -1;
+            }
+        }
+        return sent;
+    }
+
+    /**
+     * Whether the last message has been sent in full
+     */
+    bool done() const {
+        return _header == nullptr;
+    }
+
+    /**
+     * Bytes of the file region not yet sent
+     */
+    std::size_t remaining() const {
+        return _remaining;
+    }
+
+protected:
+    int _sock;
+    Coalesce _coalesce;
+    Transfer _transfer;
+    Buffer* _header = nullptr;
+    int _fd = -1;
+    off_t _offset = 0;
+    std::size_t _remaining = 0;
+    // For splice: the pipe, and how much of it is filled but not yet
+    //  moved on to the socket
+    int _pipe[2] = { -1, -1 };
+    std::size_t _piped = 0;
+
+    bool _setCork(int on) {
+        return setsockopt(_sock, IPPROTO_TCP, TCP_CORK, &on, sizeof(on)) == 0;
+    }
+
+    /**
+     * Report an error from send, having already sent the given number
+     * of bytes.  Those are reported first: the error will come up
+     * again on the next call, and only then is the message abandoned.
+     */
+    ssize_t _fail(std::size_t sent) {
+        if (sent) {
+            return sent;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            int error = errno;
+            _abandon();
+            errno = error;
+        }
+        return -1;
+    }
+
+    void _abandon() {
+        _header = nullptr;
+        _remaining = 0;
+        if (_piped) {
+            // There's no way to empty a pipe without reading it out:
+            //  make a new one next time instead
+            close(_pipe[0]);
+            close(_pipe[1]);
+            _pipe[0] = _pipe[1] = -1;
+            _piped = 0;
+        }
+        if (_coalesce == Coalesce::Cork) {
+            _setCork(0);
+        }
+    }
+
+    ssize_t _sendfile() {
+        ssize_t res = sendfile(_sock, _fd, &_offset, _remaining);
+        if (res > 0) {
+            _remaining -= res;
+        }
+        return res;
+    }
+
+    ssize_t _splice() {
+        if (_pipe[0] < 0 && pipe2(_pipe, O_CLOEXEC) < 0) {
+            return -1;
+        }
+        if (_piped == 0) {
+            ssize_t res = splice(_fd, &_offset, _pipe[1], nullptr, _remaining, SPLICE_F_MOVE);
+            if (res <= 0) {
+                return res;
+            }
+            _piped = res;
+        }
+        unsigned int flags = SPLICE_F_MOVE;
+        if (_piped < _remaining) {
+            flags |= SPLICE_F_MORE;
+        }
+        ssize_t res = splice(_pipe[0], nullptr, _sock, nullptr, _piped, flags);
+        if (res > 0) {
+            _piped -= res;
+            _remaining -= res;
+        }
+        return res;
+    }
+};
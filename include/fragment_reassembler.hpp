@@ -0,0 +1,436 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
+#include <type_traits>
+
+#include "buffer_pool.hpp"
+#include "byte_order.hpp"
+#include "network_buffer.hpp"
+
+/**
+ * Identifies the datagram a fragment belongs to.  Addresses are
+ * stored IPv6-sized (IPv4 in the first 4 bytes) so both families
+ * share one table; the layout has no padding so keys compare with
+ * memcmp.
+ */
+struct FragmentKey {
+    uint8_t src[16] = {};
+    uint8_t dst[16] = {};
+    uint32_t id = 0;
+    uint8_t protocol = 0;
+    uint8_t version = 0;
+    uint16_t reserved = 0;
+
+    bool operator==(const FragmentKey& other) const {
+        return memcmp(this, &other, sizeof(FragmentKey)) == 0;
+    }
+};
+
+struct Fragment {
+    FragmentKey key;
+    // Of the payload, in bytes
+    std::size_t offset;
+    bool moreFragments;
+    std::span<const uint8_t> payload;
+};
+
+namespace fragment_detail {
+    inline uint64_t load64(const uint8_t* data) {
+        uint64_t val;
+        memcpy(&val, data, sizeof(val));
+        return val;
+    }
+
+    inline uint32_t hash(const FragmentKey& key) {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(&key);
+        uint64_t h = 0;
+        for (std::size_t i = 0; i < sizeof(FragmentKey); i += 8) {
+            h = (h ^ load64(data + i)) * 0x9E3779B97F4A7C15ull;
+            h ^= h >> 29;
+        }
+        return static_cast<uint32_t>(h ^ (h >> 32));
+    }
+
+    constexpr uint8_t ipv6HopByHop = 0;
+    constexpr uint8_t ipv6Routing = 43;
+    constexpr uint8_t ipv6Fragment = 44;
+    constexpr uint8_t ipv6DestinationOptions = 60;
+}
+
+static_assert(sizeof(FragmentKey) == 40, "FragmentKey must have no padding");
+
+/**
+ * Collects IPv4 and IPv6 fragments into whole datagrams.  Each datagram
+ * being reassembled gets a jumbo buffer from a pool when its first
+ * fragment arrives, and every fragment is copied straight to its
+ * offset in that buffer, so a completed datagram is already contiguous.
+ * Received ranges are tracked as up to MaxIntervals sorted intervals.
+ *
+ * Memory is fixed: at most Slots datagrams are in progress at once
+ * (found through an open-addressed index), each limited to MaxSize
+ * bytes.  Fragments that don't fit are dropped rather than evicting
+ * anything still in time.  Since overlapping fragments are only ever
+ * seen from broken or hostile senders, any overlap drops the whole
+ * datagram (as RFC 5722 requires for IPv6), as does a datagram split
+ * into more than MaxIntervals pieces with holes between them.
+ *
+ *   FragmentReassembler<> reassembler;
+ *   if (auto fragment = FragmentReassembler<>::parseIpv4(packet)) {
+ *       if (auto datagram = reassembler.add(*fragment, now)) {
+ *           handle(datagram->key, *datagram->buffer);
+ *       }
+ *   }
+ */
+template<std::size_t Slots = 64, std::size_t MaxSize = 65536, std::size_t MaxIntervals = 16>
+class FragmentReassembler {
+public:
+    static_assert((Slots & (Slots - 1)) == 0, "slots must be a power of 2");
+
+    using Buffer = NetworkBuffer<MaxSize>;
+    using Clock = std::chrono::steady_clock;
+
+    struct Datagram {
+        FragmentKey key;
+        // The reassembled payload, back to the pool when released
+        typename BufferPool<Buffer>::Handle buffer;
+    };
+
+    struct Stats {
+        std::size_t completed = 0;
+        std::size_t overlaps = 0;
+        std::size_t timeouts = 0;
+        // No slot or buffer was free for a new datagram
+        std::size_t noMemory = 0;
+        // Too big, too many holes or inconsistent lengths
+        std::size_t malformed = 0;
+    };
+
+    explicit FragmentReassembler(Clock::duration timeout = std::chrono::seconds(30), std::size_t extraBuffers = 8) :
+        _timeout(timeout), _pool(Slots + extraBuffers) {
+        for (auto& index : _index) {
+            index = empty;
+        }
+    }
+
+    FragmentReassembler(const FragmentReassembler&) = delete;
+    FragmentReassembler& operator=(const FragmentReassembler&) = delete;
+
+    /**
+     * The fragment within an IPv4 packet, or nullopt if it isn't a
+     * valid IPv4 packet.  An unfragmented packet is a fragment at
+     * offset 0 with no more to follow.
+     */
+    static std::optional<Fragment> parseIpv4(std::span<const uint8_t> packet) {
+        if (packet.size() < 20 || (packet[0] >> 4) != 4) {
+            return std::nullopt;
+        }
+        std::size_t headerSize = (packet[0] & 0x0F) * 4;
+        std::size_t totalSize = loadNetwork<uint16_t>(packet.data() + 2);
+        if (headerSize < 20 || totalSize < headerSize || totalSize > packet.size()) {
+            return std::nullopt;
+        }
+        uint16_t fragmentField = loadNetwork<uint16_t>(packet.data() + 6);
+        Fragment fragment;
+        fragment.key.id = loadNetwork<uint16_t>(packet.data() + 4);
+        fragment.key.protocol = packet[9];
+        fragment.key.version = 4;
+        memcpy(fragment.key.src, packet.data() + 12, 4);
+        memcpy(fragment.key.dst, packet.data() + 16, 4);
+        fragment.offset = (fragmentField & 0x1FFF) * 8;
+        fragment.moreFragments = fragmentField & 0x2000;
+        fragment.payload = packet.subspan(headerSize, totalSize - headerSize);
+        return fragment;
+    }
+
+    /**
+     * The fragment within an IPv6 packet, found by walking the extension
+     * headers that may precede a fragment header, or nullopt if it isn't
+     * a valid IPv6 packet.  A packet without a fragment header is a
+     * fragment at offset 0 with no more to follow.
+     */
+    static std::optional<Fragment> parseIpv6(std::span<const uint8_t> packet) {
+        if (packet.size() < 40 || (packet[0] >> 4) != 6) {
+            return std::nullopt;
+        }
+        std::size_t end = 40 + loadNetwork<uint16_t>(packet.data() + 4);
+        if (end > packet.size()) {
+            return std::nullopt;
+        }
+        Fragment fragment;
+        fragment.key.version = 6;
+        memcpy(fragment.key.src, packet.data() + 8, 16);
+        memcpy(fragment.key.dst, packet.data() + 24, 16);
+        uint8_t next = packet[6];
+        std::size_t pos = 40;
+        while (next == fragment_detail::ipv6HopByHop || next == fragment_detail::ipv6Routing ||
+               next == fragment_detail::ipv6DestinationOptions) {
+            if (pos + 8 > end) {
+                return std::nullopt;
+            }
+            next = packet[pos];
+            pos += (packet[pos + 1] + 1) * 8;
+        }
+        if (next != fragment_detail::ipv6Fragment) {
+            fragment.key.protocol = next;
+            fragment.offset = 0;
+            fragment.moreFragments = false;
+        } else {
+            if (pos + 8 > end) {
+                return std::nullopt;
+            }
+            uint16_t fragmentField = loadNetwork<uint16_t>(packet.data() + pos + 2);
+            fragment.key.protocol = packet[pos];
+            fragment.key.id = loadNetwork<uint32_t>(packet.data() + pos + 4);
+            fragment.offset = fragmentField & 0xFFF8;
+            fragment.moreFragments = fragmentField & 1;
+            pos += 8;
+        }
+        if (pos > end) {
+            return std::nullopt;
+        }
+        fragment.payload = packet.subspan(pos, end - pos);
+        return fragment;
+    }
+
+    /**
+     * Add a fragment, returning the datagram if it's now complete
+     */
+    std::optional<Datagram> add(const Fragment& fragment, Clock::time_point now) {
+        std::size_t begin = fragment.offset;
+        std::size_t end = begin + fragment.payload.size();
+        if (end > MaxSize || (fragment.moreFragments && (fragment.payload.size() % 8 != 0 || begin == end))) {
+            ++_stats.malformed;
+            if (auto slot = _find(fragment.key)) {
+                _drop(*slot);
+            }
+            return std::nullopt;
+        }
+        auto slot = _find(fragment.key);
+        if (slot && now - _entries[*slot].start > _timeout) {
+            ++_stats.timeouts;
+            _drop(*slot);
+            slot = std::nullopt;
+        }
+        if (!slot) {
+            slot = _create(fragment.key, now);
+            if (!slot) {
+                ++_stats.noMemory;
+                return std::nullopt;
+            }
+        }
+        Entry& entry = _entries[*slot];
+        if (!fragment.moreFragments) {
+            if (entry.lastSeen && entry.total != end) {
+                ++_stats.malformed;
+                _drop(*slot);
+                return std::nullopt;
+            }
+            entry.lastSeen = true;
+            entry.total = end;
+        }
+        if (entry.lastSeen && (end > entry.total || (entry.intervalCount > 0 &&
+            entry.intervals[entry.intervalCount - 1].end > entry.total))) {
+            ++_stats.malformed;
+            _drop(*slot);
+            return std::nullopt;
+        }
+        switch (begin == end ? IntervalResult::Added : _addInterval(entry, begin, end)) {
+            case IntervalResult::Added:
+                break;
+            case IntervalResult::Overlap:
+                ++_stats.overlaps;
+                _drop(*slot);
+                return std::nullopt;
+            case IntervalResult::TooMany:
+                ++_stats.malformed;
+                _drop(*slot);
+                return std::nullopt;
+        }
+        memcpy(entry.buffer->getWriteBuffer() + begin, fragment.payload.data(), fragment.payload.size());
+
+        bool complete = entry.total == 0 ? entry.intervalCount == 0 :
+            (entry.intervalCount == 1 && entry.intervals[0].begin == 0 && entry.intervals[0].end == entry.total);
+        if (entry.lastSeen && complete) {
+            entry.buffer->setSize(entry.total);
+            Datagram datagram{entry.key, std::move(entry.buffer)};
+            _drop(*slot);
+            ++_stats.completed;
+            return datagram;
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * Drop every datagram that has been waiting longer than the timeout.
+     * Call periodically: add only expires the datagram it touches.
+     */
+    std::size_t expire(Clock::time_point now) {
+        std::size_t expired = 0;
+        for (std::size_t i = 0; i < Slots; ++i) {
+            if (_entries[i].used && now - _entries[i].start > _timeout) {
+                _drop(i);
+                ++expired;
+            }
+        }
+        _stats.timeouts += expired;
+        return expired;
+    }
+
+    /**
+     * The number of datagrams partly received
+     */
+    std::size_t pending() const {
+        return _used;
+    }
+
+    const Stats& stats() const {
+        return _stats;
+    }
+
+protected:
+    // Entry numbers in the index, with the largest value kept free
+    //  to mark an empty position
+    using SlotIndex = std::conditional_t<(Slots < 0xFFFF), uint16_t, uint32_t>;
+    static_assert(Slots < std::numeric_limits<SlotIndex>::max(), "too many slots");
+    static constexpr SlotIndex empty = std::numeric_limits<SlotIndex>::max();
+    static constexpr std::size_t indexSize = Slots * 2;
+
+    struct Interval {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    struct Entry {
+        FragmentKey key;
+        Clock::time_point start;
+        typename BufferPool<Buffer>::Handle buffer;
+        // Known once the last fragment arrives
+        bool lastSeen = false;
+        std::size_t total = 0;
+        Interval intervals[MaxIntervals];
+        std::size_t intervalCount = 0;
+        bool used = false;
+    };
+
+    enum class IntervalResult {
+        Added,
+        Overlap,
+        TooMany,
+    };
+
+    Clock::duration _timeout;
+    BufferPool<Buffer> _pool;
+    Entry _entries[Slots];
+    // Open-addressed with linear probing: entry numbers, or empty
+    SlotIndex _index[indexSize];
+    std::size_t _used = 0;
+    Stats _stats;
+
+    std::optional<std::size_t> _find(const FragmentKey& key) const {
+        for (std::size_t pos = fragment_detail::hash(key) & (indexSize - 1);; pos = (pos + 1) & (indexSize - 1)) {
+            SlotIndex slot = _index[pos];
+            if (slot == empty) {
+                return std::nullopt;
+            }
+            if (_entries[slot].key == key) {
+                return slot;
+            }
+        }
+    }
+
+    std::optional<std::size_t> _create(const FragmentKey& key, Clock::time_point now) {
+        if (_used == Slots) {
+            return std::nullopt;
+        }
+        auto buffer = _pool.acquire();
+        if (!buffer) {
+            // Completed datagrams still held by the caller
+            return std::nullopt;
+        }
+        std::size_t slot = 0;
+        while (_entries[slot].used) {
+            ++slot;
+        }
+        Entry& entry = _entries[slot];
+        entry.key = key;
+        entry.start = now;
+        entry.buffer = std::move(*buffer);
+        entry.lastSeen = false;
+        entry.total = 0;
+        entry.intervalCount = 0;
+        entry.used = true;
+        ++_used;
+
+        std::size_t pos = fragment_detail::hash(key) & (indexSize - 1);
+        while (_index[pos] != empty) {
+            pos = (pos + 1) & (indexSize - 1);
+        }
+        _index[pos] = static_cast<SlotIndex>(slot);
+        return slot;
+    }
+
+    void _drop(std::size_t slot) {
+        Entry& entry = _entries[slot];
+        entry.buffer.reset();
+        entry.used = false;
+        --_used;
+
+        // Remove from the index, shifting back later entries of the
+        //  probe run so that lookups never stop early at a hole
+        std::size_t pos = fragment_detail::hash(entry.key) & (indexSize - 1);
+        while (_index[pos] != slot) {
+            pos = (pos + 1) & (indexSize - 1);
+        }
+        std::size_t hole = pos;
+        for (pos = (pos + 1) & (indexSize - 1); _index[pos] != empty; pos = (pos + 1) & (indexSize - 1)) {
+            std::size_t home = fragment_detail::hash(_entries[_index[pos]].key) & (indexSize - 1);
+            // Move it into the hole unless its home lies after the hole
+            //  (cyclically, within (hole, pos])
+            bool homeAfterHole = hole <= pos ? (home > hole && home <= pos) : (home > hole || home <= pos);
+            if (!homeAfterHole) {
+                _index[hole] = _index[pos];
+                hole = pos;
+            }
+        }
+        _index[hole] = empty;
+    }
+
+    IntervalResult _addInterval(Entry& entry, std::size_t begin, std::size_t end) {
+        // The first interval starting after the new one
+        std::size_t after = 0;
+        while (after < entry.intervalCount && entry.intervals[after].begin < begin) {
+            ++after;
+        }
+        if ((after > 0 && entry.intervals[after - 1].end > begin) ||
+            (after < entry.intervalCount && entry.intervals[after].begin < end)) {
+            return IntervalResult::Overlap;
+        }
+        bool joinsBefore = after > 0 && entry.intervals[after - 1].end == begin;
+        bool joinsAfter = after < entry.intervalCount && entry.intervals[after].begin == end;
+        if (joinsBefore && joinsAfter) {
+            entry.intervals[after - 1].end = entry.intervals[after].end;
+            memmove(entry.intervals + after, entry.intervals + after + 1,
+                    (entry.intervalCount - after - 1) * sizeof(Interval));
+            --entry.intervalCount;
+        } else if (joinsBefore) {
+            entry.intervals[after - 1].end = end;
+        } else if (joinsAfter) {
+            entry.intervals[after].begin = begin;
+        } else {
+            if (entry.intervalCount == MaxIntervals) {
+                return IntervalResult::TooMany;
+            }
+            memmove(entry.intervals + after + 1, entry.intervals + after,
+                    (entry.intervalCount - after) * sizeof(Interval));
+            entry.intervals[after] = {static_cast<uint32_t>(begin), static_cast<uint32_t>(end)};
+            ++entry.intervalCount;
+        }
+        return IntervalResult::Added;
+    }
+};
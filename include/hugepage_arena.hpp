@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <utility>
+
+#include <sys/mman.h>
+
+/**
+ * One large anonymous mapping backed by 2 MB pages, carved up by a
+ * bump allocator, to hold big pools of buffers without a TLB miss on
+ * every buffer touched:
+ *
+ *   auto arena = HugePageArena::create(64 << 20);
+ *   BufferPool<NetworkBuffer<1500>> pool(32768, *arena);
+ *
+ * Explicit huge pages (MAP_HUGETLB) are used if the system has them
+ * reserved, otherwise transparent huge pages are requested with
+ * madvise(MADV_HUGEPAGE).  Every page is faulted in by create, so
+ * the data path never takes a page fault.  The kernel may not give
+ * transparent huge pages for all of the arena; hugePages() tells how
+ * many it did.
+ */
+class HugePageArena {
+public:
+    static constexpr std::size_t hugePageSize = 2 << 20;
+
+    enum class Pages {
+        // MAP_HUGETLB from the reserved pool
+        HugeTlb,
+        // MADV_HUGEPAGE, at the kernel's discretion
+        Transparent,
+        // 4 KB pages only (MADV_NOHUGEPAGE), e.g. as a baseline
+        Small,
+    };
+
+    /**
+     * Map and fault in an arena of at least size bytes (rounded up
+     * to whole huge pages).  Asking for HugeTlb falls back to
+     * Transparent if no huge pages are reserved; see pages() for
+     * which was used.  Returns nullopt if nothing could be mapped.
+     */
+    static std::optional<HugePageArena> create(std::size_t size, Pages pages = Pages::HugeTlb) {
+        size = (size + hugePageSize - 1) / hugePageSize * hugePageSize;
+        if (pages == Pages::HugeTlb) {
+            void* region = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+            if (region != MAP_FAILED) {
+                return HugePageArena(static_cast<uint8_t*>(region), size, Pages::HugeTlb);
+            }
+            pages = Pages::Transparent;
+        }
+        // Over-map by a huge page so the arena can start on a huge page
+        //  boundary: the kernel only backs aligned 2 MB ranges with one
+        std::size_t mapped = size + hugePageSize;
+        void* region = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+            return std::nullopt;
+        }
+        auto* start = static_cast<uint8_t*>(region);
+        auto* aligned = reinterpret_cast<uint8_t*>(
+            (reinterpret_cast<uintptr_t>(start) + hugePageSize - 1) & ~(hugePageSize - 1));
+        if (aligned > start) {
+            munmap(start, aligned - start);
+        }
+        std::size_t after = start + mapped - (aligned + size);
+        if (after > 0) {
+            munmap(aligned + size, after);
+        }
+        madvise(aligned, size, pages == Pages::Transparent ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+        // Fault it all in now.  Writing (not reading) is what gets
+        //  real pages rather than the shared zero page.
+        for (std::size_t offset = 0; offset < size; offset += 4096) {
+            aligned[offset] = 0;
+        }
+        return HugePageArena(aligned, size, pages);
+    }
+
+    HugePageArena(HugePageArena&& other) :
+        _region(std::exchange(other._region, nullptr)), _size(other._size),
+        _used(other._used), _pages(other._pages) {}
+
+    HugePageArena& operator=(HugePageArena&& other) {
+        if (this != &other) {
+            _unmap();
+            _region = std::exchange(other._region, nullptr);
+            _size = other._size;
+            _used = other._used;
+            _pages = other._pages;
+        }
+        return *this;
+    }
+
+    HugePageArena(const HugePageArena&) = delete;
+    HugePageArena& operator=(const HugePageArena&) = delete;
+
+    ~HugePageArena() {
+        _unmap();
+    }
+
+    /**
+     * Take size bytes aligned to align (a power of 2), or nullptr if
+     * the arena doesn't have that much left.  Memory is only given
+     * back when the arena is destroyed.
+     */
+    void* allocate(std::size_t size, std::size_t align = alignof(std::max_align_t)) {
+        std::size_t start = (_used + align - 1) & ~(align - 1);
+        if (start > _size || size > _size - start) {
+            return nullptr;
+        }
+        _used = start + size;
+        return _region + start;
+    }
+
+    /**
+     * The arena's size, in bytes
+     */
+    std::size_t size() const {
+        return _size;
+    }
+
+    /**
+     * Bytes allocated so far (including alignment padding)
+     */
+    std::size_t used() const {
+        return _used;
+    }
+
+    /**
+     * How the arena was mapped
+     */
+    Pages pages() const {
+        return _pages;
+    }
+
+    /**
+     * The number of 2 MB pages actually backing the arena.  For
+     * transparent huge pages this reads /proc/self/smaps, so keep it
+     * off the data path.
+     */
+    std::size_t hugePages() const {
+        switch (_pages) {
+            case Pages::HugeTlb:
+                return _size / hugePageSize;
+            case Pages::Small:
+                return 0;
+            case Pages::Transparent:
+                break;
+        }
+        FILE* smaps = fopen("/proc/self/smaps", "r");
+        if (!smaps) {
+            return 0;
+        }
+        auto begin = reinterpret_cast<uintptr_t>(_region);
+        auto end = begin + _size;
+        // The arena may have been merged with (or split from) neighbouring
+        //  mappings, so count every mapping that overlaps it
+        bool inArena = false;
+        std::size_t kb = 0;
+        char line[256];
+        while (fgets(line, sizeof(line), smaps)) {
+            uintptr_t from, to;
+            std::size_t value;
+            if (sscanf(line, "%lx-%lx ", &from, &to) == 2) {
+                inArena = from < end && to > begin;
+            } else if (inArena && sscanf(line, "AnonHugePages: %zu kB", &value) == 1) {
+                kb += value;
+            }
+        }
+        fclose(smaps);
+        return std::min(kb * 1024 / hugePageSize, _size / hugePageSize);
+    }
+
+protected:
+    uint8_t* _region = nullptr;
+    std::size_t _size = 0;
+    std::size_t _used = 0;
+    Pages _pages;
+
+    HugePageArena(uint8_t* region, std::size_t size, Pages pages) :
+        _region(region), _size(size), _pages(pages) {}
+
+    void _unmap() {
+        if (_region) {
+            munmap(_region, _size);
+            _region = nullptr;
+        }
+    }
+};
@@ -1,18 +1,65 @@
 #pragma once
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <cassert>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#include "byte_copy.hpp"
+#include "byte_order.hpp"
+#include "byte_search.hpp"
+
+/**
+ * The default instrumentation policy for NetworkBuffer: every
+ * hook is empty and inlines away to nothing.
+ *
+ * A policy is a type with these static functions, called after
+ * the positions have been updated:
+ *   onWrite(numBytes, used, capacity)    write of any kind
+ *   onRead(numBytes, unread)             read of any kind
+ *   onSetSize(numBytes, used, capacity)  setSize
+ * where used is the number of bytes written since the buffer
+ * was last compacted.  See buffer_instrumentation.hpp for some.
+ */
+struct NoInstrumentation {
+    static void onWrite(std::size_t, std::size_t, std::size_t) {}
+    static void onRead(std::size_t, std::size_t) {}
+    static void onSetSize(std::size_t, std::size_t, std::size_t) {}
+};
 
 /**
  * Stores data in a buffer in network order, provides
  * convenience methods for writing to and reading
  * from the buffer
+ *
+ * The read and write positions are kept as offsets at the
+ * front of the (cache line aligned) object, so a buffer can
+ * be copied, moved, memcpy'd or placed in shared memory and
+ * stays valid, and the positions share a cache line with
+ * the first bytes of data.
+ *
+ * Instrumentation is a policy (see NoInstrumentation) told
+ * about every read and write.  Its hooks are static, so it
+ * adds nothing to the buffer itself.
  */
-template<unsigned int BUF_SIZE = 1500>
-class NetworkBuffer {
+template<unsigned int BUF_SIZE = 1500, typename Instrumentation = NoInstrumentation>
+class alignas(64) NetworkBuffer {
 public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    // Wide enough to hold BUF_SIZE itself
+    using Index = std::conditional_t<(BUF_SIZE <= std::numeric_limits<uint16_t>::max()), uint16_t, uint32_t>;
+
+    // Deliberately leaves the data uninitialized, even when the
+    //  buffer is value-initialized
     NetworkBuffer() :
-        _head(_buffer), _tail(_buffer) {}
+        _head(0), _tail(0) {}
 
     void write(const uint8_t& val) {
         _write(val);
@@ -28,14 +75,122 @@ public:
         _write(networkVal);
     }
 
+    void write(const uint64_t& val) {
+        uint64_t networkVal = toNetwork(val);
+        _write(networkVal);
+    }
+
     /**
      * Directly write the contents of the given
      * buffer
      */
     void write(const uint8_t* const buf, std::size_t numBytes) {
-        assert(_tail + numBytes <= _buffer + BUF_SIZE);
-        memcpy(_tail, buf, numBytes);
+        assert(_tail + numBytes <= BUF_SIZE);
+        // buf may be null when there's nothing to write (e.g. an empty
+        //  span), which memcpy doesn't allow even for 0 bytes
+        if (numBytes > 0) {
+            memcpy(_buffer + _tail, buf, numBytes);
+        }
         _tail += numBytes;
+        Instrumentation::onWrite(numBytes, _tail, BUF_SIZE);
+    }
+
+    /**
+     * Write a fixed number of bytes (a MAC address, an ID, a
+     * fixed-size header).  The length is known at compile time,
+     * so the copy is a few moves rather than a call to memcpy.
+     */
+    template<std::size_t N>
+    void write(const uint8_t (&buf)[N]) {
+        _writeFixed<N>(buf);
+    }
+
+    template<std::size_t N>
+    void write(const std::array<uint8_t, N>& buf) {
+        _writeFixed<N>(buf.data());
+    }
+
+    // Either constness, so that what read<N> returns can be written
+    template<typename T, std::size_t N>
+        requires (N != std::dynamic_extent && std::is_same_v<std::remove_const_t<T>, uint8_t>)
+    void write(std::span<T, N> buf) {
+        _writeFixed<N>(buf.data());
+    }
+
+    /**
+     * Like write(buf, numBytes), but the bytes written are not
+     * brought into the cache (see copyStreaming).  For large
+     * payloads that won't be read again before the buffer is
+     * handed off, e.g. to send.
+     */
+    void writeStreaming(const uint8_t* const buf, std::size_t numBytes) {
+        assert(_tail + numBytes <= BUF_SIZE);
+        copyStreaming(_buffer + _tail, buf, numBytes);
+        _tail += numBytes;
+        Instrumentation::onWrite(numBytes, _tail, BUF_SIZE);
+    }
+
+    /**
+     * Write the given bytes preceded by their length, encoded
+     * as a LenT (uint8_t, uint16_t or uint32_t) in network order
+     */
+    template<typename LenT>
+    void writeLenPrefixed(std::span<const uint8_t> data) {
+        assert(data.size() <= std::numeric_limits<LenT>::max());
+        write(static_cast<LenT>(data.size()));
+        write(data.data(), data.size());
+    }
+
+    template<typename LenT>
+    void writeLenPrefixed(std::string_view str) {
+        writeLenPrefixed<LenT>(_bytes(str));
+    }
+
+    /**
+     * A reserved length field, returned by beginLenPrefixed.
+     * Holds an offset rather than a pointer so it stays valid
+     * if the buffer is moved.
+     */
+    template<typename LenT>
+    struct LenSlot {
+        std::size_t offset;
+    };
+
+    /**
+     * Reserve space for a LenT length field to be filled in
+     * by endLenPrefixed once the field's contents have been
+     * written.  Slots may be nested.
+     */
+    template<typename LenT>
+    LenSlot<LenT> beginLenPrefixed() {
+        LenSlot<LenT> slot{_tail};
+        _write(LenT{0});
+        return slot;
+    }
+
+    /**
+     * Back-patch the given slot with the number of bytes
+     * written since it was reserved
+     */
+    template<typename LenT>
+    void endLenPrefixed(LenSlot<LenT> slot) {
+        uint8_t* lenPos = _buffer + slot.offset;
+        std::size_t len = _tail - (slot.offset + sizeof(LenT));
+        assert(len <= std::numeric_limits<LenT>::max());
+        storeNetwork(lenPos, static_cast<LenT>(len));
+    }
+
+    /**
+     * Write a length-prefixed field whose contents are produced
+     * by the given encoder, which is invoked with this buffer.
+     * The length is back-patched once the encoder returns.
+     */
+    template<typename LenT, typename Encoder>
+        requires std::is_invocable_v<Encoder, NetworkBuffer&>
+    void writeLenPrefixed(Encoder&& encoder) {
+        auto slot = beginLenPrefixed<LenT>();
+        encoder(*this);
+        endLenPrefixed(slot);
     }
 
     uint8_t read8() {
@@ -52,6 +207,24 @@ public:
         return ntohl(res);
     }
 
+    uint64_t read64() {
+        uint64_t res = _read<uint64_t>();
+        return fromNetwork(res);
+    }
+
+    /**
+     * Read an integer (uint8_t, uint16_t, uint32_t or uint64_t)
+     * in network order without advancing the position, e.g. to
+     * look at a type or version field before deciding how to
+     * parse the rest
+     */
+    template<typename T>
+    T peek() const {
+        static_assert(std::is_unsigned_v<T>, "only unsigned types are supported");
+        assert(_head + sizeof(T) <= _tail);
+        return loadNetwork<T>(_buffer + _head);
+    }
+
     /**
      * Directly read the contents of the buffer
      * Returns a pointer to the buffer at the
@@ -59,18 +232,123 @@ public:
      * by the given number of bytes
      */
     uint8_t* read(std::size_t numBytes) {
-        assert(_head + numBytes <= _buffer + BUF_SIZE);
-        uint8_t* currPos = _head;
+        assert(_head + numBytes <= BUF_SIZE);
+        uint8_t* currPos = _buffer + _head;
         _head += numBytes;
+        Instrumentation::onRead(numBytes, size());
         return currPos;
     }
 
+    /**
+     * Like read(numBytes), for a length known at compile time.
+     * Returns a view of exactly N bytes, so copying out of it
+     * (e.g. into a std::array) is a fixed-size copy too.
+     */
+    template<std::size_t N>
+    std::span<uint8_t, N> read() {
+        static_assert(N <= BUF_SIZE, "read is larger than the buffer");
+        assert(N <= size());
+        uint8_t* currPos = _buffer + _head;
+        _head += N;
+        Instrumentation::onRead(N, size());
+        return std::span<uint8_t, N>(currPos, N);
+    }
+
+    /**
+     * Copy the next numBytes out to dest and advance the position,
+     * without bringing dest into the cache (see copyStreaming)
+     */
+    void readStreaming(uint8_t* dest, std::size_t numBytes) {
+        copyStreaming(dest, read(numBytes), numBytes);
+    }
+
+    /**
+     * Read a field preceded by a LenT length.  Returns a view
+     * directly into the buffer (no copy is made) and advances
+     * the position past the field.  The view is valid until the
+     * buffer is next modified or destroyed.  If the length runs
+     * past the unread bytes (or the length itself is cut short),
+     * nothing is consumed.
+     */
+    template<typename LenT>
+    std::optional<std::span<uint8_t>> readLenPrefixed() {
+        if (size() < sizeof(LenT)) {
+            return std::nullopt;
+        }
+        std::size_t len = loadNetwork<LenT>(_buffer + _head);
+        if (len > size() - sizeof(LenT)) {
+            return std::nullopt;
+        }
+        read(sizeof(LenT));
+        return std::span<uint8_t>{read(len), len};
+    }
+
+    template<typename LenT>
+    std::optional<std::string_view> readLenPrefixedString() {
+        auto field = readLenPrefixed<LenT>();
+        if (!field) {
+            return std::nullopt;
+        }
+        return std::string_view{reinterpret_cast<const char*>(field->data()), field->size()};
+    }
+
+    /**
+     * Search the unread bytes.  Returns the offset of the
+     * match relative to the current read position, or npos
+     * if there is none.
+     */
+    std::size_t find(uint8_t val) const {
+        return _offsetOf(findByte(_buffer + _head, _buffer + _tail, val));
+    }
+
+    std::size_t find(std::span<const uint8_t> needle) const {
+        return _offsetOf(findBytes(_buffer + _head, _buffer + _tail, needle));
+    }
+
+    std::size_t find(std::string_view needle) const {
+        return find(_bytes(needle));
+    }
+
+    /**
+     * Find the first byte which matches any in the given set
+     */
+    std::size_t findAny(std::span<const uint8_t> set) const {
+        return _offsetOf(findAnyByte(_buffer + _head, _buffer + _tail, set));
+    }
+
+    std::size_t findAny(std::string_view set) const {
+        return findAny(_bytes(set));
+    }
+
+    /**
+     * Read up to the given delimiter.  Returns a view of the bytes
+     * before the delimiter and advances the position past the
+     * delimiter.  If the delimiter isn't found, nothing is consumed.
+     */
+    std::optional<std::span<uint8_t>> readUntil(std::span<const uint8_t> delim) {
+        std::size_t offset = find(delim);
+        if (offset == npos) {
+            return std::nullopt;
+        }
+        std::span<uint8_t> res{read(offset), offset};
+        read(delim.size());
+        return res;
+    }
+
+    std::optional<std::span<uint8_t>> readUntil(std::string_view delim) {
+        return readUntil(_bytes(delim));
+    }
+
+    std::optional<std::span<uint8_t>> readUntil(uint8_t delim) {
+        return readUntil(std::span<const uint8_t>(&delim, 1));
+    }
+
     /**
      * Return the position in the buffer to be written
      * to next
      */
     const uint8_t* const getBuffer() const {
-        return _head;
+        return _buffer + _head;
     }
 
     /**
@@ -78,7 +356,84 @@ public:
      * for example, when reading from the network)
      */
     uint8_t* getBuffer() {
-        return _head;
+        return _buffer + _head;
+    }
+
+    /**
+     * Get the position after the last byte written, for
+     * appending data directly (e.g. from recv) to data
+     * that has not been read yet.  Follow with setSize
+     * to account for the bytes written.
+     */
+    uint8_t* getWriteBuffer() {
+        return _buffer + _tail;
+    }
+
+    /**
+     * Move the unread bytes to the front of the buffer,
+     * reclaiming the space taken by bytes already read.
+     * Any pointers or views previously handed out are
+     * invalidated.
+     */
+    void compact() {
+        if (_head == 0) {
+            return;
+        }
+        std::size_t len = size();
+        memmove(_buffer, _buffer + _head, len);
+        _head = 0;
+        _tail = len;
+    }
+
+    /**
+     * Empty the buffer for reuse: both positions go back to
+     * the start.  The data is left as it is.
+     */
+    void clear() {
+        _head = 0;
+        _tail = 0;
+    }
+
+    /**
+     * The read and write positions, saved by mark and restored by
+     * rewind.  Like LenSlot, holds offsets, so it stays valid if
+     * the buffer is moved, but not across compact or clear.
+     */
+    struct Mark {
+        Index head;
+        Index tail;
+    };
+
+    Mark mark() const {
+        return {_head, _tail};
+    }
+
+    /**
+     * Go back to the given mark: bytes read since are unread again
+     * and bytes written since are dropped.  For trying a parse (or
+     * an encoding) and backing out of it without copying.
+     */
+    void rewind(Mark mark) {
+        rewindRead(mark);
+        rewindWrite(mark);
+    }
+
+    /**
+     * Move only the read position back to the mark, keeping
+     * anything written since
+     */
+    void rewindRead(Mark mark) {
+        assert(mark.head <= _head);
+        _head = mark.head;
+    }
+
+    /**
+     * Move only the write position back to the mark, keeping
+     * the current read position (which must not be past it)
+     */
+    void rewindWrite(Mark mark) {
+        assert(mark.tail <= _tail && _head <= mark.tail);
+        _tail = mark.tail;
     }
 
     /**
@@ -89,8 +444,9 @@ public:
      * TOOD: is there a better way to implement this?
      */
     void setSize(std::size_t size) {
-        assert(size <= BUF_SIZE);
+        assert(size <= remainingCapacity());
         _tail += size;
+        Instrumentation::onSetSize(size, _tail, BUF_SIZE);
     }
 
     /**
@@ -103,7 +459,7 @@ public:
     }
 
     size_t remainingCapacity() const {
-        return BUF_SIZE - (_tail - _buffer);;
+        return BUF_SIZE - _tail;
     }
 
     /**
@@ -118,23 +474,42 @@ public:
     }
 
 //protected:
-    uint8_t _buffer[BUF_SIZE]; 
-    uint8_t* _head; // Tracks reading
-    uint8_t* _tail; // Tracks writing
+    Index _head; // Tracks reading
+    Index _tail; // Tracks writing
+    uint8_t _buffer[BUF_SIZE];
 
     template<typename T>
     void _write(const T& val) {
-        assert(_tail + sizeof(T) <= _buffer + BUF_SIZE);
-        memcpy(_tail, &val, sizeof(T));
+        assert(_tail + sizeof(T) <= BUF_SIZE);
+        memcpy(_buffer + _tail, &val, sizeof(T));
         _tail += sizeof(T);
+        Instrumentation::onWrite(sizeof(T), _tail, BUF_SIZE);
+    }
+
+    template<std::size_t N>
+    void _writeFixed(const uint8_t* buf) {
+        static_assert(N <= BUF_SIZE, "write is larger than the buffer");
+        assert(_tail + N <= BUF_SIZE);
+        memcpy(_buffer + _tail, buf, N);
+        _tail += N;
+        Instrumentation::onWrite(N, _tail, BUF_SIZE);
+    }
+
+    std::size_t _offsetOf(const uint8_t* match) const {
+        return match == _buffer + _tail ? npos : match - (_buffer + _head);
+    }
+
+    static std::span<const uint8_t> _bytes(std::string_view str) {
+        return {reinterpret_cast<const uint8_t*>(str.data()), str.size()};
     }
 
     template<typename T>
     T _read() {
-        assert(_head < (_tail + sizeof(T)));
+        assert(_head + sizeof(T) <= _tail);
         T val;
-        memcpy(&val, _head, sizeof(T));
+        memcpy(&val, _buffer + _head, sizeof(T));
         _head += sizeof(T);
+        Instrumentation::onRead(sizeof(T), size());
         return val;
     }
 };
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#include "byte_order.hpp"
+
+/**
+ * Builds IPv4/UDP and IPv4/TCP packets for a fixed flow (addresses
+ * and ports) straight into buffers, for packet generators writing to
+ * TUN devices or raw sockets.
+ *
+ * Everything about a flow that doesn't change between packets is laid
+ * out once in a header template, along with its share of the IP header
+ * checksum and of the transport checksum's pseudo-header.  Each packet
+ * then only copies the template and folds in its lengths, IP id and
+ * payload sum.  The batched calls sum a shared payload only once.
+ */
+
+/**
+ * Whether to fill in the transport checksum or leave it to the device
+ */
+enum class ChecksumMode {
+    Full,
+    // Only the (uncomplemented) pseudo-header sum, as expected with
+    //  checksum offload (e.g. a TUN device with a virtio_net_hdr
+    //  requesting VIRTIO_NET_HDR_F_NEEDS_CSUM)
+    PseudoHeader,
+};
+
+namespace checksum_detail {
+    /**
+     * Add bytes to a ones' complement sum (RFC 1071).  The sum is kept
+     * in host order words, so values summed must be in network order,
+     * and every piece but the last must start at an even offset of the
+     * summed data and have an even length.
+     */
+    inline uint64_t sum(const uint8_t* data, std::size_t size, uint64_t acc = 0) {
+        while (size >= 8) {
+            uint64_t word;
+            memcpy(&word, data, 8);
+            acc += word;
+            // End around carry
+            acc += acc < word;
+            data += 8;
+            size -= 8;
+        }
+        if (size) {
+            uint64_t word = 0;
+            memcpy(&word, data, size);
+            acc += word;
+            acc += acc < word;
+        }
+        return acc;
+    }
+
+    /**
+     * Add a value that is already in network order
+     */
+    inline uint64_t add(uint64_t acc, uint64_t val) {
+        acc += val;
+        return acc + (acc < val);
+    }
+
+    inline uint16_t fold(uint64_t acc) {
+        acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+        acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+        acc = (acc & 0xFFFF) + (acc >> 16);
+        acc = (acc & 0xFFFF) + (acc >> 16);
+        return static_cast<uint16_t>(acc);
+    }
+
+    /**
+     * The checksum of the given data, to be stored as is (it's already
+     * in network order)
+     */
+    inline uint16_t checksum(const uint8_t* data, std::size_t size) {
+        return ~fold(sum(data, size));
+    }
+
+    inline void store(uint8_t* dst, uint16_t networkVal) {
+        memcpy(dst, &networkVal, sizeof(networkVal));
+    }
+
+    constexpr std::size_t ipv4HeaderSize = 20;
+    constexpr std::size_t udpHeaderSize = 8;
+    constexpr std::size_t tcpHeaderSize = 20;
+    constexpr uint8_t protocolTcp = 6;
+    constexpr uint8_t protocolUdp = 17;
+}
+
+/**
+ * The parts of an IPv4 flow shared by UdpFlow and TcpFlow
+ */
+class Ipv4FlowBase {
+public:
+    /**
+     * The IP id the next packet will get
+     */
+    uint16_t nextId() const {
+        return _nextId;
+    }
+
+    void setNextId(uint16_t id) {
+        _nextId = id;
+    }
+
+protected:
+    // Addresses are in host order
+    Ipv4FlowBase(uint32_t srcAddr, uint32_t dstAddr, uint8_t protocol, uint8_t ttl, uint8_t tos, ChecksumMode mode) :
+        _mode(mode) {
+        uint8_t* ip = _template;
+        ip[0] = 0x45;
+        ip[1] = tos;
+        // Total length and id are per packet
+        storeNetwork<uint16_t>(ip + 6, 0x4000);
+        ip[8] = ttl;
+        ip[9] = protocol;
+        storeNetwork<uint32_t>(ip + 12, srcAddr);
+        storeNetwork<uint32_t>(ip + 16, dstAddr);
+        _ipSum = checksum_detail::sum(ip, checksum_detail::ipv4HeaderSize);
+        // Source, destination, zero and protocol
+        _pseudoSum = checksum_detail::sum(ip + 12, 8);
+        _pseudoSum = checksum_detail::add(_pseudoSum, toNetwork<uint16_t>(protocol));
+        _headerSum = _pseudoSum;
+    }
+
+    ChecksumMode _mode;
+    uint16_t _nextId = 0;
+    // The IP header followed by the transport header
+    uint8_t _template[checksum_detail::ipv4HeaderSize + checksum_detail::tcpHeaderSize] = {};
+    uint64_t _ipSum;
+    // The pseudo-header without its length, and that plus the transport
+    //  header fields fixed for the flow
+    uint64_t _pseudoSum;
+    uint64_t _headerSum;
+
+    /**
+     * Copy the template to the start of a packet and fill in the IP
+     * header's per packet fields
+     */
+    void _writeIpHeader(uint8_t* packet, std::size_t headerSize, std::size_t totalSize) {
+        memcpy(packet, _template, headerSize);
+        uint16_t totalSizeField = toNetwork(static_cast<uint16_t>(totalSize));
+        uint16_t idField = toNetwork(_nextId++);
+        memcpy(packet + 2, &totalSizeField, 2);
+        memcpy(packet + 4, &idField, 2);
+        uint64_t ipSum = checksum_detail::add(checksum_detail::add(_ipSum, totalSizeField), idField);
+        checksum_detail::store(packet + 10, ~checksum_detail::fold(ipSum));
+    }
+
+    /**
+     * The transport checksum given the sum of everything but the lengths
+     * (which the caller adds) or, when offloading, the pseudo-header sum
+     */
+    uint16_t _transportChecksum(uint64_t sum, uint16_t lengthField) const {
+        if (_mode == ChecksumMode::PseudoHeader) {
+            return checksum_detail::fold(checksum_detail::add(_pseudoSum, lengthField));
+        }
+        return ~checksum_detail::fold(sum);
+    }
+};
+
+/**
+ * IPv4/UDP packets for one flow.  Packets are written at the buffer's
+ * write position:
+ *
+ *   UdpFlow flow(0x0A000001, 5000, 0x0A000002, 6000);
+ *   flow.write(buffer, payload);
+ *   flow.writeBatch(std::span(buffers), payload);
+ */
+class UdpFlow : public Ipv4FlowBase {
+public:
+    static constexpr std::size_t headerSize = checksum_detail::ipv4HeaderSize + checksum_detail::udpHeaderSize;
+
+    UdpFlow(uint32_t srcAddr, uint16_t srcPort, uint32_t dstAddr, uint16_t dstPort,
+            uint8_t ttl = 64, uint8_t tos = 0, ChecksumMode mode = ChecksumMode::Full) :
+        Ipv4FlowBase(srcAddr, dstAddr, checksum_detail::protocolUdp, ttl, tos, mode) {
+        uint8_t* udp = _template + checksum_detail::ipv4HeaderSize;
+        storeNetwork<uint16_t>(udp, srcPort);
+        storeNetwork<uint16_t>(udp + 2, dstPort);
+        _headerSum = checksum_detail::sum(udp, 4, _headerSum);
+    }
+
+    template<typename Buffer>
+    void write(Buffer& buffer, std::span<const uint8_t> payload) {
+        _write(buffer, payload, checksum_detail::sum(payload.data(), payload.size()));
+    }
+
+    /**
+     * Write one packet with the same payload to each buffer, with
+     * consecutive IP ids
+     */
+    template<typename Buffer>
+    void writeBatch(std::span<Buffer> buffers, std::span<const uint8_t> payload) {
+        uint64_t payloadSum = checksum_detail::sum(payload.data(), payload.size());
+        for (auto& buffer : buffers) {
+            _write(buffer, payload, payloadSum);
+        }
+    }
+
+    /**
+     * Write payloads[i] to buffers[i]
+     */
+    template<typename Buffer>
+    void writeBatch(std::span<Buffer> buffers, std::span<const std::span<const uint8_t>> payloads) {
+        assert(buffers.size() == payloads.size());
+        for (std::size_t i = 0; i < buffers.size(); ++i) {
+            write(buffers[i], payloads[i]);
+        }
+    }
+
+protected:
+    template<typename Buffer>
+    void _write(Buffer& buffer, std::span<const uint8_t> payload, uint64_t payloadSum) {
+        std::size_t totalSize = headerSize + payload.size();
+        assert(totalSize <= 0xFFFF && totalSize <= buffer.remainingCapacity());
+        uint8_t* packet = buffer.getWriteBuffer();
+        _writeIpHeader(packet, headerSize, totalSize);
+        uint8_t* udp = packet + checksum_detail::ipv4HeaderSize;
+        uint16_t udpSizeField = toNetwork(static_cast<uint16_t>(totalSize - checksum_detail::ipv4HeaderSize));
+        memcpy(udp + 4, &udpSizeField, 2);
+        // An empty payload may have no data pointer at all
+        if (!payload.empty()) {
+            memcpy(packet + headerSize, payload.data(), payload.size());
+        }
+
+        // The length is in both the pseudo-header and the UDP header
+        uint64_t sum = checksum_detail::add(_headerSum, payloadSum);
+        sum = checksum_detail::add(sum, udpSizeField);
+        sum = checksum_detail::add(sum, udpSizeField);
+        uint16_t checksum = _transportChecksum(sum, udpSizeField);
+        // Zero means "no checksum" in UDP, so a zero result is sent as ones
+        checksum_detail::store(udp + 6, checksum == 0 && _mode == ChecksumMode::Full ? 0xFFFF : checksum);
+        buffer.setSize(totalSize);
+    }
+};
+
+/**
+ * IPv4/TCP segments (without options) for one connection.  The
+ * sequence and acknowledgement numbers and flags are per segment,
+ * the window per flow.
+ */
+class TcpFlow : public Ipv4FlowBase {
+public:
+    static constexpr std::size_t headerSize = checksum_detail::ipv4HeaderSize + checksum_detail::tcpHeaderSize;
+
+    static constexpr uint8_t fin = 0x01;
+    static constexpr uint8_t syn = 0x02;
+    static constexpr uint8_t rst = 0x04;
+    static constexpr uint8_t psh = 0x08;
+    static constexpr uint8_t ack = 0x10;
+
+    TcpFlow(uint32_t srcAddr, uint16_t srcPort, uint32_t dstAddr, uint16_t dstPort,
+            uint16_t window = 65535, uint8_t ttl = 64, uint8_t tos = 0, ChecksumMode mode = ChecksumMode::Full) :
+        Ipv4FlowBase(srcAddr, dstAddr, checksum_detail::protocolTcp, ttl, tos, mode) {
+        uint8_t* tcp = _template + checksum_detail::ipv4HeaderSize;
+        storeNetwork<uint16_t>(tcp, srcPort);
+        storeNetwork<uint16_t>(tcp + 2, dstPort);
+        tcp[12] = (checksum_detail::tcpHeaderSize / 4) << 4;
+        storeNetwork<uint16_t>(tcp + 14, window);
+        // Ports, data offset and window: the flags are added per segment
+        _headerSum = checksum_detail::sum(tcp, checksum_detail::tcpHeaderSize, _headerSum);
+    }
+
+    template<typename Buffer>
+    void write(Buffer& buffer, uint32_t seq, uint32_t ackNumber, uint8_t flags, std::span<const uint8_t> payload = {}) {
+        _write(buffer, seq, ackNumber, flags, payload, checksum_detail::sum(payload.data(), payload.size()));
+    }
+
+    /**
+     * Write consecutive segments of the same payload, the first with
+     * sequence number seq, to each buffer
+     */
+    template<typename Buffer>
+    void writeBatch(std::span<Buffer> buffers, uint32_t seq, uint32_t ackNumber, uint8_t flags,
+                    std::span<const uint8_t> payload) {
+        uint64_t payloadSum = checksum_detail::sum(payload.data(), payload.size());
+        for (auto& buffer : buffers) {
+            _write(buffer, seq, ackNumber, flags, payload, payloadSum);
+            seq += payload.size();
+        }
+    }
+
+protected:
+    template<typename Buffer>
+    void _write(Buffer& buffer, uint32_t seq, uint32_t ackNumber, uint8_t flags,
+                std::span<const uint8_t> payload, uint64_t payloadSum) {
+        std::size_t totalSize = headerSize + payload.size();
+        assert(totalSize <= 0xFFFF && totalSize <= buffer.remainingCapacity());
+        uint8_t* packet = buffer.getWriteBuffer();
+        _writeIpHeader(packet, headerSize, totalSize);
+        uint8_t* tcp = packet + checksum_detail::ipv4HeaderSize;
+        uint32_t seqField = toNetwork(seq);
+        uint32_t ackField = toNetwork(ackNumber);
+        memcpy(tcp + 4, &seqField, 4);
+        memcpy(tcp + 8, &ackField, 4);
+        tcp[13] = flags;
+        if (!payload.empty()) {
+            memcpy(packet + headerSize, payload.data(), payload.size());
+        }
+
+        uint16_t tcpSizeField = toNetwork(static_cast<uint16_t>(totalSize - checksum_detail::ipv4HeaderSize));
+        uint16_t flagsField = toNetwork<uint16_t>(flags);
+        uint64_t sum = checksum_detail::add(_headerSum, payloadSum);
+        sum = checksum_detail::add(sum, tcpSizeField);
+        sum = checksum_detail::add(sum, seqField);
+        sum = checksum_detail::add(sum, ackField);
+        sum = checksum_detail::add(sum, flagsField);
+        checksum_detail::store(tcp + 16, _transportChecksum(sum, tcpSizeField));
+        buffer.setSize(totalSize);
+    }
+};
@@ -0,0 +1,537 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
+
+#include "byte_order.hpp"
+
+/**
+ * RTCP (RFC 3550) compound packet parsing, and builders for
+ * reports and the common feedback messages (RFC 4585, RFC 5104,
+ * draft-alvestrand-rmcat-remb, draft-holmer-rmcat-transport-wide-cc)
+ *
+ *  0                   1                   2                   3
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |V=2|P|  count  |      PT       |  length (32-bit words - 1)    |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ */
+
+enum class RtcpType : uint8_t {
+    SenderReport = 200,
+    ReceiverReport = 201,
+    SourceDescription = 202,
+    Bye = 203,
+    App = 204,
+    TransportFeedback = 205,
+    PayloadFeedback = 206,
+};
+
+// Feedback message types, carried in the count field
+constexpr uint8_t rtcpFmtNack = 1;
+constexpr uint8_t rtcpFmtTransportCc = 15;
+constexpr uint8_t rtcpFmtPli = 1;
+constexpr uint8_t rtcpFmtAfb = 15;
+
+/**
+ * One packet of a compound packet.  body excludes the 4 byte
+ * header and any padding.
+ */
+struct RtcpPacketView {
+    uint8_t count;
+    RtcpType type;
+    std::span<const uint8_t> body;
+
+    /**
+     * For feedback messages: the sender and media source SSRCs.
+     * RtcpCompoundReader only returns feedback messages with a
+     * body long enough to hold them.
+     */
+    uint32_t senderSsrc() const {
+        assert(body.size() >= 8);
+        return loadNetwork<uint32_t>(body.data());
+    }
+
+    uint32_t mediaSsrc() const {
+        assert(body.size() >= 8);
+        return loadNetwork<uint32_t>(body.data() + 4);
+    }
+};
+
+struct RtcpReportBlock {
+    uint32_t ssrc;
+    uint8_t fractionLost;
+    int32_t cumulativeLost;
+    uint32_t extendedHighestSeq;
+    uint32_t jitter;
+    uint32_t lastSr;
+    uint32_t delaySinceLastSr;
+};
+
+struct RtcpSenderInfo {
+    uint64_t ntpTimestamp;
+    uint32_t rtpTimestamp;
+    uint32_t packetCount;
+    uint32_t octetCount;
+};
+
+/**
+ * Walks the packets of a compound packet in place.  A packet
+ * whose length runs past the end of the data, or a feedback
+ * message too short for its SSRCs, stops the walk and sets
+ * malformed().
+ */
+class RtcpCompoundReader {
+public:
+    static constexpr std::size_t headerSize = 4;
+    // The sender and media source SSRCs
+    static constexpr std::size_t feedbackHeaderSize = 8;
+
+    explicit RtcpCompoundReader(std::span<const uint8_t> data) :
+        _pos(data.data()), _end(data.data() + data.size()) {}
+
+    /**
+     * Walk the unread bytes of the given buffer (its position
+     * is not moved)
+     */
+    template<typename Buffer>
+        requires requires(const Buffer& b) { b.getBuffer(); b.size(); }
+    explicit RtcpCompoundReader(const Buffer& buffer) :
+        RtcpCompoundReader(std::span<const uint8_t>(buffer.getBuffer(), buffer.size())) {}
+
+    std::optional<RtcpPacketView> next() {
+        if (_pos == _end) {
+            return std::nullopt;
+        }
+        if (_end - _pos < static_cast<std::ptrdiff_t>(headerSize)) {
+            return _fail();
+        }
+        uint32_t header = loadNetwork<uint32_t>(_pos);
+        if ((header >> 30) != 2) {
+            return _fail();
+        }
+        std::size_t size = ((header & 0xFFFF) + 1) * 4;
+        if (static_cast<std::size_t>(_end - _pos) < size) {
+            return _fail();
+        }
+        std::size_t bodySize = size - headerSize;
+        if (header & 0x20000000) {
+            uint8_t padding = _pos[size - 1];
+            if (padding == 0 || padding > bodySize) {
+                return _fail();
+            }
+            bodySize -= padding;
+        }
+        auto type = static_cast<RtcpType>((header >> 16) & 0xFF);
+        bool feedback = type == RtcpType::TransportFeedback || type == RtcpType::PayloadFeedback;
+        if (feedback && bodySize < feedbackHeaderSize) {
+            return _fail();
+        }
+        RtcpPacketView packet{static_cast<uint8_t>((header >> 24) & 0x1F), type,
+                              {_pos + headerSize, bodySize}};
+        _pos += size;
+        return packet;
+    }
+
+    bool malformed() const {
+        return _malformed;
+    }
+
+protected:
+    const uint8_t* _pos;
+    const uint8_t* _end;
+    bool _malformed = false;
+
+    std::optional<RtcpPacketView> _fail() {
+        _malformed = true;
+        _pos = _end;
+        return std::nullopt;
+    }
+};
+
+namespace rtcp_detail {
+    constexpr uint8_t notReceived = 0;
+    constexpr uint8_t smallDelta = 1;
+    constexpr uint8_t largeDelta = 2;
+    // Marks symbols past the end of the packet list
+    constexpr uint8_t noSymbol = 0xFF;
+
+    constexpr std::size_t maxRunLength = 0x1FFF;
+    constexpr std::size_t oneBitVectorSymbols = 14;
+    constexpr std::size_t twoBitVectorSymbols = 7;
+
+    inline uint8_t symbolOf(int32_t delta, int32_t notReceivedDelta) {
+        if (delta == notReceivedDelta) {
+            return notReceived;
+        }
+        return (delta >= 0 && delta <= 0xFF) ? smallDelta : largeDelta;
+    }
+
+    inline uint64_t load8(const uint8_t* in) {
+        uint64_t val;
+        memcpy(&val, in, 8);
+        return val;
+    }
+
+    /**
+     * The number of leading symbols equal to the first, comparing
+     * 8 at a time.  The symbols must be followed by at least 8
+     * noSymbol bytes.
+     */
+    inline std::size_t runLength(const uint8_t* symbols) {
+        const uint64_t broadcast = symbols[0] * 0x0101010101010101ULL;
+        std::size_t run = 0;
+        while (run < maxRunLength) {
+            // Symbols are loaded little endian, so the first mismatching
+            //  byte is the lowest set byte
+            uint64_t diff = load8(symbols + run) ^ broadcast;
+            if (diff) {
+                run += __builtin_ctzll(diff) / 8;
+                break;
+            }
+            run += 8;
+        }
+        return run < maxRunLength ? run : maxRunLength;
+    }
+
+    /**
+     * Zero the noSymbol bytes, so that symbols past the end are
+     * sent as not received
+     */
+    inline uint64_t clearMissing(uint64_t symbols) {
+        uint64_t missing = (symbols & 0x8080808080808080ULL) >> 7;
+        return symbols & ~(missing * 0xFF);
+    }
+
+    /**
+     * Pack 8 symbols of at most 2 bits each (one per byte, the first
+     * in the lowest byte) into 16 bits with the first symbol in the
+     * most significant position
+     */
+    inline uint16_t packTwoBit(uint64_t symbols) {
+        // Put the first symbol in the highest byte
+        uint64_t x = __builtin_bswap64(symbols) & 0x0303030303030303ULL;
+        x = (x | (x >> 6)) & 0x000F000F000F000FULL;
+        x = (x | (x >> 12)) & 0x000000FF000000FFULL;
+        x = (x | (x >> 24)) & 0xFFFF;
+        return static_cast<uint16_t>(x);
+    }
+
+    /**
+     * Pack 8 symbols of 1 bit each into 8 bits, first symbol
+     * in the most significant position
+     */
+    inline uint8_t packOneBit(uint64_t symbols) {
+        uint64_t x = __builtin_bswap64(symbols) & 0x0101010101010101ULL;
+        return static_cast<uint8_t>((x * 0x0102040810204080ULL) >> 56);
+    }
+
+    /**
+     * Builds a packet directly in a buffer: the header is written
+     * up front and its length filled in once the body is done
+     */
+    template<typename Buffer>
+    uint8_t* beginPacket(Buffer& buffer, uint8_t count, RtcpType type) {
+        uint8_t* start = buffer.getWriteBuffer();
+        buffer.write(static_cast<uint8_t>(0x80 | count));
+        buffer.write(static_cast<uint8_t>(type));
+        buffer.write(static_cast<uint16_t>(0));
+        return start;
+    }
+
+    /**
+     * Pad the packet to a multiple of 32 bits and fill in its length
+     */
+    template<typename Buffer>
+    void endPacket(Buffer& buffer, uint8_t* start) {
+        std::size_t size = buffer.getWriteBuffer() - start;
+        std::size_t padding = (4 - size % 4) % 4;
+        if (padding) {
+            uint8_t pad[4] = {0, 0, 0, static_cast<uint8_t>(padding)};
+            buffer.write(pad + 4 - padding, padding);
+            start[0] |= 0x20;
+            size += padding;
+        }
+        storeNetwork(start + 2, static_cast<uint16_t>(size / 4 - 1));
+    }
+
+    template<typename Buffer>
+    void writeReportBlock(Buffer& buffer, const RtcpReportBlock& block) {
+        buffer.write(block.ssrc);
+        buffer.write(static_cast<uint32_t>((block.fractionLost << 24) | (block.cumulativeLost & 0xFFFFFF)));
+        buffer.write(block.extendedHighestSeq);
+        buffer.write(block.jitter);
+        buffer.write(block.lastSr);
+        buffer.write(block.delaySinceLastSr);
+    }
+}
+
+class RtcpWriter {
+public:
+    static constexpr std::size_t maxReportBlocks = 31;
+    // Marks a packet as not received in writeTransportCc's deltas
+    static constexpr int32_t notReceived = std::numeric_limits<int32_t>::min();
+    // More than fit in an MTU sized packet, even with all 1 byte deltas
+    static constexpr std::size_t maxTransportCcPackets = 4096;
+
+    /**
+     * Write a sender report.  Report blocks beyond the 31 that fit
+     * are written in additional receiver reports.
+     */
+    template<typename Buffer>
+    static void writeSenderReport(Buffer& buffer, uint32_t ssrc, const RtcpSenderInfo& info,
+                                  std::span<const RtcpReportBlock> blocks = {}) {
+        std::size_t count = std::min(blocks.size(), maxReportBlocks);
+        uint8_t* start = rtcp_detail::beginPacket(buffer, count, RtcpType::SenderReport);
+        buffer.write(ssrc);
+        buffer.write(info.ntpTimestamp);
+        buffer.write(info.rtpTimestamp);
+        buffer.write(info.packetCount);
+        buffer.write(info.octetCount);
+        for (std::size_t i = 0; i < count; ++i) {
+            rtcp_detail::writeReportBlock(buffer, blocks[i]);
+        }
+        rtcp_detail::endPacket(buffer, start);
+        if (blocks.size() > count) {
+            writeReceiverReport(buffer, ssrc, blocks.subspan(count));
+        }
+    }
+
+    /**
+     * Write receiver reports for all of the given blocks, as many
+     * packets as are needed to hold them
+     */
+    template<typename Buffer>
+    static void writeReceiverReport(Buffer& buffer, uint32_t ssrc, std::span<const RtcpReportBlock> blocks) {
+        do {
+            std::size_t count = std::min(blocks.size(), maxReportBlocks);
+            uint8_t* start = rtcp_detail::beginPacket(buffer, count, RtcpType::ReceiverReport);
+            buffer.write(ssrc);
+            for (std::size_t i = 0; i < count; ++i) {
+                rtcp_detail::writeReportBlock(buffer, blocks[i]);
+            }
+            rtcp_detail::endPacket(buffer, start);
+            blocks = blocks.subspan(count);
+        } while (!blocks.empty());
+    }
+
+    template<typename Buffer>
+    static void writePli(Buffer& buffer, uint32_t senderSsrc, uint32_t mediaSsrc) {
+        uint8_t* start = rtcp_detail::beginPacket(buffer, rtcpFmtPli, RtcpType::PayloadFeedback);
+        buffer.write(senderSsrc);
+        buffer.write(mediaSsrc);
+        rtcp_detail::endPacket(buffer, start);
+    }
+
+    /**
+     * Receiver estimated maximum bitrate
+     */
+    template<typename Buffer>
+    static void writeRemb(Buffer& buffer, uint32_t senderSsrc, uint64_t bitrate, std::span<const uint32_t> ssrcs) {
+        assert(ssrcs.size() <= 0xFF);
+        uint8_t* start = rtcp_detail::beginPacket(buffer, rtcpFmtAfb, RtcpType::PayloadFeedback);
+        buffer.write(senderSsrc);
+        buffer.write(static_cast<uint32_t>(0));
+        buffer.write(reinterpret_cast<const uint8_t*>("REMB"), 4);
+        uint8_t exp = 0;
+        while ((bitrate >> exp) > 0x3FFFF) {
+            ++exp;
+        }
+        buffer.write(static_cast<uint32_t>((ssrcs.size() << 24) | (exp << 18) | (bitrate >> exp)));
+        for (uint32_t ssrc : ssrcs) {
+            buffer.write(ssrc);
+        }
+        rtcp_detail::endPacket(buffer, start);
+    }
+
+    /**
+     * Generic NACK for the given lost sequence numbers, which must
+     * be in (wraparound) increasing order.  Each is folded into the
+     * bitmask of the preceding item where possible.
+     */
+    template<typename Buffer>
+    static void writeNack(Buffer& buffer, uint32_t senderSsrc, uint32_t mediaSsrc, std::span<const uint16_t> lost) {
+        uint8_t* start = rtcp_detail::beginPacket(buffer, rtcpFmtNack, RtcpType::TransportFeedback);
+        buffer.write(senderSsrc);
+        buffer.write(mediaSsrc);
+        for (std::size_t i = 0; i < lost.size();) {
+            uint16_t pid = lost[i++];
+            uint16_t blp = 0;
+            for (; i < lost.size(); ++i) {
+                uint16_t diff = lost[i] - pid;
+                if (diff == 0 || diff > 16) {
+                    break;
+                }
+                blp |= 1 << (diff - 1);
+            }
+            buffer.write(static_cast<uint32_t>((pid << 16) | blp));
+        }
+        rtcp_detail::endPacket(buffer, start);
+    }
+
+    /**
+     * Transport-wide congestion control feedback.  deltas holds, for
+     * each packet from baseSeq on, its receive time delta in 250us
+     * ticks, or notReceived.  referenceTime is in 64ms units.
+     *
+     * Status chunks are chosen greedily: a run length chunk for runs
+     * of 7 or more identical symbols, else a 1-bit vector if the next
+     * 14 symbols are all "not received" or "small delta", else a
+     * 2-bit vector.  Symbols are compared and packed 8 at a time.
+     */
+    template<typename Buffer>
+    static void writeTransportCc(Buffer& buffer, uint32_t senderSsrc, uint32_t mediaSsrc, uint16_t baseSeq,
+                                 int32_t referenceTime, uint8_t feedbackCount, std::span<const int32_t> deltas) {
+        using namespace rtcp_detail;
+        assert(deltas.size() <= maxTransportCcPackets);
+        uint8_t* start = beginPacket(buffer, rtcpFmtTransportCc, RtcpType::TransportFeedback);
+        buffer.write(senderSsrc);
+        buffer.write(mediaSsrc);
+        buffer.write(baseSeq);
+        buffer.write(static_cast<uint16_t>(deltas.size()));
+        buffer.write(static_cast<uint32_t>((referenceTime << 8) | feedbackCount));
+
+        // Classify every packet up front, so that chunks can be
+        //  built from 8 symbols at a time
+        uint8_t symbols[maxTransportCcPackets + 16];
+        std::size_t n = deltas.size();
+        for (std::size_t i = 0; i < n; ++i) {
+            symbols[i] = symbolOf(deltas[i], notReceived);
+        }
+        memset(symbols + n, noSymbol, 16);
+
+        // Chunks and deltas are serialized straight into the buffer
+        assert(buffer.remainingCapacity() >= (n / twoBitVectorSymbols + 1) * 2 + n * 2 + 3);
+        uint8_t* out = buffer.getWriteBuffer();
+        for (std::size_t i = 0; i < n;) {
+            std::size_t run = runLength(symbols + i);
+            if (run >= twoBitVectorSymbols) {
+                storeNetwork(out, static_cast<uint16_t>((symbols[i] << 13) | run));
+                out += 2;
+                i += run;
+                continue;
+            }
+            uint64_t first = clearMissing(load8(symbols + i));
+            uint64_t second = clearMissing(load8(symbols + i + 8));
+            // 14 symbols fit in a 1-bit vector if none is a large delta
+            uint64_t large = (first | (second & 0x0000FFFFFFFFFFFFULL)) & 0x0202020202020202ULL;
+            if (!large) {
+                uint16_t bits = (packOneBit(first) << 6) | (packOneBit(second) >> 2);
+                storeNetwork(out, static_cast<uint16_t>(0x8000 | bits));
+                i += oneBitVectorSymbols;
+            } else {
+                uint16_t bits = packTwoBit(first) >> 2;
+                storeNetwork(out, static_cast<uint16_t>(0xC000 | bits));
+                i += twoBitVectorSymbols;
+            }
+            out += 2;
+        }
+
+        for (std::size_t i = 0; i < n; ++i) {
+            if (symbols[i] == smallDelta) {
+                *out++ = static_cast<uint8_t>(deltas[i]);
+            } else if (symbols[i] == largeDelta) {
+                assert(deltas[i] >= std::numeric_limits<int16_t>::min() &&
+                       deltas[i] <= std::numeric_limits<int16_t>::max());
+                storeNetwork(out, static_cast<uint16_t>(deltas[i]));
+                out += 2;
+            }
+        }
+        buffer.setSize(out - buffer.getWriteBuffer());
+        endPacket(buffer, start);
+    }
+
+};
+
+/**
+ * Decoders for the feedback messages written by RtcpWriter
+ */
+class RtcpFeedbackReader {
+public:
+    /**
+     * Call f with each sequence number reported lost by a generic NACK
+     */
+    template<typename F>
+    static void forEachNack(const RtcpPacketView& packet, F&& f) {
+        for (std::size_t pos = 8; pos + 4 <= packet.body.size(); pos += 4) {
+            uint16_t pid = loadNetwork<uint16_t>(packet.body.data() + pos);
+            uint16_t blp = loadNetwork<uint16_t>(packet.body.data() + pos + 2);
+            f(pid);
+            for (int bit = 0; bit < 16; ++bit) {
+                if (blp & (1 << bit)) {
+                    f(static_cast<uint16_t>(pid + bit + 1));
+                }
+            }
+        }
+    }
+
+    /**
+     * Call f(seq, delta) for each packet in a transport-wide CC
+     * feedback message, with delta in 250us ticks or nullopt if
+     * the packet wasn't received.  Returns false if malformed.
+     */
+    template<typename F>
+    static bool forEachTransportCc(const RtcpPacketView& packet, F&& f) {
+        auto body = packet.body;
+        if (body.size() < 16) {
+            return false;
+        }
+        uint16_t baseSeq = loadNetwork<uint16_t>(body.data() + 8);
+        std::size_t count = loadNetwork<uint16_t>(body.data() + 10);
+        // Walk the chunks once to find where the deltas start
+        std::size_t chunkPos = 16;
+        for (std::size_t seen = 0; seen < count; chunkPos += 2) {
+            if (chunkPos + 2 > body.size()) {
+                return false;
+            }
+            seen += _chunkSymbols(loadNetwork<uint16_t>(body.data() + chunkPos));
+        }
+        std::size_t deltaPos = chunkPos;
+        std::size_t index = 0;
+        for (std::size_t pos = 16; pos < chunkPos; pos += 2) {
+            uint16_t chunk = loadNetwork<uint16_t>(body.data() + pos);
+            std::size_t n = std::min(_chunkSymbols(chunk), count - index);
+            for (std::size_t i = 0; i < n; ++i, ++index) {
+                uint8_t symbol;
+                if (!(chunk & 0x8000)) {
+                    symbol = (chunk >> 13) & 0x3;
+                } else if (!(chunk & 0x4000)) {
+                    symbol = (chunk >> (13 - i)) & 0x1;
+                } else {
+                    symbol = (chunk >> (12 - 2 * i)) & 0x3;
+                }
+                uint16_t seq = baseSeq + index;
+                if (symbol == rtcp_detail::notReceived) {
+                    f(seq, std::optional<int32_t>());
+                } else if (symbol == rtcp_detail::smallDelta) {
+                    if (deltaPos + 1 > body.size()) {
+                        return false;
+                    }
+                    f(seq, std::optional<int32_t>(body[deltaPos]));
+                    deltaPos += 1;
+                } else {
+                    if (deltaPos + 2 > body.size()) {
+                        return false;
+                    }
+                    f(seq, std::optional<int32_t>(static_cast<int16_t>(loadNetwork<uint16_t>(body.data() + deltaPos))));
+                    deltaPos += 2;
+                }
+            }
+        }
+        return true;
+    }
+
+protected:
+    static std::size_t _chunkSymbols(uint16_t chunk) {
+        if (!(chunk & 0x8000)) {
+            return chunk & 0x1FFF;
+        }
+        return (chunk & 0x4000) ? rtcp_detail::twoBitVectorSymbols : rtcp_detail::oneBitVectorSymbols;
+    }
+};
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include "byte_order.hpp"
+
+/**
+ * The fixed RTP header fields, decoded all at once
+ */
+struct RtpHeader {
+    uint8_t version;
+    bool padding;
+    bool extension;
+    uint8_t csrcCount;
+    bool marker;
+    uint8_t payloadType;
+    uint16_t sequenceNumber;
+    uint32_t timestamp;
+    uint32_t ssrc;
+};
+
+/**
+ * RFC 8285 header extension element
+ */
+struct RtpHeaderExtension {
+    uint8_t id;
+    std::span<uint8_t> data;
+};
+
+/**
+ * Walks the elements of a one-byte (0xBEDE) or two-byte
+ * (0x100X) header extension block in place
+ */
+class RtpHeaderExtensionReader {
+public:
+    RtpHeaderExtensionReader(uint16_t profile, std::span<uint8_t> block) :
+        _pos(block.data()), _end(block.data() + block.size()),
+        _twoByte((profile & 0xFFF0) == 0x1000) {
+        if (!_twoByte && profile != 0xBEDE) {
+            // Not an RFC 8285 block: there are no elements to walk
+            _pos = _end;
+        }
+    }
+
+    std::optional<RtpHeaderExtension> next() {
+        while (_pos < _end) {
+            if (*_pos == 0) {
+                // Padding
+                ++_pos;
+                continue;
+            }
+            uint8_t id;
+            std::size_t len;
+            if (_twoByte) {
+                if (_end - _pos < 2) {
+                    break;
+                }
+                id = _pos[0];
+                len = _pos[1];
+                _pos += 2;
+            } else {
+                id = _pos[0] >> 4;
+                len = (_pos[0] & 0x0F) + 1;
+                if (id == 15) {
+                    // Reserved: stop processing
+                    break;
+                }
+                _pos += 1;
+            }
+            if (static_cast<std::size_t>(_end - _pos) < len) {
+                break;
+            }
+            RtpHeaderExtension ext{id, {_pos, len}};
+            _pos += len;
+            return ext;
+        }
+        _pos = _end;
+        return std::nullopt;
+    }
+
+protected:
+    uint8_t* _pos;
+    uint8_t* _end;
+    bool _twoByte;
+};
+
+/**
+ * An RTP packet (RFC 3550) viewed in place.  Nothing is copied:
+ * the getters decode straight from the packet's bytes, and the
+ * setters patch those bytes, so a relay can rewrite the SSRC or
+ * sequence number of a packet in the buffer it was received into
+ * and send it straight back out.
+ *
+ *  0                   1                   2                   3
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |V=2|P|X|  CC   |M|     PT      |       sequence number         |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |                           timestamp                           |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |           synchronization source (SSRC) identifier            |
+ * +=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+ */
+class RtpPacket {
+public:
+    static constexpr std::size_t fixedHeaderSize = 12;
+
+    /**
+     * Validate the bytes as an RTP packet, returning nullopt if
+     * they are too short for the header they claim to have
+     */
+    static std::optional<RtpPacket> parse(std::span<uint8_t> data) {
+        if (data.size() < fixedHeaderSize) {
+            return std::nullopt;
+        }
+        // The first word holds everything needed to size the header
+        uint32_t first = loadNetwork<uint32_t>(data.data());
+        if ((first >> 30) != 2) {
+            return std::nullopt;
+        }
+        std::size_t headerSize = fixedHeaderSize + ((first >> 24) & 0x0F) * 4;
+        if (first & 0x10000000) {
+            if (data.size() < headerSize + 4) {
+                return std::nullopt;
+            }
+            headerSize += 4 + loadNetwork<uint16_t>(data.data() + headerSize + 2) * 4;
+        }
+        std::size_t paddingSize = 0;
+        if ((first & 0x20000000) && data.size() > headerSize) {
+            paddingSize = data.back();
+        }
+        if (data.size() < headerSize + paddingSize) {
+            return std::nullopt;
+        }
+        return RtpPacket(data, headerSize, paddingSize);
+    }
+
+    /**
+     * View the unread bytes of the given buffer (its position
+     * is not moved)
+     */
+    template<typename Buffer>
+        requires requires(Buffer& b) { b.getBuffer(); b.size(); }
+    static std::optional<RtpPacket> parse(Buffer& buffer) {
+        return parse(std::span<uint8_t>(buffer.getBuffer(), buffer.size()));
+    }
+
+    /**
+     * Decode all of the fixed header fields from two loads
+     */
+    RtpHeader header() const {
+        uint64_t first = loadNetwork<uint64_t>(_data);
+        return RtpHeader{
+            static_cast<uint8_t>(first >> 62),
+            static_cast<bool>((first >> 61) & 1),
+            static_cast<bool>((first >> 60) & 1),
+            static_cast<uint8_t>((first >> 56) & 0x0F),
+            static_cast<bool>((first >> 55) & 1),
+            static_cast<uint8_t>((first >> 48) & 0x7F),
+            static_cast<uint16_t>(first >> 32),
+            static_cast<uint32_t>(first),
+            loadNetwork<uint32_t>(_data + 8),
+        };
+    }
+
+    uint8_t version() const { return _data[0] >> 6; }
+    bool padding() const { return _data[0] & 0x20; }
+    bool extension() const { return _data[0] & 0x10; }
+    uint8_t csrcCount() const { return _data[0] & 0x0F; }
+    bool marker() const { return _data[1] & 0x80; }
+    uint8_t payloadType() const { return _data[1] & 0x7F; }
+    uint16_t sequenceNumber() const { return loadNetwork<uint16_t>(_data + 2); }
+    uint32_t timestamp() const { return loadNetwork<uint32_t>(_data + 4); }
+    uint32_t ssrc() const { return loadNetwork<uint32_t>(_data + 8); }
+
+    uint32_t csrc(std::size_t index) const {
+        return loadNetwork<uint32_t>(_data + fixedHeaderSize + index * 4);
+    }
+
+    void setMarker(bool marker) {
+        _data[1] = (_data[1] & 0x7F) | (marker ? 0x80 : 0);
+    }
+
+    void setPayloadType(uint8_t payloadType) {
+        _data[1] = (_data[1] & 0x80) | (payloadType & 0x7F);
+    }
+
+    void setSequenceNumber(uint16_t seq) { storeNetwork(_data + 2, seq); }
+    void setTimestamp(uint32_t timestamp) { storeNetwork(_data + 4, timestamp); }
+    void setSsrc(uint32_t ssrc) { storeNetwork(_data + 8, ssrc); }
+
+    /**
+     * The header extension profile, only valid if extension() is set
+     */
+    uint16_t extensionProfile() const {
+        return loadNetwork<uint16_t>(_extensionStart());
+    }
+
+    RtpHeaderExtensionReader extensions() const {
+        if (!extension()) {
+            return RtpHeaderExtensionReader(0, {});
+        }
+        uint8_t* start = _extensionStart();
+        return RtpHeaderExtensionReader(loadNetwork<uint16_t>(start),
+            {start + 4, static_cast<std::size_t>(_data + _headerSize - (start + 4))});
+    }
+
+    /**
+     * Find the header extension element with the given id.  The
+     * returned data may be modified in place.
+     */
+    std::optional<std::span<uint8_t>> findExtension(uint8_t id) const {
+        auto reader = extensions();
+        while (auto ext = reader.next()) {
+            if (ext->id == id) {
+                return ext->data;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::size_t headerSize() const { return _headerSize; }
+    std::size_t size() const { return _size; }
+
+    std::span<uint8_t> payload() const {
+        return {_data + _headerSize, _size - _headerSize - _paddingSize};
+    }
+
+    uint8_t* data() const { return _data; }
+
+protected:
+    RtpPacket(std::span<uint8_t> data, std::size_t headerSize, std::size_t paddingSize) :
+        _data(data.data()), _size(data.size()), _headerSize(headerSize), _paddingSize(paddingSize) {}
+
+    uint8_t* _extensionStart() const {
+        return _data + fixedHeaderSize + csrcCount() * 4;
+    }
+
+    uint8_t* _data;
+    std::size_t _size;
+    std::size_t _headerSize;
+    std::size_t _paddingSize;
+};
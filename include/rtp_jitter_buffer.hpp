@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+
+#include "buffer_pool.hpp"
+
+namespace jitter_detail {
+    /**
+     * How far b is ahead of a in RTP sequence number space: negative
+     * if b is older, correct across wraparound as long as the two are
+     * within 32768 of each other
+     */
+    inline int16_t seqDiff(uint16_t a, uint16_t b) {
+        return static_cast<int16_t>(static_cast<uint16_t>(b - a));
+    }
+}
+
+/**
+ * Holds received RTP packets for reordering and playout.  Packets are
+ * kept as pool handles in a ring indexed by sequence number modulo
+ * Capacity, with a bitmap of which slots are filled, so inserting,
+ * popping in order and finding the gaps to NACK never copy a packet
+ * or allocate:
+ *
+ *   RtpJitterBuffer<NetworkBuffer<1500>> jitter;
+ *   jitter.insert(packet.sequenceNumber(), std::move(*handle));
+ *   while (auto next = jitter.pop()) { ... }
+ *   jitter.forEachMissing([&](uint16_t seq) { ... });
+ *
+ * The window runs from the next sequence number to play out to the
+ * newest received.  A packet more than Capacity ahead of the next one
+ * to play out slides the window forward, dropping what falls out.
+ * A run of resyncAfter packets in a row all too late to play out
+ * means the stream has restarted (a new SSRC, or a sender that jumped
+ * back): everything held is dropped and the window starts over at
+ * the packet that completes the run.
+ */
+template<typename Buffer, std::size_t Capacity = 512>
+class RtpJitterBuffer {
+public:
+    static_assert(Capacity >= 64 && (Capacity & (Capacity - 1)) == 0,
+                  "capacity must be a power of 2 and at least 64");
+    static_assert(Capacity <= 32768, "capacity must fit in half the sequence number space");
+
+    using Handle = typename BufferPool<Buffer>::Handle;
+
+    // Consecutive TooLate packets that restart the window
+    static constexpr std::size_t resyncAfter = 16;
+
+    enum class InsertResult {
+        Inserted,
+        // Already held
+        Duplicate,
+        // Older than the next packet to play out
+        TooLate,
+    };
+
+    /**
+     * Hold a packet.  Unless it's Inserted, the handle is left
+     * with the caller.
+     */
+    InsertResult insert(uint16_t seq, Handle&& packet) {
+        if (!_started) {
+            _started = true;
+            _head = seq;
+            _end = seq;
+        }
+        int16_t offset = jitter_detail::seqDiff(_head, seq);
+        if (offset < 0) {
+            if (++_tooLate < resyncAfter) {
+                return InsertResult::TooLate;
+            }
+            _resync(seq);
+            offset = 0;
+        }
+        _tooLate = 0;
+        if (static_cast<std::size_t>(offset) >= Capacity) {
+            _advanceTo(static_cast<uint16_t>(seq - Capacity + 1));
+        }
+        std::size_t slot = seq & (Capacity - 1);
+        if (_isPresent(slot)) {
+            return InsertResult::Duplicate;
+        }
+        _slots[slot] = std::move(packet);
+        _present[slot / 64] |= uint64_t(1) << (slot % 64);
+        ++_size;
+        if (jitter_detail::seqDiff(_end, seq) >= 0) {
+            _end = seq + 1;
+        }
+        return InsertResult::Inserted;
+    }
+
+    /**
+     * Take the next packet in order, if it has arrived
+     */
+    std::optional<Handle> pop() {
+        if (_head == _end) {
+            return std::nullopt;
+        }
+        std::size_t slot = _head & (Capacity - 1);
+        if (!_isPresent(slot)) {
+            return std::nullopt;
+        }
+        ++_head;
+        return _take(slot);
+    }
+
+    /**
+     * Give up on the next packet (e.g. its playout time has passed),
+     * dropping it if it's held.  Returns false if the window is empty.
+     */
+    bool skip() {
+        if (_head == _end) {
+            return false;
+        }
+        std::size_t slot = _head & (Capacity - 1);
+        if (_isPresent(slot)) {
+            _take(slot);
+        }
+        ++_head;
+        return true;
+    }
+
+    /**
+     * Call f(seq) for each sequence number in the window that hasn't
+     * arrived, oldest first
+     */
+    template<typename F>
+    void forEachMissing(F&& f) const {
+        std::size_t pos = _head & (Capacity - 1);
+        std::size_t remaining = window();
+        uint16_t seq = _head;
+        while (remaining > 0) {
+            std::size_t bit = pos % 64;
+            std::size_t count = std::min<std::size_t>(64 - bit, remaining);
+            uint64_t missing = ~_present[pos / 64] >> bit;
+            if (count < 64) {
+                missing &= (uint64_t(1) << count) - 1;
+            }
+            while (missing) {
+                int index = std::countr_zero(missing);
+                f(static_cast<uint16_t>(seq + index));
+                missing &= missing - 1;
+            }
+            pos = (pos + count) & (Capacity - 1);
+            seq += count;
+            remaining -= count;
+        }
+    }
+
+    /**
+     * Write the missing sequence numbers (as for forEachMissing) to out,
+     * e.g. for RtcpWriter::writeNack.  Returns how many were written;
+     * any that don't fit are left out.
+     */
+    std::size_t missing(std::span<uint16_t> out) const {
+        std::size_t count = 0;
+        forEachMissing([&](uint16_t seq) {
+            if (count < out.size()) {
+                out[count++] = seq;
+            }
+        });
+        return count;
+    }
+
+    /**
+     * The next sequence number to play out
+     */
+    uint16_t head() const {
+        return _head;
+    }
+
+    /**
+     * The number of sequence numbers from the next to play out
+     * through the newest received
+     */
+    std::size_t window() const {
+        return static_cast<uint16_t>(_end - _head);
+    }
+
+    /**
+     * The number of packets held
+     */
+    std::size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    /**
+     * The number of held packets dropped by the window sliding forward
+     * (or restarting)
+     */
+    std::size_t overflowDrops() const {
+        return _overflowDrops;
+    }
+
+    /**
+     * The number of times the window restarted after a run of late
+     * packets
+     */
+    std::size_t resyncs() const {
+        return _resyncs;
+    }
+
+protected:
+    std::array<Handle, Capacity> _slots;
+    std::array<uint64_t, Capacity / 64> _present = {};
+    bool _started = false;
+    uint16_t _head = 0;
+    // One past the newest sequence number received
+    uint16_t _end = 0;
+    std::size_t _size = 0;
+    std::size_t _overflowDrops = 0;
+    // TooLate packets since the last one that wasn't
+    std::size_t _tooLate = 0;
+    std::size_t _resyncs = 0;
+
+    bool _isPresent(std::size_t slot) const {
+        return _present[slot / 64] & (uint64_t(1) << (slot % 64));
+    }
+
+    Handle _take(std::size_t slot) {
+        _present[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+        --_size;
+        return std::move(_slots[slot]);
+    }
+
+    /**
+     * Nothing held survives: clear it all at once
+     */
+    void _dropAll() {
+        for (std::size_t i = 0; i < _present.size(); ++i) {
+            for (uint64_t bits = _present[i]; bits; bits &= bits - 1) {
+                _slots[i * 64 + std::countr_zero(bits)].reset();
+            }
+            _present[i] = 0;
+        }
+        _overflowDrops += _size;
+        _size = 0;
+    }
+
+    void _resync(uint16_t seq) {
+        _dropAll();
+        _head = seq;
+        _end = seq;
+        ++_resyncs;
+    }
+
+    void _advanceTo(uint16_t head) {
+        std::size_t distance = static_cast<uint16_t>(head - _head);
+        if (distance >= Capacity) {
+            _dropAll();
+        } else {
+            for (; _head != head; ++_head) {
+                std::size_t slot = _head & (Capacity - 1);
+                if (_isPresent(slot)) {
+                    _take(slot).reset();
+                    ++_overflowDrops;
+                }
+            }
+        }
+        _head = head;
+        if (jitter_detail::seqDiff(_end, _head) > 0) {
+            _end = _head;
+        }
+    }
+};
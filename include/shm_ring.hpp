@@ -0,0 +1,365 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <new>
+#include <optional>
+#include <span>
+#include <utility>
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "network_buffer.hpp"
+
+namespace shm_detail {
+    constexpr uint32_t magic = 0x4E425247; // "NBRG"
+
+    inline long futex(std::atomic<uint32_t>* addr, int op, uint32_t val, const timespec* timeout = nullptr) {
+        // Not FUTEX_PRIVATE_FLAG: the word is shared between processes
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), op, val, timeout, nullptr, 0);
+    }
+
+    /**
+     * Block until *addr no longer holds val (or a spurious wakeup,
+     * or the timeout).  A negative timeout waits forever.
+     */
+    inline void wait(std::atomic<uint32_t>* addr, uint32_t val, long timeoutNs) {
+        timespec timeout{static_cast<time_t>(timeoutNs / 1'000'000'000), static_cast<long>(timeoutNs % 1'000'000'000)};
+        futex(addr, FUTEX_WAIT, val, timeoutNs < 0 ? nullptr : &timeout);
+    }
+
+    inline void wake(std::atomic<uint32_t>* addr) {
+        futex(addr, FUTEX_WAKE, 1);
+    }
+}
+
+/**
+ * A single producer, single consumer ring of NetworkBuffer slots in
+ * shared memory, for passing messages between processes without
+ * copying them through a socket.  The producer writes a message
+ * straight into a slot and the consumer reads it in place.
+ *
+ * The region is a memfd, so it has no name to clean up: one process
+ * creates it and the other attaches to its file descriptor (inherited
+ * across fork or passed over a Unix socket).  Everything in the region
+ * is position independent (the ring positions are counters, and the
+ * buffers keep offsets), so each process can map it anywhere.
+ *
+ *   // Producer
+ *   if (auto* slot = ring.beginWrite()) {
+ *       slot->write(...);
+ *       ring.commitWrite();
+ *   }
+ *
+ *   // Consumer
+ *   while (ring.waitForData(-1)) {
+ *       if (auto message = ring.peek()) {
+ *           ...
+ *       }
+ *       ring.release();
+ *   }
+ *
+ * Neither side trusts what the other wrote to the region: a slot whose
+ * positions don't make sense (the producer crashed mid-write, or is
+ * misbehaving) is reported by corrupt() rather than read.
+ *
+ * Each side may block on a futex in the shared region when the ring is
+ * empty (or full); the other side only makes the wake syscall when
+ * someone is actually waiting.
+ */
+template<unsigned int SLOT_SIZE = 2048, std::size_t Slots = 1024>
+class ShmRing {
+public:
+    static_assert((Slots & (Slots - 1)) == 0, "slots must be a power of 2");
+    static_assert(Slots <= (std::size_t(1) << 31), "positions must not wrap within the ring");
+
+    using Buffer = NetworkBuffer<SLOT_SIZE>;
+
+    /**
+     * Create a new ring in a fresh memfd
+     */
+    static std::optional<ShmRing> create(const char* name = "network_buffer_ring") {
+        int fd = memfd_create(name, MFD_CLOEXEC);
+        if (fd < 0) {
+            return std::nullopt;
+        }
+        if (ftruncate(fd, regionSize) < 0) {
+            close(fd);
+            return std::nullopt;
+        }
+        auto ring = _map(fd);
+        if (!ring) {
+            return std::nullopt;
+        }
+        new (ring->_header) Header{};
+        ring->_header->magic = shm_detail::magic;
+        ring->_header->slotSize = SLOT_SIZE;
+        ring->_header->slots = Slots;
+        return ring;
+    }
+
+    /**
+     * Attach to a ring created (with the same parameters) by another
+     * process.  Takes ownership of the file descriptor.
+     */
+    static std::optional<ShmRing> attach(int fd) {
+        // A region too small to hold the ring would SIGBUS on first use
+        struct stat st;
+        if (fstat(fd, &st) < 0 || static_cast<std::size_t>(st.st_size) < regionSize) {
+            close(fd);
+            return std::nullopt;
+        }
+        auto ring = _map(fd);
+        if (!ring) {
+            return std::nullopt;
+        }
+        const Header* header = ring->_header;
+        if (header->magic != shm_detail::magic || header->slotSize != SLOT_SIZE || header->slots != Slots) {
+            return std::nullopt;
+        }
+        return ring;
+    }
+
+    ShmRing(ShmRing&& other) :
+        _fd(std::exchange(other._fd, -1)), _region(std::exchange(other._region, nullptr)),
+        _header(other._header), _slots(other._slots) {}
+
+    ShmRing& operator=(ShmRing&& other) {
+        if (this != &other) {
+            _unmap();
+            _fd = std::exchange(other._fd, -1);
+            _region = std::exchange(other._region, nullptr);
+            _header = other._header;
+            _slots = other._slots;
+        }
+        return *this;
+    }
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    ~ShmRing() {
+        _unmap();
+    }
+
+    /**
+     * The memfd, to hand to the other process
+     */
+    int fd() const {
+        return _fd;
+    }
+
+    // Producer side
+
+    /**
+     * The next slot to write a message into, empty, or nullptr if
+     * the ring is full.  Nothing is visible to the consumer until
+     * commitWrite.
+     */
+    Buffer* beginWrite() {
+        uint32_t tail = _header->tail.load(std::memory_order_relaxed);
+        if (tail - _header->head.load(std::memory_order_acquire) == Slots) {
+            return nullptr;
+        }
+        Buffer* slot = &_slots[tail & (Slots - 1)];
+        slot->clear();
+        return slot;
+    }
+
+    /**
+     * Publish the slot returned by beginWrite
+     */
+    void commitWrite() {
+        _header->tail.fetch_add(1, std::memory_order_seq_cst);
+        if (_header->consumerWaiting.load(std::memory_order_seq_cst)) {
+            shm_detail::wake(&_header->tail);
+        }
+    }
+
+    /**
+     * Copy a message into the next slot.  Returns false if the ring
+     * is full.
+     */
+    bool push(std::span<const uint8_t> message) {
+        Buffer* slot = beginWrite();
+        if (!slot) {
+            return false;
+        }
+        slot->write(message.data(), message.size());
+        commitWrite();
+        return true;
+    }
+
+    /**
+     * Wait until there is a free slot.  Returns false on timeout.
+     * A negative timeout waits forever.
+     */
+    bool waitForSpace(long timeoutNs) {
+        return _waitUntil(_header->head, _header->producerWaiting, timeoutNs, [&] {
+            return _header->tail.load(std::memory_order_relaxed) - _header->head.load(std::memory_order_acquire) < Slots;
+        });
+    }
+
+    // Consumer side
+
+    /**
+     * A view of the oldest message, valid until release, or nullopt
+     * if the ring is empty or the message's slot is corrupt (see
+     * corrupt; release it to move past it)
+     */
+    std::optional<std::span<const uint8_t>> peek() const {
+        auto mark = _oldestMark();
+        if (!mark || !_valid(*mark)) {
+            return std::nullopt;
+        }
+        const Buffer& slot = _slots[_header->head.load(std::memory_order_relaxed) & (Slots - 1)];
+        return std::span<const uint8_t>(slot._buffer + mark->head, mark->tail - mark->head);
+    }
+
+    /**
+     * Whether the oldest message's slot has positions that don't fit
+     * in it, so it can't be read
+     */
+    bool corrupt() const {
+        auto mark = _oldestMark();
+        return mark && !_valid(*mark);
+    }
+
+    /**
+     * Hand the oldest message's slot back to the producer
+     */
+    void release() {
+        _header->head.fetch_add(1, std::memory_order_seq_cst);
+        if (_header->producerWaiting.load(std::memory_order_seq_cst)) {
+            shm_detail::wake(&_header->head);
+        }
+    }
+
+    /**
+     * Wait until there is a message.  Returns false on timeout.
+     * A negative timeout waits forever.
+     */
+    bool waitForData(long timeoutNs) {
+        return _waitUntil(_header->tail, _header->consumerWaiting, timeoutNs, [&] {
+            return _header->head.load(std::memory_order_relaxed) != _header->tail.load(std::memory_order_acquire);
+        });
+    }
+
+    /**
+     * The number of messages written but not yet released
+     */
+    std::size_t size() const {
+        return _header->tail.load(std::memory_order_acquire) - _header->head.load(std::memory_order_acquire);
+    }
+
+protected:
+    /**
+     * At the start of the region.  Each side's position is on a cache
+     * line of its own so the two processes don't false share.
+     */
+    struct Header {
+        uint32_t magic;
+        uint32_t slotSize;
+        uint64_t slots;
+        alignas(64) std::atomic<uint32_t> head{0};
+        std::atomic<uint32_t> producerWaiting{0};
+        alignas(64) std::atomic<uint32_t> tail{0};
+        std::atomic<uint32_t> consumerWaiting{0};
+    };
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "atomics in shared memory must be lock free");
+
+    static constexpr std::size_t headerSize = (sizeof(Header) + alignof(Buffer) - 1) / alignof(Buffer) * alignof(Buffer);
+    static constexpr std::size_t regionSize = headerSize + sizeof(Buffer) * Slots;
+
+    int _fd = -1;
+    void* _region = nullptr;
+    Header* _header = nullptr;
+    Buffer* _slots = nullptr;
+
+    ShmRing() = default;
+
+    /**
+     * The positions of the oldest message's slot, read once (the
+     * producer's process could be changing them), or nullopt if the
+     * ring is empty
+     */
+    std::optional<typename Buffer::Mark> _oldestMark() const {
+        uint32_t head = _header->head.load(std::memory_order_relaxed);
+        if (head == _header->tail.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        return _slots[head & (Slots - 1)].mark();
+    }
+
+    static bool _valid(typename Buffer::Mark mark) {
+        return mark.head <= mark.tail && mark.tail <= SLOT_SIZE;
+    }
+
+    static std::optional<ShmRing> _map(int fd) {
+        void* region = mmap(nullptr, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (region == MAP_FAILED) {
+            close(fd);
+            return std::nullopt;
+        }
+        ShmRing ring;
+        ring._fd = fd;
+        ring._region = region;
+        ring._header = static_cast<Header*>(region);
+        ring._slots = reinterpret_cast<Buffer*>(static_cast<uint8_t*>(region) + headerSize);
+        return ring;
+    }
+
+    void _unmap() {
+        if (_region) {
+            munmap(_region, regionSize);
+            _region = nullptr;
+        }
+        if (_fd >= 0) {
+            close(_fd);
+            _fd = -1;
+        }
+    }
+
+    /**
+     * Announce that we're waiting, check the condition again (the
+     * other side checks the flag after publishing, so one of us is
+     * sure to see the other) and sleep on the futex word the other
+     * side bumps.  A wake can be stale (meant for an earlier wait
+     * that didn't need to sleep after all), so keep waiting until
+     * the condition holds or the time is up.
+     */
+    template<typename Ready>
+    bool _waitUntil(std::atomic<uint32_t>& word, std::atomic<uint32_t>& waiting, long timeoutNs, Ready&& ready) {
+        if (ready()) {
+            return true;
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeoutNs);
+        waiting.store(1, std::memory_order_seq_cst);
+        while (true) {
+            uint32_t seen = word.load(std::memory_order_seq_cst);
+            if (ready()) {
+                break;
+            }
+            long remaining = -1;
+            if (timeoutNs >= 0) {
+                remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+                if (remaining <= 0) {
+                    break;
+                }
+            }
+            shm_detail::wait(&word, seen, remaining);
+        }
+        waiting.store(0, std::memory_order_relaxed);
+        return ready();
+    }
+};
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <source_location>
+#include <tuple>
+#include <utility>
+
+#include "buffer_pool.hpp"
+#include "network_buffer.hpp"
+
+/**
+ * Pools of NetworkBuffers in several sizes, so that small messages
+ * don't each tie up a buffer big enough for the largest one:
+ *
+ *   SizeClassPool<256, 1500, 9216, 65536> pool({ 4096, 1024, 64, 4 });
+ *   if (auto buffer = pool.acquire(expectedSize)) {
+ *       buffer->visit([&](auto& buf) { buf.write(...); });
+ *   }
+ *
+ * acquire gives a buffer of the smallest class that holds the
+ * requested size, or of a larger class if that one is used up.  Like
+ * BufferPool, all the buffers are allocated up front.
+ *
+ * The pool keeps track of the most buffers held at once by the class
+ * asked for, and when a buffer is released, of how many bytes were
+ * written into it.  suggestCapacities turns the former into how many
+ * buffers of each class to preallocate next time; the latter shows
+ * whether the sizes asked for are bigger than they need to be.
+ */
+template<unsigned int... Sizes>
+class SizeClassPool {
+public:
+    static constexpr std::size_t classes = sizeof...(Sizes);
+    static constexpr std::array<std::size_t, classes> sizes = { Sizes... };
+
+    static_assert(classes > 0 && classes < 256, "there must be 1 to 255 size classes");
+    static_assert(std::ranges::adjacent_find(sizes, std::greater_equal<>()) == sizes.end(),
+                  "size classes must be strictly increasing");
+
+    // Bucket b counts messages of [2^(b-1), 2^b) bytes (bucket 0: empty)
+    static constexpr std::size_t histogramBuckets = std::bit_width(sizes.back()) + 1;
+
+    /**
+     * Owns one buffer of one of the classes, returning it (and
+     * recording how much it was used) when destroyed
+     */
+    class Handle {
+    public:
+        Handle() = default;
+
+        Handle(Handle&& other) :
+            _pool(std::exchange(other._pool, nullptr)), _index(other._index),
+            _class(other._class), _requested(other._requested) {}
+
+        Handle& operator=(Handle&& other) {
+            if (this != &other) {
+                reset();
+                _pool = std::exchange(other._pool, nullptr);
+                _index = other._index;
+                _class = other._class;
+                _requested = other._requested;
+            }
+            return *this;
+        }
+
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+
+        ~Handle() {
+            reset();
+        }
+
+        /**
+         * Return the buffer to its pool now
+         */
+        void reset() {
+            if (_pool) {
+                _pool->_release(_class, _requested, _index);
+                _pool = nullptr;
+            }
+        }
+
+        explicit operator bool() const {
+            return _pool != nullptr;
+        }
+
+        /**
+         * Call f with the buffer, as the NetworkBuffer of its class.
+         * f is instantiated for every class, so it's typically a
+         * generic lambda.
+         */
+        template<typename F>
+        decltype(auto) visit(F&& f) const {
+            assert(_pool);
+            return _pool->_forClass(_class, [&](auto& pool) -> decltype(auto) {
+                return f(pool.buffer(_index));
+            });
+        }
+
+        /**
+         * The index of the buffer's class in Sizes
+         */
+        std::size_t sizeClass() const {
+            return _class;
+        }
+
+        /**
+         * The buffer's capacity
+         */
+        std::size_t capacity() const {
+            return sizes[_class];
+        }
+
+    protected:
+        friend class SizeClassPool;
+
+        SizeClassPool* _pool = nullptr;
+        // Within the class's BufferPool
+        uint32_t _index = 0;
+        uint8_t _class = 0;
+        // The class that fits the size asked for
+        uint8_t _requested = 0;
+
+        Handle(SizeClassPool* pool, uint32_t index, std::size_t sizeClass, std::size_t requested) :
+            _pool(pool), _index(index), _class(sizeClass), _requested(requested) {}
+    };
+
+    /**
+     * Preallocate the given number of buffers of each class
+     */
+    explicit SizeClassPool(const std::array<std::size_t, classes>& capacities) :
+        SizeClassPool(capacities, std::make_index_sequence<classes>()) {}
+
+    SizeClassPool(const SizeClassPool&) = delete;
+    SizeClassPool& operator=(const SizeClassPool&) = delete;
+
+    /**
+     * Take an empty buffer that can hold at least sizeHint bytes, or
+     * nullopt if there's none left (or sizeHint is bigger than the
+     * largest class)
+     */
+    std::optional<Handle> acquire(std::size_t sizeHint, std::source_location site = std::source_location::current()) {
+        std::size_t requested = std::ranges::lower_bound(sizes, sizeHint) - sizes.begin();
+        if (requested == classes) {
+            ++_failures;
+            return std::nullopt;
+        }
+        auto handle = _acquire<0>(requested, site);
+        if (handle) {
+            _peakHeld[requested] = std::max(_peakHeld[requested], ++_held[requested]);
+        }
+        return handle;
+    }
+
+    std::size_t capacity(std::size_t sizeClass) const {
+        return _forClass(sizeClass, [](const auto& pool) { return pool.capacity(); });
+    }
+
+    std::size_t available(std::size_t sizeClass) const {
+        return _forClass(sizeClass, [](const auto& pool) { return pool.available(); });
+    }
+
+    /**
+     * Bytes held by all the buffers of all the classes
+     */
+    std::size_t footprint() const {
+        std::size_t bytes = 0;
+        std::size_t sizeClass = 0;
+        ((bytes += capacity(sizeClass++) * sizeof(NetworkBuffer<Sizes>)), ...);
+        return bytes;
+    }
+
+    /**
+     * Counts of released buffers by the number of bytes written into
+     * them (see histogramBuckets)
+     */
+    const std::array<std::size_t, histogramBuckets>& histogram() const {
+        return _histogram;
+    }
+
+    /**
+     * Counts of released buffers by the smallest class their
+     * contents would have fit in
+     */
+    const std::array<std::size_t, classes>& demand() const {
+        return _demand;
+    }
+
+    /**
+     * The most buffers held at once that were asked for with sizes
+     * in each class
+     */
+    const std::array<std::size_t, classes>& peakHeld() const {
+        return _peakHeld;
+    }
+
+    /**
+     * Acquires given a larger class than asked for, because the
+     * right one was used up
+     */
+    std::size_t fallbacks() const {
+        return _fallbacks;
+    }
+
+    /**
+     * Acquires that got nothing
+     */
+    std::size_t failures() const {
+        return _failures;
+    }
+
+    /**
+     * How many buffers of each class to preallocate to meet the demand
+     * seen so far: the most held at once in each class (see peakHeld),
+     * times the given headroom.  Pass the result to the constructor of
+     * the pool's replacement (e.g. at the next restart).  Returns the
+     * current capacities if nothing has been acquired yet.
+     */
+    std::array<std::size_t, classes> suggestCapacities(double headroom = 1.25) const {
+        std::array<std::size_t, classes> capacities;
+        bool used = std::ranges::any_of(_peakHeld, [](std::size_t peak) { return peak > 0; });
+        for (std::size_t i = 0; i < classes; ++i) {
+            capacities[i] = used ? static_cast<std::size_t>(std::ceil(_peakHeld[i] * headroom)) : capacity(i);
+        }
+        return capacities;
+    }
+
+protected:
+    std::tuple<BufferPool<NetworkBuffer<Sizes>>...> _pools;
+    std::array<std::size_t, histogramBuckets> _histogram = {};
+    std::array<std::size_t, classes> _demand = {};
+    std::array<std::size_t, classes> _held = {};
+    std::array<std::size_t, classes> _peakHeld = {};
+    std::size_t _fallbacks = 0;
+    std::size_t _failures = 0;
+
+    template<std::size_t... I>
+    SizeClassPool(const std::array<std::size_t, classes>& capacities, std::index_sequence<I...>) :
+        _pools(capacities[I]...) {}
+
+    template<std::size_t I>
+    std::optional<Handle> _acquire(std::size_t requested, const std::source_location& site) {
+        if constexpr (I == classes) {
+            ++_failures;
+            return std::nullopt;
+        } else {
+            if (I >= requested) {
+                if (auto handle = std::get<I>(_pools).acquire(site)) {
+                    _fallbacks += I > requested;
+                    return Handle(this, handle->release(), I, requested);
+                }
+            }
+            return _acquire<I + 1>(requested, site);
+        }
+    }
+
+    /**
+     * Call f with the BufferPool of the given class
+     */
+    template<std::size_t I = 0, typename F>
+    decltype(auto) _forClass(std::size_t sizeClass, F&& f) const {
+        assert(sizeClass < classes);
+        if constexpr (I + 1 < classes) {
+            if (sizeClass != I) {
+                return _forClass<I + 1>(sizeClass, f);
+            }
+        }
+        return f(std::get<I>(_pools));
+    }
+
+    template<std::size_t I = 0, typename F>
+    decltype(auto) _forClass(std::size_t sizeClass, F&& f) {
+        assert(sizeClass < classes);
+        if constexpr (I + 1 < classes) {
+            if (sizeClass != I) {
+                return _forClass<I + 1>(sizeClass, f);
+            }
+        }
+        return f(std::get<I>(_pools));
+    }
+
+    void _release(std::size_t sizeClass, std::size_t requested, uint32_t index) {
+        std::size_t written = _forClass(sizeClass, [&](auto& pool) {
+            std::size_t remaining = pool.buffer(index).remainingCapacity();
+            pool.release(index);
+            return sizes[sizeClass] - remaining;
+        });
+        --_held[requested];
+        ++_histogram[std::bit_width(written)];
+        std::size_t needed = std::ranges::lower_bound(sizes, written) - sizes.begin();
+        ++_demand[needed];
+    }
+};
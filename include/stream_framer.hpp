@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <sys/types.h>
+
+#include "byte_order.hpp"
+#include "byte_search.hpp"
+#include "network_buffer.hpp"
+
+/**
+ * Where a complete frame lies within the unread bytes: the
+ * payload starts at payloadOffset and the whole frame
+ * (header, payload and any trailer) takes frameSize bytes.
+ */
+struct FrameBounds {
+    std::size_t payloadOffset;
+    std::size_t payloadSize;
+    std::size_t frameSize;
+};
+
+/**
+ * Frame decoders look at the unread bytes of a stream and return
+ * the bounds of the first frame as soon as they are known (once
+ * its header has arrived), even if the frame isn't complete yet,
+ * or nullopt if they aren't known yet.  A frame whose size exceeds
+ * the framer's capacity is treated as a stream error, so a bad
+ * length is caught without waiting for the buffer to fill.
+ */
+
+/**
+ * A fixed size header containing a LenT payload length at
+ * LenOffset.  If LenIncludesHeader is set the length counts
+ * the header as well as the payload.
+ */
+template<typename LenT, std::size_t HeaderSize = sizeof(LenT), std::size_t LenOffset = 0,
+         bool LenIncludesHeader = false>
+struct FixedHeaderDecoder {
+    static_assert(LenOffset + sizeof(LenT) <= HeaderSize, "length must be within the header");
+
+    std::optional<FrameBounds> decode(std::span<const uint8_t> data) {
+        if (data.size() < HeaderSize) {
+            return std::nullopt;
+        }
+        std::size_t len = loadNetwork<LenT>(data.data() + LenOffset);
+        std::size_t frameSize = LenIncludesHeader ? len : HeaderSize + len;
+        if (frameSize < HeaderSize) {
+            // Report as an oversized frame so the framer flags an error
+            return FrameBounds{HeaderSize, 0, static_cast<std::size_t>(-1)};
+        }
+        return FrameBounds{HeaderSize, frameSize - HeaderSize, frameSize};
+    }
+};
+
+/**
+ * A base 128 varint (as used by protobuf's delimited streams)
+ * payload length
+ */
+struct VarintDecoder {
+    static constexpr std::size_t maxLenBytes = 5;
+
+    std::optional<FrameBounds> decode(std::span<const uint8_t> data) {
+        uint64_t len = 0;
+        for (std::size_t i = 0; i < data.size() && i < maxLenBytes; ++i) {
+            len |= static_cast<uint64_t>(data[i] & 0x7F) << (7 * i);
+            if (!(data[i] & 0x80)) {
+                return FrameBounds{i + 1, static_cast<std::size_t>(len), i + 1 + static_cast<std::size_t>(len)};
+            }
+        }
+        if (data.size() >= maxLenBytes) {
+            return FrameBounds{maxLenBytes, 0, static_cast<std::size_t>(-1)};
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * Write a varint length prefix
+     */
+    template<typename Buffer>
+    static void writeLength(Buffer& buffer, uint32_t len) {
+        while (len >= 0x80) {
+            buffer.write(static_cast<uint8_t>(len | 0x80));
+            len >>= 7;
+        }
+        buffer.write(static_cast<uint8_t>(len));
+    }
+};
+
+/**
+ * Frames terminated by a delimiter (e.g. "\r\n").  The payload
+ * excludes the delimiter.  Remembers how far it has searched
+ * so that bytes of a partial frame are only scanned once.
+ */
+class DelimiterDecoder {
+public:
+    explicit DelimiterDecoder(std::string_view delim) :
+        _delim(delim) {
+        assert(!_delim.empty());
+    }
+
+    std::optional<FrameBounds> decode(std::span<const uint8_t> data) {
+        const uint8_t* begin = data.data();
+        const uint8_t* end = begin + data.size();
+        const uint8_t* match = findBytes(begin + _searched, end,
+            {reinterpret_cast<const uint8_t*>(_delim.data()), _delim.size()});
+        if (match == end) {
+            // A delimiter could start in the last few bytes
+            _searched = data.size() >= _delim.size() ? data.size() - _delim.size() + 1 : 0;
+            return std::nullopt;
+        }
+        _searched = 0;
+        std::size_t payloadSize = match - begin;
+        return FrameBounds{0, payloadSize, payloadSize + _delim.size()};
+    }
+
+protected:
+    std::string _delim;
+    std::size_t _searched = 0;
+};
+
+/**
+ * Extracts complete frames from a byte stream (e.g. TCP) which
+ * arrives in arbitrarily sized pieces.  Data is received directly
+ * into the framer's buffer:
+ *
+ *   auto space = framer.writable();
+ *   ssize_t n = recv(fd, space.data(), space.size(), 0);
+ *   if (n <= 0) { ... }   // closed, or an error
+ *   framer.commit(n);
+ *   while (auto frame = framer.next()) { ... }
+ *
+ * Frames are returned as views into the buffer, and a partial
+ * frame at the end stays where it is.  Unread bytes are only
+ * moved to the front of the buffer when free space at the end
+ * drops below CompactThreshold.  Views returned by next() are
+ * valid until the following call to writable().
+ */
+template<typename Decoder, unsigned int BUF_SIZE = 65536, std::size_t CompactThreshold = BUF_SIZE / 4>
+class StreamFramer {
+public:
+    static_assert(CompactThreshold <= BUF_SIZE, "threshold can't exceed the buffer size");
+
+    explicit StreamFramer(Decoder decoder = Decoder()) :
+        _decoder(std::move(decoder)) {}
+
+    /**
+     * Space to receive more data into
+     */
+    std::span<uint8_t> writable() {
+        if (_buffer.empty() || _buffer.remainingCapacity() < CompactThreshold) {
+            _buffer.compact();
+        }
+        return {_buffer.getWriteBuffer(), _buffer.remainingCapacity()};
+    }
+
+    /**
+     * Account for numBytes received into the space from writable().
+     * Takes a ssize_t so a recv result can be passed as is, but a
+     * negative count (an error), or more than writable() had room
+     * for, is rejected: nothing is committed and false is returned.
+     */
+    bool commit(ssize_t numBytes) {
+        if (numBytes < 0 || static_cast<std::size_t>(numBytes) > _buffer.remainingCapacity()) {
+            return false;
+        }
+        _buffer.setSize(numBytes);
+        return true;
+    }
+
+    /**
+     * Return the payload of the next complete frame, if there
+     * is one, and consume the frame
+     */
+    std::optional<std::span<uint8_t>> next() {
+        if (_error || _buffer.empty()) {
+            return std::nullopt;
+        }
+        auto bounds = _decoder.decode({_buffer.getBuffer(), _buffer.size()});
+        if (!bounds) {
+            // A full buffer without a complete frame can never make progress
+            _error = _buffer.size() == BUF_SIZE;
+            return std::nullopt;
+        }
+        if (bounds->frameSize > BUF_SIZE) {
+            _error = true;
+            return std::nullopt;
+        }
+        if (bounds->frameSize > _buffer.size()) {
+            // Not all here yet (and there's room for the rest)
+            return std::nullopt;
+        }
+        uint8_t* frame = _buffer.read(bounds->frameSize);
+        return std::span<uint8_t>{frame + bounds->payloadOffset, bounds->payloadSize};
+    }
+
+    /**
+     * Whether the stream has become unparseable (a frame too
+     * large for the buffer, or a malformed length)
+     */
+    bool error() const {
+        return _error;
+    }
+
+    /**
+     * The number of bytes received but not yet returned as frames
+     */
+    std::size_t pending() const {
+        return _buffer.size();
+    }
+
+protected:
+    NetworkBuffer<BUF_SIZE> _buffer;
+    Decoder _decoder;
+    bool _error = false;
+};
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <endian.h>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <span>
+
+#include "byte_order.hpp"
+
+/**
+ * Describes the layout of a type-length-value sequence.  Specific
+ * protocols derive from this and override the constants that differ.
+ *
+ *  alignment: each value is zero padded to a multiple of this
+ *  bigEndian: byte order of the type and length fields
+ *  lengthIncludesHeader: the length counts the type and length fields
+ *  padType: a single byte type that carries no length or value
+ *  endType: a type that terminates the sequence
+ */
+template<typename TypeT, typename LenT>
+struct TlvFormat {
+    using Type = TypeT;
+    using Length = LenT;
+    static constexpr std::size_t alignment = 1;
+    static constexpr bool bigEndian = true;
+    static constexpr bool lengthIncludesHeader = false;
+    static constexpr int padType = -1;
+    static constexpr int endType = -1;
+
+    static constexpr std::size_t headerSize = sizeof(TypeT) + sizeof(LenT);
+};
+
+/**
+ * RFC 8489 STUN attributes
+ */
+struct StunAttributeFormat : TlvFormat<uint16_t, uint16_t> {
+    static constexpr std::size_t alignment = 4;
+};
+
+/**
+ * RFC 2132 DHCP options
+ */
+struct DhcpOptionFormat : TlvFormat<uint8_t, uint8_t> {
+    static constexpr int padType = 0;
+    static constexpr int endType = 255;
+};
+
+/**
+ * RFC 9293 TCP options
+ */
+struct TcpOptionFormat : TlvFormat<uint8_t, uint8_t> {
+    static constexpr bool lengthIncludesHeader = true;
+    static constexpr int padType = 1; // NOP
+    static constexpr int endType = 0; // End of option list
+};
+
+template<typename Format>
+struct Tlv {
+    typename Format::Type type;
+    std::span<const uint8_t> value;
+};
+
+namespace tlv_detail {
+    template<typename Format, typename T>
+    inline T load(const uint8_t* src) {
+        if constexpr (Format::bigEndian) {
+            return loadNetwork<T>(src);
+        } else {
+            T val;
+            memcpy(&val, src, sizeof(T));
+            if constexpr (sizeof(T) == 2) {
+                return le16toh(val);
+            } else if constexpr (sizeof(T) == 4) {
+                return le32toh(val);
+            } else {
+                return val;
+            }
+        }
+    }
+
+    template<typename Format, typename T>
+    inline void store(uint8_t* dst, T val) {
+        if constexpr (Format::bigEndian) {
+            storeNetwork(dst, val);
+        } else {
+            if constexpr (sizeof(T) == 2) {
+                val = htole16(val);
+            } else if constexpr (sizeof(T) == 4) {
+                val = htole32(val);
+            }
+            memcpy(dst, &val, sizeof(T));
+        }
+    }
+
+    constexpr std::size_t alignUp(std::size_t len, std::size_t alignment) {
+        return (len + alignment - 1) / alignment * alignment;
+    }
+}
+
+/**
+ * Lazily walks a TLV sequence, yielding views into the
+ * underlying bytes.  Nothing is copied and the bytes are
+ * not consumed: reading the options of a packet held in
+ * a NetworkBuffer leaves the buffer's position untouched.
+ *
+ * A truncated element stops the walk and sets malformed().
+ */
+template<typename Format>
+class TlvReader {
+public:
+    using Type = typename Format::Type;
+    using Length = typename Format::Length;
+    static_assert(sizeof(Type) == 1 || (Format::padType < 0 && Format::endType < 0),
+                  "pad and end types are only supported for single byte types");
+
+    TlvReader(const uint8_t* data, std::size_t size) :
+        _pos(data), _end(data + size) {}
+
+    explicit TlvReader(std::span<const uint8_t> data) :
+        TlvReader(data.data(), data.size()) {}
+
+    /**
+     * Walk the readable bytes of the given buffer
+     */
+    template<typename Buffer>
+        requires requires(const Buffer& b) { b.getBuffer(); b.size(); }
+    explicit TlvReader(const Buffer& buffer) :
+        TlvReader(buffer.getBuffer(), buffer.size()) {}
+
+    std::optional<Tlv<Format>> next() {
+        if constexpr (Format::padType >= 0) {
+            while (_pos < _end && *_pos == Format::padType) {
+                ++_pos;
+            }
+        }
+        if (_pos == _end) {
+            return std::nullopt;
+        }
+        if constexpr (Format::endType >= 0) {
+            if (*_pos == Format::endType) {
+                _pos = _end;
+                return std::nullopt;
+            }
+        }
+        if (static_cast<std::size_t>(_end - _pos) < Format::headerSize) {
+            return _fail();
+        }
+        Type type = tlv_detail::load<Format, Type>(_pos);
+        std::size_t len = tlv_detail::load<Format, Length>(_pos + sizeof(Type));
+        const uint8_t* value = _pos + Format::headerSize;
+        if constexpr (Format::lengthIncludesHeader) {
+            if (len < Format::headerSize) {
+                return _fail();
+            }
+            len -= Format::headerSize;
+        }
+        std::size_t available = _end - value;
+        if (len > available) {
+            return _fail();
+        }
+        std::size_t padded = tlv_detail::alignUp(len, Format::alignment);
+        // The final element's padding may legitimately be absent
+        _pos = value + (padded < available ? padded : available);
+        return Tlv<Format>{type, {value, len}};
+    }
+
+    bool malformed() const {
+        return _malformed;
+    }
+
+    /**
+     * The bytes that have not been walked yet
+     */
+    std::span<const uint8_t> remaining() const {
+        return {_pos, static_cast<std::size_t>(_end - _pos)};
+    }
+
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Tlv<Format>;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator() = default;
+        explicit Iterator(TlvReader* reader) :
+            _reader(reader), _curr(reader->next()) {}
+
+        const Tlv<Format>& operator*() const { return *_curr; }
+        const Tlv<Format>* operator->() const { return &*_curr; }
+
+        Iterator& operator++() {
+            _curr = _reader->next();
+            return *this;
+        }
+
+        void operator++(int) { ++*this; }
+
+        bool operator==(std::default_sentinel_t) const {
+            return !_curr.has_value();
+        }
+
+    private:
+        TlvReader* _reader = nullptr;
+        std::optional<Tlv<Format>> _curr;
+    };
+
+    Iterator begin() { return Iterator(this); }
+    std::default_sentinel_t end() { return {}; }
+
+protected:
+    const uint8_t* _pos;
+    const uint8_t* _end;
+    bool _malformed = false;
+
+    std::optional<Tlv<Format>> _fail() {
+        _malformed = true;
+        _pos = _end;
+        return std::nullopt;
+    }
+};
+
+/**
+ * Appends elements of the given format to a buffer
+ */
+template<typename Format>
+class TlvWriter {
+public:
+    using Type = typename Format::Type;
+    using Length = typename Format::Length;
+
+    template<typename Buffer>
+    static void write(Buffer& buffer, Type type, std::span<const uint8_t> value) {
+        std::size_t len = value.size();
+        if constexpr (Format::lengthIncludesHeader) {
+            len += Format::headerSize;
+        }
+        assert(len <= std::numeric_limits<Length>::max());
+        uint8_t header[Format::headerSize];
+        tlv_detail::store<Format, Type>(header, type);
+        tlv_detail::store<Format, Length>(header + sizeof(Type), static_cast<Length>(len));
+        buffer.write(header, Format::headerSize);
+        buffer.write(value.data(), value.size());
+        _pad(buffer, value.size());
+    }
+
+    /**
+     * Write a single byte pad element, for formats which have one
+     */
+    template<typename Buffer>
+    static void writePad(Buffer& buffer) {
+        static_assert(Format::padType >= 0, "format has no pad type");
+        buffer.write(static_cast<uint8_t>(Format::padType));
+    }
+
+    /**
+     * Write the terminating element, for formats which have one
+     */
+    template<typename Buffer>
+    static void writeEnd(Buffer& buffer) {
+        static_assert(Format::endType >= 0, "format has no end type");
+        buffer.write(static_cast<uint8_t>(Format::endType));
+    }
+
+protected:
+    template<typename Buffer>
+    static void _pad(Buffer& buffer, std::size_t len) {
+        static constexpr uint8_t zeros[Format::alignment] = {};
+        std::size_t padding = tlv_detail::alignUp(len, Format::alignment) - len;
+        if (padding) {
+            buffer.write(zeros, padding);
+        }
+    }
+};
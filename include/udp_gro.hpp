@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+
+#include "network_buffer.hpp"
+
+/**
+ * Receives UDP datagrams coalesced by generic receive offload
+ * (Linux 5.0+).  With UDP_GRO enabled on the socket, the kernel
+ * may hand back several same-source datagrams in one read along
+ * with the size they were split at.  GroReader reads into one
+ * large NetworkBuffer and hands out each datagram as a view
+ * into it, so many datagrams are processed per syscall with
+ * no copies:
+ *
+ *   GroReader<> reader;
+ *   GroReader<>::enable(fd);
+ *   for (;;) {
+ *       if (reader.receive(fd) < 0) {
+ *           if (errno == EMSGSIZE || errno == ENOBUFS) {
+ *               continue;   // dropped, see receive
+ *           }
+ *           break;          // EAGAIN, or a socket error
+ *       }
+ *       while (auto datagram = reader.next()) { ... }
+ *   }
+ *
+ * Views are valid until the next call to receive.
+ */
+template<unsigned int BUF_SIZE = 65536>
+class GroReader {
+public:
+    /**
+     * Ask the kernel to coalesce datagrams on the given socket.
+     * Returns false if it isn't supported.
+     */
+    static bool enable(int fd) {
+        int on = 1;
+        return setsockopt(fd, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+    }
+
+    /**
+     * Read the next (possibly coalesced) datagram, replacing anything
+     * not yet consumed.  Returns the number of bytes read, or -1 with
+     * errno set.  A read that didn't fit in the buffer fails with
+     * EMSGSIZE and nothing is handed out, since the kernel drops the
+     * rest and the last segment (or a whole datagram) would be cut
+     * short.  Likewise if the control data was cut short (too
+     * many other ancillary messages are enabled on the socket),
+     * since the segment size may have been lost.
+     */
+    ssize_t receive(int fd, int flags = 0) {
+        // Any unconsumed datagrams are dropped: start over at the front
+        _buffer.clear();
+
+        iovec iov{_buffer.getWriteBuffer(), _buffer.remainingCapacity()};
+        alignas(cmsghdr) char control[controlSize];
+        msghdr msg{};
+        msg.msg_name = &_source;
+        msg.msg_namelen = sizeof(_source);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t res = recvmsg(fd, &msg, flags);
+        if (res < 0) {
+            return res;
+        }
+        if (msg.msg_flags & MSG_TRUNC) {
+            _segmentSize = 0;
+            errno = EMSGSIZE;
+            return -1;
+        }
+        if (msg.msg_flags & MSG_CTRUNC) {
+            _segmentSize = 0;
+            errno = ENOBUFS;
+            return -1;
+        }
+        _buffer.setSize(res);
+        _segmentSize = res;
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                int gsoSize;
+                memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof(gsoSize));
+                if (gsoSize > 0) {
+                    _segmentSize = gsoSize;
+                }
+            }
+        }
+        return res;
+    }
+
+    /**
+     * The next datagram of the last read.  All but the last are
+     * segmentSize() bytes.
+     */
+    std::optional<std::span<uint8_t>> next() {
+        if (_buffer.empty() || _segmentSize == 0) {
+            return std::nullopt;
+        }
+        std::size_t len = _buffer.size() < _segmentSize ? _buffer.size() : _segmentSize;
+        return std::span<uint8_t>{_buffer.read(len), len};
+    }
+
+    /**
+     * The number of datagrams in the last read which haven't been
+     * returned by next() yet
+     */
+    std::size_t remainingDatagrams() const {
+        return _segmentSize ? (_buffer.size() + _segmentSize - 1) / _segmentSize : 0;
+    }
+
+    std::size_t segmentSize() const {
+        return _segmentSize;
+    }
+
+    /**
+     * The sender of the last read (coalesced datagrams always
+     * share a source)
+     */
+    const sockaddr_storage& source() const {
+        return _source;
+    }
+
+protected:
+    // Room for the segment size plus the ancillary data commonly
+    // enabled alongside it: a timestamp (up to the three of
+    // SO_TIMESTAMPING), packet info and a TOS/TTL or two
+    static constexpr std::size_t controlSize =
+        CMSG_SPACE(sizeof(int)) +
+        CMSG_SPACE(3 * sizeof(timespec)) +
+        CMSG_SPACE(sizeof(in6_pktinfo)) +
+        2 * CMSG_SPACE(sizeof(int));
+
+    NetworkBuffer<BUF_SIZE> _buffer;
+    std::size_t _segmentSize = 0;
+    sockaddr_storage _source{};
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "network_buffer.hpp"
+
+/**
+ * Sends many same-destination UDP datagrams with one syscall using
+ * UDP generic segmentation offload (Linux 4.18+).  Payloads are packed
+ * back to back into one large buffer and the kernel splits it into
+ * datagrams of segmentSize bytes on the way out.
+ *
+ * Every datagram but the last of a batch must be exactly segmentSize
+ * bytes, so appending a shorter payload flushes the batch.  Batches
+ * GSO can't send go out with sendmmsg instead, one message per
+ * datagram.  The writer stops trying GSO for good only when the
+ * kernel doesn't know the option at all (probed when it's created),
+ * or when gsoRetries batches in a row are rejected: EINVAL or EIO can
+ * mean the device can't segment, but also just one bad batch.
+ */
+template<unsigned int BUF_SIZE = 65536>
+class GsoWriter {
+public:
+    // The kernel's limit on segments per send (UDP_MAX_SEGMENTS)
+    static constexpr std::size_t maxSegments = 64;
+    // The largest UDP payload that fits in one IPv4 datagram
+    static constexpr std::size_t maxGsoBytes = 65507;
+    // Rejected GSO sends in a row after which GSO is turned off
+    static constexpr std::size_t gsoRetries = 2;
+
+    GsoWriter(int fd, const sockaddr* dest, socklen_t destLen, uint16_t segmentSize) :
+        _fd(fd), _destLen(destLen), _segmentSize(segmentSize) {
+        assert(destLen <= sizeof(_dest));
+        assert(segmentSize > 0 && segmentSize <= BUF_SIZE);
+        memcpy(&_dest, dest, destLen);
+        // Kernels without UDP GSO don't know the option at all
+        int gsoSize = 0;
+        socklen_t len = sizeof(gsoSize);
+        if (getsockopt(_fd, SOL_UDP, UDP_SEGMENT, &gsoSize, &len) < 0 && errno == ENOPROTOOPT) {
+            _gsoAvailable = false;
+        }
+    }
+
+    ~GsoWriter() {
+        flush();
+    }
+
+    GsoWriter(const GsoWriter&) = delete;
+    GsoWriter& operator=(const GsoWriter&) = delete;
+
+    /**
+     * Queue a datagram.  Returns the number of datagrams sent by any
+     * flushes this caused (a full batch, then a short or empty
+     * payload, can cause two), 0 if the datagram was only queued, or -1 with errno
+     * set if a flush failed.
+     */
+    ssize_t append(std::span<const uint8_t> payload) {
+        assert(payload.size() <= _segmentSize);
+        ssize_t res = 0;
+        // An empty datagram goes out on its own: as the tail of a GSO
+        //  batch it would add no bytes, so the kernel wouldn't send it
+        if (!_hasRoom() || (payload.empty() && _segments > 0)) {
+            res = flush();
+        }
+        _buffer.write(payload.data(), payload.size());
+        ++_segments;
+        if (payload.size() < _segmentSize) {
+            // Nothing can follow a short segment in the same batch
+            ssize_t flushed = flush();
+            res = (res < 0 || flushed < 0) ? -1 : res + flushed;
+        }
+        return res;
+    }
+
+    /**
+     * Send everything queued.  Returns the number of datagrams sent,
+     * or -1 with errno set.  On failure the queued datagrams are dropped.
+     */
+    ssize_t flush() {
+        if (_segments == 0) {
+            return 0;
+        }
+        ssize_t res = _gsoAvailable ? _sendGso() : _sendMmsg();
+        _buffer.clear();
+        _segments = 0;
+        return res;
+    }
+
+    /**
+     * Whether GSO is still in use (false once the writer has
+     * fallen back to sendmmsg)
+     */
+    bool gsoAvailable() const {
+        return _gsoAvailable;
+    }
+
+    /**
+     * Stop using GSO, e.g. when it's known to be unsupported
+     */
+    void disableGso() {
+        _gsoAvailable = false;
+    }
+
+    std::size_t pendingSegments() const {
+        return _segments;
+    }
+
+protected:
+    int _fd;
+    sockaddr_storage _dest;
+    socklen_t _destLen;
+    uint16_t _segmentSize;
+    bool _gsoAvailable = true;
+    // GSO sends rejected in a row
+    std::size_t _gsoFailures = 0;
+    std::size_t _segments = 0;
+    NetworkBuffer<BUF_SIZE> _buffer;
+
+    bool _hasRoom() const {
+        return _segments < maxSegments &&
+            _buffer.remainingCapacity() >= _segmentSize &&
+            _buffer.size() + _segmentSize <= maxGsoBytes;
+    }
+
+    ssize_t _sendGso() {
+        iovec iov{_buffer.getBuffer(), _buffer.size()};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+        msghdr msg{};
+        msg.msg_name = &_dest;
+        msg.msg_namelen = _destLen;
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        if (_segments > 1) {
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            memcpy(CMSG_DATA(cmsg), &_segmentSize, sizeof(uint16_t));
+        }
+        if (sendmsg(_fd, &msg, 0) >= 0) {
+            _gsoFailures = 0;
+            return _segments;
+        }
+        if (errno == ENOPROTOOPT || errno == EOPNOTSUPP) {
+            // No GSO support in the kernel
+            _gsoAvailable = false;
+            return _sendMmsg();
+        }
+        if (errno == EIO || errno == EINVAL) {
+            // The egress device can't segment, or this batch was bad:
+            //  send it without GSO, and give up on GSO if it keeps
+            //  happening
+            if (++_gsoFailures >= gsoRetries) {
+                _gsoAvailable = false;
+            }
+            return _sendMmsg();
+        }
+        return -1;
+    }
+
+    ssize_t _sendMmsg() {
+        iovec iovs[maxSegments];
+        mmsghdr msgs[maxSegments] = {};
+        uint8_t* data = _buffer.getBuffer();
+        std::size_t remaining = _buffer.size();
+        for (std::size_t i = 0; i < _segments; ++i) {
+            std::size_t len = remaining < _segmentSize ? remaining : _segmentSize;
+            iovs[i] = {data, len};
+            msgs[i].msg_hdr.msg_name = &_dest;
+            msgs[i].msg_hdr.msg_namelen = _destLen;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            data += len;
+            remaining -= len;
+        }
+        std::size_t sent = 0;
+        while (sent < _segments) {
+            int res = sendmmsg(_fd, msgs + sent, _segments - sent, 0);
+            if (res < 0) {
+                return sent ? static_cast<ssize_t>(sent) : -1;
+            }
+            sent += res;
+        }
+        return sent;
+    }
+};
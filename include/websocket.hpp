@@ -0,0 +1,233 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "byte_order.hpp"
+#include "stream_framer.hpp"
+
+/**
+ * RFC 6455 WebSocket framing
+ */
+
+enum class WebSocketOpcode : uint8_t {
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xA,
+};
+
+struct WebSocketFrameHeader {
+    bool fin = true;
+    uint8_t rsv = 0;
+    WebSocketOpcode opcode = WebSocketOpcode::Binary;
+    bool masked = false;
+    uint64_t payloadLength = 0;
+    std::array<uint8_t, 4> maskingKey = {};
+
+    /**
+     * The encoded size of this header: 2, 4 or 10 bytes plus
+     * 4 for the masking key
+     */
+    std::size_t size() const {
+        return 2 + extendedLengthSize(payloadLength) + (masked ? 4 : 0);
+    }
+
+    static std::size_t extendedLengthSize(uint64_t payloadLength) {
+        return payloadLength < 126 ? 0 : payloadLength <= 0xFFFF ? 2 : 8;
+    }
+};
+
+class WebSocketCodec {
+public:
+    static constexpr std::size_t maxHeaderSize = 14;
+
+    /**
+     * The size of the header starting at data, or nullopt if
+     * not enough of it is there to tell
+     */
+    static std::optional<std::size_t> headerSize(std::span<const uint8_t> data) {
+        if (data.size() < 2) {
+            return std::nullopt;
+        }
+        uint8_t len7 = data[1] & 0x7F;
+        return 2 + (len7 == 126 ? 2 : len7 == 127 ? 8 : 0) + ((data[1] & 0x80) ? 4 : 0);
+    }
+
+    /**
+     * The payload length of the header starting at data, which
+     * must hold at least headerSize(data) bytes
+     */
+    static uint64_t payloadLength(std::span<const uint8_t> data) {
+        uint8_t len7 = data[1] & 0x7F;
+        if (len7 == 126) {
+            return loadNetwork<uint16_t>(data.data() + 2);
+        } else if (len7 == 127) {
+            return loadNetwork<uint64_t>(data.data() + 2);
+        }
+        return len7;
+    }
+
+    /**
+     * Read a frame header from the buffer.  If the whole header
+     * hasn't arrived yet nothing is consumed and nullopt is returned.
+     */
+    template<typename Buffer>
+    static std::optional<WebSocketFrameHeader> readHeader(Buffer& buffer) {
+        auto len = headerSize({buffer.getBuffer(), buffer.size()});
+        if (!len || buffer.size() < *len) {
+            return std::nullopt;
+        }
+        WebSocketFrameHeader header;
+        uint16_t first = buffer.read16();
+        header.fin = first & 0x8000;
+        header.rsv = (first >> 12) & 0x7;
+        header.opcode = static_cast<WebSocketOpcode>((first >> 8) & 0xF);
+        header.masked = first & 0x0080;
+        uint8_t len7 = first & 0x7F;
+        if (len7 == 126) {
+            header.payloadLength = buffer.read16();
+        } else if (len7 == 127) {
+            header.payloadLength = buffer.read64();
+        } else {
+            header.payloadLength = len7;
+        }
+        if (header.masked) {
+            memcpy(header.maskingKey.data(), buffer.read(4), 4);
+        }
+        return header;
+    }
+
+    template<typename Buffer>
+    static void writeHeader(Buffer& buffer, const WebSocketFrameHeader& header) {
+        uint16_t first = (header.fin ? 0x8000 : 0) | ((header.rsv & 0x7) << 12) |
+            (static_cast<uint8_t>(header.opcode) << 8) | (header.masked ? 0x0080 : 0);
+        switch (WebSocketFrameHeader::extendedLengthSize(header.payloadLength)) {
+        case 0:
+            buffer.write(static_cast<uint16_t>(first | header.payloadLength));
+            break;
+        case 2:
+            buffer.write(static_cast<uint16_t>(first | 126));
+            buffer.write(static_cast<uint16_t>(header.payloadLength));
+            break;
+        default:
+            buffer.write(static_cast<uint16_t>(first | 127));
+            buffer.write(static_cast<uint64_t>(header.payloadLength));
+            break;
+        }
+        if (header.masked) {
+            buffer.write(header.maskingKey.data(), 4);
+        }
+    }
+
+    /**
+     * Read a complete frame, unmasking its payload in place.
+     * Returns nullopt without consuming anything if the whole
+     * frame hasn't arrived yet.
+     */
+    template<typename Buffer>
+    static std::optional<std::span<uint8_t>> readFrame(Buffer& buffer, WebSocketFrameHeader& header) {
+        std::span<const uint8_t> data{buffer.getBuffer(), buffer.size()};
+        auto len = headerSize(data);
+        if (!len || data.size() < *len || data.size() - *len < payloadLength(data)) {
+            return std::nullopt;
+        }
+        header = *readHeader(buffer);
+        std::span<uint8_t> payload{buffer.read(header.payloadLength), header.payloadLength};
+        if (header.masked) {
+            mask(payload, header.maskingKey);
+        }
+        return payload;
+    }
+
+    /**
+     * Write a complete frame.  If the header is masked, the payload
+     * is masked as it is written.
+     */
+    template<typename Buffer>
+    static void writeFrame(Buffer& buffer, WebSocketFrameHeader header, std::span<const uint8_t> payload) {
+        header.payloadLength = payload.size();
+        writeHeader(buffer, header);
+        uint8_t* dst = buffer.getWriteBuffer();
+        buffer.write(payload.data(), payload.size());
+        if (header.masked) {
+            mask({dst, payload.size()}, header.maskingKey);
+        }
+    }
+
+    /**
+     * XOR data with the masking key (masking and unmasking are the
+     * same operation).  keyOffset is the position within the payload
+     * that data starts at, for payloads processed in pieces.
+     * Returns the key offset for the following piece.
+     */
+    static std::size_t mask(std::span<uint8_t> data, std::array<uint8_t, 4> key, std::size_t keyOffset = 0) {
+        uint8_t rotated[4];
+        for (std::size_t i = 0; i < 4; ++i) {
+            rotated[i] = key[(keyOffset + i) & 3];
+        }
+        uint32_t key32;
+        memcpy(&key32, rotated, 4);
+
+        uint8_t* pos = data.data();
+        uint8_t* end = pos + data.size();
+#if defined(__AVX2__)
+        const __m256i key256 = _mm256_set1_epi32(static_cast<int>(key32));
+        for (; end - pos >= 32; pos += 32) {
+            __m256i* chunk = reinterpret_cast<__m256i*>(pos);
+            _mm256_storeu_si256(chunk, _mm256_xor_si256(_mm256_loadu_si256(chunk), key256));
+        }
+#endif
+#if defined(__SSE2__)
+        const __m128i key128 = _mm_set1_epi32(static_cast<int>(key32));
+        for (; end - pos >= 16; pos += 16) {
+            __m128i* chunk = reinterpret_cast<__m128i*>(pos);
+            _mm_storeu_si128(chunk, _mm_xor_si128(_mm_loadu_si128(chunk), key128));
+        }
+#endif
+        // Every loop above advances by a multiple of 4, so the key is still in phase
+        const uint64_t key64 = (static_cast<uint64_t>(key32) << 32) | key32;
+        for (; end - pos >= 8; pos += 8) {
+            uint64_t chunk;
+            memcpy(&chunk, pos, 8);
+            chunk ^= key64;
+            memcpy(pos, &chunk, 8);
+        }
+        for (std::size_t i = 0; pos < end; ++pos, ++i) {
+            *pos ^= rotated[i & 3];
+        }
+        return (keyOffset + data.size()) & 3;
+    }
+};
+
+/**
+ * Frame decoder for StreamFramer.  Frames are returned still
+ * masked: unmask them with WebSocketCodec::mask using the
+ * key in the 4 bytes before the payload.
+ */
+struct WebSocketDecoder {
+    std::optional<FrameBounds> decode(std::span<const uint8_t> data) {
+        auto len = WebSocketCodec::headerSize(data);
+        if (!len || data.size() < *len) {
+            return std::nullopt;
+        }
+        uint64_t payloadLength = WebSocketCodec::payloadLength(data);
+        if (payloadLength > std::numeric_limits<std::size_t>::max() - *len) {
+            // Report as an oversized frame so the framer flags an error
+            return FrameBounds{*len, 0, std::numeric_limits<std::size_t>::max()};
+        }
+        return FrameBounds{*len, static_cast<std::size_t>(payloadLength),
+                           *len + static_cast<std::size_t>(payloadLength)};
+    }
+};
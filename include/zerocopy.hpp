@@ -0,0 +1,335 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "buffer_pool.hpp"
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+/**
+ * Sends pooled buffers with MSG_ZEROCOPY (Linux 4.14+), so the kernel
+ * transmits straight from the buffer's pages instead of copying them.
+ * The buffer must then stay untouched until the kernel says it's done
+ * with it, so the writer holds each buffer's handle until every send
+ * of it has been completed, and only then lets it go back to its pool.
+ *
+ * The kernel numbers each successful MSG_ZEROCOPY send on a socket
+ * (0, 1, 2, ...) and reports finished sends on the socket's error
+ * queue as ranges of those numbers.  Each queued buffer remembers the
+ * range of numbers its sends used:
+ *
+ *   ZeroCopyWriter<NetworkBuffer<65536>>::enable(fd);
+ *   ZeroCopyWriter<NetworkBuffer<65536>> writer(fd);
+ *   writer.send(std::move(*buffer));
+ *   ...
+ *   writer.reap();   // e.g. when poll reports POLLERR
+ *
+ * enable must be called on the socket before the writer is made:
+ * without SO_ZEROCOPY the kernel copies every send and never reports a
+ * completion, so the writer checks for it once, up front, and
+ * otherwise sends normally and lets each buffer go as soon as it's
+ * been sent (zeroCopyEnabled() tells which it's doing).
+ *
+ * Destroying the writer waits (see drain) for the kernel to finish
+ * with every buffer it was given before letting them go back to their
+ * pools.
+ *
+ * Zero copy only pays off for large sends (around 10KB and up), and
+ * over loopback the kernel copies anyway: copiedCompletions() tells
+ * how many sends it ended up copying.
+ */
+template<typename Buffer, std::size_t MaxInFlight = 256>
+class ZeroCopyWriter {
+public:
+    using Handle = typename BufferPool<Buffer>::Handle;
+
+    // Completion notifications read per recvmmsg
+    static constexpr std::size_t reapBatch = 16;
+    // How long the destructor waits for outstanding completions
+    static constexpr int drainTimeoutMs = 1000;
+
+    /**
+     * Turn on SO_ZEROCOPY for the socket.  Without it, MSG_ZEROCOPY
+     * is silently ignored.  Returns false if it isn't supported.
+     */
+    static bool enable(int fd) {
+        int on = 1;
+        return setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0;
+    }
+
+    explicit ZeroCopyWriter(int fd, int flags = 0) :
+        _fd(fd), _flags(flags) {
+        int on = 0;
+        socklen_t len = sizeof(on);
+        _zeroCopy = getsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &on, &len) == 0 && on;
+    }
+
+    /**
+     * Drains (see drain) for up to drainTimeoutMs.  Buffers the kernel
+     * still hasn't finished with after that (e.g. because the socket
+     * was closed, or the peer stopped reading) are never returned to
+     * their pool: they're leaked rather than handed to someone who
+     * could overwrite data still being sent.  Call drain first to wait
+     * longer, or to find out whether anything would be leaked.
+     */
+    ~ZeroCopyWriter() {
+        drain(drainTimeoutMs);
+        for (std::size_t i = 0; i < _count; ++i) {
+            _entries[(_head + i) % MaxInFlight].buffer.release();
+        }
+    }
+
+    ZeroCopyWriter(const ZeroCopyWriter&) = delete;
+    ZeroCopyWriter& operator=(const ZeroCopyWriter&) = delete;
+
+    /**
+     * Queue the unread bytes of a buffer and send as much of the queue
+     * as the socket will take.  Returns the number of bytes sent, or -1
+     * with errno set (EAGAIN or ENOBUFS just mean "try again later": the
+     * unsent bytes stay queued for flush).  If there are MaxInFlight
+     * buffers in flight even after reaping, the handle is left with the
+     * caller and -1 is returned with errno set to ENOBUFS.
+     */
+    ssize_t send(Handle&& buffer) {
+        if (_count == MaxInFlight) {
+            reap();
+            if (_count == MaxInFlight) {
+                errno = ENOBUFS;
+                return -1;
+            }
+        }
+        _entries[(_head + _count) % MaxInFlight] = Entry{std::move(buffer), _nextId, _nextId, 0};
+        ++_count;
+        return flush();
+    }
+
+    /**
+     * Send any queued bytes not yet taken by the socket.  Returns as
+     * for send.
+     */
+    ssize_t flush() {
+        std::size_t sent = 0;
+        for (; _unsent < _count; ++_unsent) {
+            Entry& entry = _entries[(_head + _unsent) % MaxInFlight];
+            while (!entry.buffer->empty()) {
+                ssize_t res = ::send(_fd, entry.buffer->getBuffer(), entry.buffer->size(),
+                    (_zeroCopy ? MSG_ZEROCOPY : 0) | _flags);
+                if (res < 0) {
+                    return sent ? static_cast<ssize_t>(sent) : -1;
+                }
+                // Every successful zero copy send takes the next number,
+                //  even a partial one.  Copied sends take none, so the
+                //  entry is done with once it's all sent.
+                entry.buffer->read(res);
+                if (_zeroCopy) {
+                    entry.end = ++_nextId;
+                }
+                sent += res;
+            }
+        }
+        _releaseCompleted();
+        return sent;
+    }
+
+    /**
+     * Read whatever completion notifications are on the error queue,
+     * without blocking, and release the buffers they finish.  Returns
+     * the number of sends completed.
+     */
+    std::size_t reap() {
+        std::size_t completed = 0;
+        while (true) {
+            mmsghdr msgs[reapBatch] = {};
+            alignas(cmsghdr) char control[reapBatch][CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in6))];
+            for (std::size_t i = 0; i < reapBatch; ++i) {
+                msgs[i].msg_hdr.msg_control = control[i];
+                msgs[i].msg_hdr.msg_controllen = sizeof(control[i]);
+            }
+            int res = recvmmsg(_fd, msgs, reapBatch, MSG_ERRQUEUE | MSG_DONTWAIT, nullptr);
+            if (res <= 0) {
+                break;
+            }
+            for (int i = 0; i < res; ++i) {
+                completed += _handleNotification(msgs[i].msg_hdr);
+            }
+            if (static_cast<std::size_t>(res) < reapBatch) {
+                break;
+            }
+        }
+        _releaseCompleted();
+        return completed;
+    }
+
+    /**
+     * Give up on sending whatever the socket hasn't taken yet (buffers
+     * the kernel never saw are released straight away), then wait up
+     * to timeoutMs for the completions of everything it did take,
+     * polling for POLLERR.  Returns whether nothing is left in flight.
+     */
+    bool drain(int timeoutMs) {
+        // The unsent entries, but for a partially sent one, were never
+        //  seen by the kernel
+        while (_count > _unsent && _entries[(_head + _count - 1) % MaxInFlight].end ==
+                                   _entries[(_head + _count - 1) % MaxInFlight].first) {
+            _entries[(_head + _count - 1) % MaxInFlight].buffer.reset();
+            --_count;
+        }
+        // A partially sent one is finished with once what was sent
+        //  of it completes
+        _unsent = _count;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        reap();
+        while (_count > 0) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0) {
+                break;
+            }
+            // POLLERR is always reported, whatever the events asked for
+            pollfd pfd{_fd, 0, 0};
+            int res = poll(&pfd, 1, static_cast<int>(remaining));
+            if (res < 0 && errno != EINTR) {
+                break;
+            }
+            if (pfd.revents & POLLNVAL) {
+                break;
+            }
+            reap();
+        }
+        return _count == 0;
+    }
+
+    /**
+     * The number of buffers queued or waiting for completion
+     */
+    std::size_t inFlight() const {
+        return _count;
+    }
+
+    /**
+     * Whether SO_ZEROCOPY was on when the writer was made, i.e. whether
+     * sends wait for the kernel's completions
+     */
+    bool zeroCopyEnabled() const {
+        return _zeroCopy;
+    }
+
+    /**
+     * The number of completed sends the kernel copied rather than
+     * sending in place
+     */
+    std::size_t copiedCompletions() const {
+        return _copied;
+    }
+
+    std::size_t completions() const {
+        return _completions;
+    }
+
+protected:
+    struct Entry {
+        Handle buffer;
+        // The numbers of this buffer's sends: [first, end)
+        uint32_t first;
+        uint32_t end;
+        uint32_t completed;
+    };
+
+    int _fd;
+    int _flags;
+    bool _zeroCopy;
+    std::array<Entry, MaxInFlight> _entries;
+    // The oldest entry, the number of entries and the first entry
+    //  with bytes not yet sent, relative to _head
+    std::size_t _head = 0;
+    std::size_t _count = 0;
+    std::size_t _unsent = 0;
+    uint32_t _nextId = 0;
+    std::size_t _completions = 0;
+    std::size_t _copied = 0;
+
+    std::size_t _handleNotification(msghdr& msg) {
+        std::size_t completed = 0;
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            bool isRecvErr = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+            if (!isRecvErr) {
+                continue;
+            }
+            sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+            if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            // An inclusive range of send numbers
+            uint32_t lo = err.ee_info;
+            uint32_t hi = err.ee_data;
+            std::size_t count = hi - lo + 1;
+            _complete(lo, hi + 1);
+            if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                _copied += count;
+            }
+            _completions += count;
+            completed += count;
+        }
+        return completed;
+    }
+
+    /**
+     * Credit the sends [lo, end) to the entries that made them.  Ranges
+     * usually arrive in order but aren't guaranteed to.
+     */
+    void _complete(uint32_t lo, uint32_t end) {
+        if (_count == 0) {
+            return;
+        }
+        // Compare relative to the oldest entry so that wrapping
+        //  numbers still order correctly
+        uint32_t base = _entries[_head].first;
+        int64_t from = static_cast<int32_t>(lo - base);
+        int64_t to = static_cast<int32_t>(end - base);
+        for (std::size_t i = 0; i < _count; ++i) {
+            Entry& entry = _entries[(_head + i) % MaxInFlight];
+            int64_t first = static_cast<int32_t>(entry.first - base);
+            int64_t last = static_cast<int32_t>(entry.end - base);
+            if (first >= to) {
+                break;
+            }
+            int64_t overlap = std::min(last, to) - std::max(first, from);
+            if (overlap > 0) {
+                entry.completed += overlap;
+            }
+        }
+    }
+
+    void _releaseCompleted() {
+        while (_count > 0 && _unsent > 0) {
+            Entry& entry = _entries[_head];
+            if (entry.completed != entry.end - entry.first) {
+                break;
+            }
+            entry.buffer.reset();
+            _head = (_head + 1) % MaxInFlight;
+            --_count;
+            --_unsent;
+        }
+    }
+};
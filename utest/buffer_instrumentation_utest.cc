@@ -0,0 +1,95 @@
+#include "catch.hpp"
+
+#include "buffer_instrumentation.hpp"
+#include "network_buffer.hpp"
+#include "tlv.hpp"
+
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+using namespace std;
+
+TEST_CASE("NetworkBuffer instrumentation") {
+    SECTION("the default adds nothing to the buffer") {
+        REQUIRE(sizeof(NetworkBuffer<1500, CountingInstrumentation<>>) == sizeof(NetworkBuffer<1500>));
+        REQUIRE(is_trivially_copyable_v<NetworkBuffer<1500, CountingInstrumentation<>>>);
+    }
+    SECTION("counters") {
+        using Counting = CountingInstrumentation<25>;
+        Counting::counters() = {};
+        NetworkBuffer<16, Counting> buffer;
+        buffer.write(static_cast<uint32_t>(1));
+        buffer.write(static_cast<uint16_t>(2));
+        uint8_t bytes[6] = {};
+        buffer.write(bytes, sizeof(bytes));
+        buffer.read32();
+        buffer.read(3);
+        // 12 of 16 used: not low yet
+        REQUIRE(Counting::counters().lowCapacity == 0);
+        buffer.setSize(2);
+        buffer.write(static_cast<uint8_t>(3));
+
+        auto& counters = Counting::counters();
+        REQUIRE(counters.writes == 4);
+        REQUIRE(counters.bytesWritten == 13);
+        REQUIRE(counters.reads == 2);
+        REQUIRE(counters.bytesRead == 7);
+        REQUIRE(counters.setSizes == 1);
+        REQUIRE(counters.bytesSet == 2);
+        // 14 and 15 of 16 leave less than a quarter
+        REQUIRE(counters.lowCapacity == 2);
+    }
+    SECTION("counters are per thread") {
+        using Counting = CountingInstrumentation<>;
+        Counting::counters() = {};
+        NetworkBuffer<64, Counting> buffer;
+        buffer.write(static_cast<uint8_t>(1));
+        uint64_t otherWrites = 0;
+        std::thread([&] {
+            NetworkBuffer<64, Counting> other;
+            other.write(static_cast<uint32_t>(1));
+            other.write(static_cast<uint32_t>(2));
+            otherWrites = Counting::counters().writes;
+        }).join();
+        REQUIRE(otherWrites == 2);
+        REQUIRE(Counting::counters().writes == 1);
+    }
+    SECTION("histograms") {
+        HistogramInstrumentation::histograms() = {};
+        NetworkBuffer<100, HistogramInstrumentation> buffer;
+        uint8_t bytes[60] = {};
+        buffer.write(bytes, 60);
+        buffer.write(static_cast<uint32_t>(1));
+        buffer.setSize(36);
+        buffer.read(64);
+        buffer.read8();
+
+        auto& histograms = HistogramInstrumentation::histograms();
+        // 60 and 36 are in [32, 64)
+        REQUIRE(histograms.writeSizes[6] == 2);
+        REQUIRE(histograms.writeSizes[3] == 1);
+        REQUIRE(histograms.fill[6] == 2);
+        REQUIRE(histograms.fill[10] == 1);
+        REQUIRE(histograms.readSizes[7] == 1);
+        REQUIRE(histograms.readSizes[1] == 1);
+    }
+    SECTION("USDT probes don't change behaviour") {
+        NetworkBuffer<64, UsdtInstrumentation> buffer;
+        buffer.write(static_cast<uint32_t>(0x01020304));
+        REQUIRE(buffer.read32() == 0x01020304);
+    }
+    SECTION("generic code takes instrumented buffers") {
+        using Counting = CountingInstrumentation<>;
+        Counting::counters() = {};
+        NetworkBuffer<64, Counting> buffer;
+        const uint8_t value[] = { 'a', 'b', 'c' };
+        TlvWriter<StunAttributeFormat>::write(buffer, 0x8022, value);
+        REQUIRE(buffer.size() == 8);
+        REQUIRE(Counting::counters().bytesWritten == 8);
+        TlvReader<StunAttributeFormat> reader(buffer);
+        auto attribute = reader.next();
+        REQUIRE(attribute);
+        REQUIRE(attribute->type == 0x8022);
+    }
+}
@@ -0,0 +1,152 @@
+#include "catch.hpp"
+
+#include "buffer_pool.hpp"
+#include "network_buffer.hpp"
+
+#include <atomic>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+TEST_CASE("BufferPool") {
+    BufferPool<NetworkBuffer<64>> pool(4);
+    REQUIRE(pool.capacity() == 4);
+    REQUIRE(pool.available() == 4);
+
+    SECTION("acquire until exhausted") {
+        vector<BufferPool<NetworkBuffer<64>>::Handle> handles;
+        while (auto handle = pool.acquire()) {
+            handles.push_back(std::move(*handle));
+        }
+        REQUIRE(handles.size() == 4);
+        REQUIRE(pool.available() == 0);
+        REQUIRE(handles[0].index() == 0);
+        REQUIRE(handles[3].index() == 3);
+        handles.pop_back();
+        REQUIRE(pool.available() == 1);
+        REQUIRE(pool.acquire());
+    }
+    SECTION("buffers come back empty") {
+        uint32_t index;
+        {
+            auto handle = pool.acquire();
+            index = handle->index();
+            (*handle)->write(static_cast<uint32_t>(42));
+            (*handle)->read8();
+        }
+        REQUIRE(pool.available() == 4);
+        auto handle = pool.acquire();
+        REQUIRE(handle->index() == index);
+        REQUIRE((*handle)->empty());
+        REQUIRE((*handle)->remainingCapacity() == 64);
+    }
+    SECTION("moving a handle transfers ownership") {
+        auto first = pool.acquire();
+        auto second = pool.acquire();
+        *first = std::move(*second);
+        REQUIRE_FALSE(*second);
+        REQUIRE(pool.available() == 3);
+        first->reset();
+        REQUIRE_FALSE(*first);
+        REQUIRE(pool.available() == 4);
+    }
+    SECTION("holding a buffer by index") {
+        auto handle = pool.acquire();
+        (*handle)->write(static_cast<uint8_t>(7));
+        uint32_t index = handle->release();
+        REQUIRE_FALSE(*handle);
+        handle.reset();
+        REQUIRE(pool.available() == 3);
+        REQUIRE(pool.buffer(index).read8() == 7);
+        pool.release(index);
+        REQUIRE(pool.available() == 4);
+        REQUIRE(pool.buffer(index).empty());
+    }
+}
+
+TEST_CASE("BufferPool stats") {
+    BufferPool<NetworkBuffer<64>> pool(2, {.timeEvery = 1, .recordSites = true});
+    auto stats = pool.stats();
+    REQUIRE(stats.capacity == 2);
+    REQUIRE(stats.inUse == 0);
+    REQUIRE(stats.free() == 2);
+
+    SECTION("counts acquires, failures and the peak") {
+        {
+            auto first = pool.acquire();
+            auto second = pool.acquire();
+            REQUIRE_FALSE(pool.acquire());
+            stats = pool.stats();
+            REQUIRE(stats.inUse == 2);
+            REQUIRE(stats.free() == 0);
+        }
+        auto third = pool.acquire();
+        stats = pool.stats();
+        REQUIRE(stats.acquires == 3);
+        REQUIRE(stats.failures == 1);
+        REQUIRE(stats.inUse == 1);
+        REQUIRE(stats.peakInUse == 2);
+    }
+    SECTION("records how long buffers are held") {
+        pool.acquire();
+        pool.acquire()->reset();
+        stats = pool.stats();
+        uint64_t released = 0;
+        for (uint64_t count : stats.heldTicks) {
+            released += count;
+        }
+        REQUIRE(released == 2);
+        REQUIRE(stats.ticksPerNs > 0);
+        REQUIRE(stats.heldNs(10) > stats.heldNs(9));
+    }
+    SECTION("lists the buffers held") {
+        auto held = pool.acquire();
+        uint32_t line = __LINE__ - 1;
+        vector<uint32_t> indices;
+        pool.forEachHeld([&](uint32_t index, const std::source_location& site, uint64_t) {
+            indices.push_back(index);
+            REQUIRE(site.line() == line);
+            REQUIRE(std::string_view(site.file_name()).ends_with("buffer_pool_utest.cc"));
+        });
+        REQUIRE(indices == vector<uint32_t>{ held->index() });
+    }
+    SECTION("samples held times and skips sites by default") {
+        BufferPool<NetworkBuffer<64>> sampled(1);
+        for (uint64_t i = 0; i < 2 * BufferPoolTelemetry().timeEvery; ++i) {
+            sampled.acquire();
+        }
+        uint64_t released = 0;
+        for (uint64_t count : sampled.stats().heldTicks) {
+            released += count;
+        }
+        REQUIRE(released == 2);
+
+        auto held = sampled.acquire();
+        sampled.forEachHeld([&](uint32_t, const std::source_location& site, uint64_t) {
+            REQUIRE(site.line() == 0);
+        });
+    }
+    SECTION("can be read from another thread") {
+        std::atomic<bool> done = false;
+        // Catch's assertions aren't thread safe: check once joined
+        bool consistent = true;
+        std::thread reader([&] {
+            uint64_t last = 0;
+            while (!done) {
+                auto stats = pool.stats();
+                consistent &= stats.acquires >= last && stats.inUse <= 2;
+                last = stats.acquires;
+            }
+        });
+        for (int i = 0; i < 100000; ++i) {
+            pool.acquire();
+        }
+        done = true;
+        reader.join();
+        REQUIRE(consistent);
+        REQUIRE(pool.stats().acquires == 100000);
+    }
+}
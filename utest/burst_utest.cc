@@ -0,0 +1,67 @@
+#include "catch.hpp"
+
+#include "buffer_pool.hpp"
+#include "burst.hpp"
+#include "network_buffer.hpp"
+#include "rtp.hpp"
+
+#include <array>
+#include <vector>
+
+using namespace std;
+
+TEST_CASE("forEachPrefetched") {
+    array<NetworkBuffer<64>, 8> buffers;
+    for (uint32_t i = 0; i < buffers.size(); ++i) {
+        buffers[i].write(i);
+    }
+    auto readAll = [](auto burst, size_t distance) {
+        vector<uint32_t> seen;
+        forEachPrefetched(burst, [&](auto& buffer) {
+            seen.push_back(buffer.read32());
+        }, distance);
+        return seen;
+    };
+    const vector<uint32_t> inOrder = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+    SECTION("buffers") {
+        REQUIRE(readAll(span(buffers), 4) == inOrder);
+    }
+    SECTION("pointers") {
+        array<NetworkBuffer<64>*, 8> pointers;
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            pointers[i] = &buffers[i];
+        }
+        REQUIRE(readAll(span(pointers), 2) == inOrder);
+    }
+    SECTION("no prefetching") {
+        REQUIRE(readAll(span(buffers), 0) == inOrder);
+    }
+    SECTION("distance longer than the burst") {
+        REQUIRE(readAll(span(buffers), 100) == inOrder);
+    }
+    SECTION("part of a burst") {
+        REQUIRE(readAll(span(buffers).subspan(6), 4) == vector<uint32_t>{ 6, 7 });
+        REQUIRE(readAll(span(buffers).first(0), 4).empty());
+    }
+    SECTION("pool handles, with a parser") {
+        BufferPool<NetworkBuffer<1500>> pool(4);
+        vector<BufferPool<NetworkBuffer<1500>>::Handle> burst;
+        for (uint16_t seq = 0; seq < 4; ++seq) {
+            auto handle = pool.acquire();
+            (*handle)->write(static_cast<uint8_t>(0x80));
+            (*handle)->write(static_cast<uint8_t>(96));
+            (*handle)->write(seq);
+            (*handle)->write(static_cast<uint32_t>(0));
+            (*handle)->write(static_cast<uint32_t>(1234));
+            burst.push_back(std::move(*handle));
+        }
+        vector<uint16_t> seqs;
+        forEachPrefetched(span(burst), [&](auto& buffer) {
+            auto rtp = RtpPacket::parse(buffer);
+            REQUIRE(rtp);
+            seqs.push_back(rtp->sequenceNumber());
+        });
+        REQUIRE(seqs == vector<uint16_t>{ 0, 1, 2, 3 });
+    }
+}
@@ -0,0 +1,106 @@
+#include "catch.hpp"
+
+#include "dns.hpp"
+#include "network_buffer.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+    string dotted(const DnsName& name) {
+        char out[256];
+        auto len = name.toDotted(out);
+        REQUIRE(len);
+        return string(out, *len);
+    }
+}
+
+TEST_CASE("DNS round trip with compression") {
+    NetworkBuffer<1500> buffer;
+    DnsWriter writer(buffer);
+    writer.writeHeader({0x1234, 0x8180, 1, 3, 0, 0});
+    writer.writeQuestion("www.example.com", 1);
+    uint8_t addr[4] = { 93, 184, 216, 34 };
+    writer.writeNameRecord("www.example.com", 5, 1, 300, "cdn.example.com.");
+    writer.writeRecord("cdn.example.com", 1, 1, 60, addr);
+    writer.writeRecord("mail.example.org", 1, 1, 60, addr);
+
+    // www.example.com is written once, later names point back into it
+    size_t uncompressed = 12 + (17 + 4) + (17 + 10 + 17) + (17 + 10 + 4) + (18 + 10 + 4);
+    REQUIRE(writer.size() == buffer.size());
+    REQUIRE(buffer.size() < uncompressed);
+
+    DnsReader reader(buffer);
+    auto header = reader.header();
+    REQUIRE(header->id == 0x1234);
+    REQUIRE(header->flags == 0x8180);
+    REQUIRE(header->questionCount == 1);
+    REQUIRE(header->answerCount == 3);
+
+    auto question = reader.question();
+    REQUIRE(question);
+    REQUIRE(question->name.equals("www.example.com"));
+    REQUIRE(question->name.equals("WWW.Example.COM."));
+    REQUIRE(!question->name.equals("www.example.co"));
+    REQUIRE(!question->name.equals("www.example.com.au"));
+    REQUIRE(!question->name.equals("ww.example.com"));
+    REQUIRE(question->type == 1);
+    REQUIRE(question->qclass == 1);
+
+    auto cname = reader.record();
+    REQUIRE(cname);
+    REQUIRE(cname->name.equals(question->name));
+    REQUIRE(cname->type == 5);
+    REQUIRE(cname->ttl == 300);
+    // www and example.com are both compressed away: just "cdn" and a pointer
+    REQUIRE(cname->data.size() == 4 + 2);
+    REQUIRE(dotted(reader.nameAt(cname->dataOffset)) == "cdn.example.com");
+
+    auto a = reader.record();
+    REQUIRE(a);
+    REQUIRE(dotted(a->name) == "cdn.example.com");
+    REQUIRE(a->data.size() == 4);
+    REQUIRE(a->data[0] == 93);
+
+    auto other = reader.record();
+    REQUIRE(other);
+    REQUIRE(dotted(other->name) == "mail.example.org");
+    REQUIRE(!other->name.equals(a->name));
+    REQUIRE(!reader.record());
+}
+
+TEST_CASE("DNS malformed names") {
+    SECTION("pointer loop") {
+        vector<uint8_t> message(12, 0);
+        // A name pointing at itself
+        message.insert(message.end(), {0xC0, 12, 0, 1, 0, 1});
+        DnsReader reader(message);
+        reader.header();
+        REQUIRE(!reader.question());
+        REQUIRE(!DnsName(message, 12).equals("a"));
+    }
+
+    SECTION("two pointers pointing at each other") {
+        vector<uint8_t> message(12, 0);
+        message.insert(message.end(), {1, 'a', 0xC0, 16, 1, 'b', 0xC0, 12});
+        REQUIRE(!DnsName(message, 12).valid());
+    }
+
+    SECTION("runs off the end") {
+        vector<uint8_t> message(12, 0);
+        message.insert(message.end(), {3, 'w', 'w'});
+        REQUIRE(!DnsName(message, 12).valid());
+    }
+
+    SECTION("too long") {
+        vector<uint8_t> message(12, 0);
+        for (int i = 0; i < 5; ++i) {
+            message.push_back(63);
+            message.insert(message.end(), 63, 'a');
+        }
+        message.push_back(0);
+        REQUIRE(!DnsName(message, 12).valid());
+    }
+}
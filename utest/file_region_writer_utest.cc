@@ -0,0 +1,131 @@
+#include "catch.hpp"
+
+#include "file_region_writer.hpp"
+#include "network_buffer.hpp"
+#include "test_sockets.hpp"
+
+#include <netinet/tcp.h>
+#include <csignal>
+#include <cstdlib>
+#include <unistd.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+    int tempFile(const vector<uint8_t>& contents) {
+        char path[] = "/tmp/file_region_writer_XXXXXX";
+        int fd = mkstemp(path);
+        unlink(path);
+        ::write(fd, contents.data(), contents.size());
+        return fd;
+    }
+
+    vector<uint8_t> receive(int fd, size_t size) {
+        vector<uint8_t> data(size);
+        size_t received = 0;
+        while (received < size) {
+            ssize_t res = recv(fd, data.data() + received, size - received, 0);
+            if (res <= 0) {
+                break;
+            }
+            received += res;
+        }
+        data.resize(received);
+        return data;
+    }
+}
+
+TEST_CASE("FileRegionWriter") {
+    using Writer = FileRegionWriter<NetworkBuffer<64>>;
+    auto [sender, receiver] = tcpPair();
+    vector<uint8_t> contents(100000);
+    for (size_t i = 0; i < contents.size(); ++i) {
+        contents[i] = i * 7;
+    }
+    int file = tempFile(contents);
+
+    auto check = [&](Writer::Coalesce coalesce, Writer::Transfer transfer) {
+        Writer writer(sender, coalesce, transfer);
+        for (int message = 0; message < 2; ++message) {
+            NetworkBuffer<64> header;
+            header.write(static_cast<uint32_t>(0xCAFEF00D));
+            header.write(static_cast<uint16_t>(message));
+            off_t offset = 1000 + message * 50000;
+            writer.start(header, file, offset, 30000);
+            REQUIRE_FALSE(writer.done());
+            REQUIRE(writer.send() == 6 + 30000);
+            REQUIRE(writer.done());
+            REQUIRE(writer.remaining() == 0);
+            REQUIRE(header.empty());
+
+            auto received = receive(receiver, 6 + 30000);
+            REQUIRE(received.size() == 6 + 30000);
+            REQUIRE(vector<uint8_t>(received.begin(), received.begin() + 6) ==
+                    vector<uint8_t>{0xCA, 0xFE, 0xF0, 0x0D, 0x00, static_cast<uint8_t>(message)});
+            REQUIRE(equal(received.begin() + 6, received.end(), contents.begin() + offset));
+        }
+    };
+
+    SECTION("sendfile with MSG_MORE") {
+        check(Writer::Coalesce::MsgMore, Writer::Transfer::Sendfile);
+    }
+    SECTION("sendfile with TCP_CORK") {
+        check(Writer::Coalesce::Cork, Writer::Transfer::Sendfile);
+    }
+    SECTION("splice") {
+        check(Writer::Coalesce::MsgMore, Writer::Transfer::Splice);
+    }
+    SECTION("the file position isn't moved") {
+        check(Writer::Coalesce::MsgMore, Writer::Transfer::Sendfile);
+        REQUIRE(lseek(file, 0, SEEK_CUR) == static_cast<off_t>(contents.size()));
+    }
+    SECTION("a region past the end of the file fails") {
+        Writer writer(sender, Writer::Coalesce::Cork);
+        NetworkBuffer<64> header;
+        header.write(static_cast<uint8_t>(1));
+        REQUIRE(writer.start(header, file, contents.size() - 10, 20));
+        REQUIRE(writer.send() == 11);
+        REQUIRE_FALSE(writer.done());
+        REQUIRE(writer.remaining() == 10);
+        REQUIRE(writer.send() == -1);
+        REQUIRE(errno == EIO);
+        // The message is given up on, and the socket uncorked
+        REQUIRE(writer.done());
+        int cork = -1;
+        socklen_t len = sizeof(cork);
+        getsockopt(sender, IPPROTO_TCP, TCP_CORK, &cork, &len);
+        REQUIRE(cork == 0);
+        REQUIRE(receive(receiver, 11).size() == 11);
+
+        // and the next message goes out whole
+        check(Writer::Coalesce::Cork, Writer::Transfer::Sendfile);
+    }
+    SECTION("a failed splice drops what's in the pipe") {
+        Writer writer(sender, Writer::Coalesce::MsgMore, Writer::Transfer::Splice);
+        NetworkBuffer<64> header;
+        header.write(static_cast<uint8_t>(1));
+        REQUIRE(writer.start(header, file, 0, 1000));
+        REQUIRE(writer.send() == 1001);
+        REQUIRE(receive(receiver, 1001).size() == 1001);
+
+        // A file region the socket refuses after it's been piped
+        REQUIRE(writer.start(header, file, 0, 1000));
+        shutdown(sender, SHUT_WR);
+        auto previous = signal(SIGPIPE, SIG_IGN);
+        ssize_t res = writer.send();
+        int error = errno;
+        signal(SIGPIPE, previous);
+        REQUIRE(res == -1);
+        REQUIRE(error == EPIPE);
+        REQUIRE(writer.done());
+        REQUIRE(writer.remaining() == 0);
+    }
+
+    close(file);
+    close(sender);
+    close(receiver);
+}
@@ -0,0 +1,214 @@
+#include "catch.hpp"
+
+#include "fragment_reassembler.hpp"
+
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+namespace {
+    using Reassembler = FragmentReassembler<8, 4096, 4>;
+    using Clock = Reassembler::Clock;
+
+    vector<uint8_t> ipv4Fragment(uint16_t id, size_t offset, bool more, const vector<uint8_t>& payload) {
+        NetworkBuffer<2048> packet;
+        packet.write(static_cast<uint8_t>(0x45));
+        packet.write(static_cast<uint8_t>(0));
+        packet.write(static_cast<uint16_t>(20 + payload.size()));
+        packet.write(id);
+        packet.write(static_cast<uint16_t>((more ? 0x2000 : 0) | (offset / 8)));
+        packet.write(static_cast<uint8_t>(64));
+        packet.write(static_cast<uint8_t>(17));
+        packet.write(static_cast<uint16_t>(0));
+        packet.write(static_cast<uint32_t>(0x0A000001));
+        packet.write(static_cast<uint32_t>(0x0A000002));
+        packet.write(payload.data(), payload.size());
+        return vector<uint8_t>(packet.getBuffer(), packet.getBuffer() + packet.size());
+    }
+
+    vector<uint8_t> ipv6Fragment(uint32_t id, size_t offset, bool more, const vector<uint8_t>& payload) {
+        NetworkBuffer<2048> packet;
+        packet.write(static_cast<uint32_t>(0x60000000));
+        // Payload length, next header (destination options), hop limit
+        packet.write(static_cast<uint16_t>(8 + 8 + payload.size()));
+        packet.write(static_cast<uint8_t>(60));
+        packet.write(static_cast<uint8_t>(64));
+        for (int i = 0; i < 32; ++i) {
+            packet.write(static_cast<uint8_t>(i));
+        }
+        // An empty destination options header, then the fragment header
+        packet.write(static_cast<uint8_t>(44));
+        packet.write(static_cast<uint8_t>(0));
+        packet.write(static_cast<uint8_t>(1));
+        packet.write(static_cast<uint8_t>(4));
+        packet.write(static_cast<uint32_t>(0));
+        packet.write(static_cast<uint8_t>(17));
+        packet.write(static_cast<uint8_t>(0));
+        packet.write(static_cast<uint16_t>(offset | (more ? 1 : 0)));
+        packet.write(id);
+        packet.write(payload.data(), payload.size());
+        return vector<uint8_t>(packet.getBuffer(), packet.getBuffer() + packet.size());
+    }
+
+    vector<uint8_t> bytes(size_t size, uint8_t seed) {
+        vector<uint8_t> data(size);
+        for (size_t i = 0; i < size; ++i) {
+            data[i] = seed + i;
+        }
+        return data;
+    }
+
+    vector<uint8_t> slice(const vector<uint8_t>& data, size_t offset, size_t size) {
+        return vector<uint8_t>(data.begin() + offset, data.begin() + offset + size);
+    }
+
+    vector<uint8_t> contents(Reassembler::Datagram& datagram) {
+        return vector<uint8_t>(datagram.buffer->getBuffer(), datagram.buffer->getBuffer() + datagram.buffer->size());
+    }
+}
+
+TEST_CASE("Fragment parsing") {
+    auto payload = bytes(16, 0);
+    SECTION("IPv4") {
+        auto packet = ipv4Fragment(0x1234, 800, true, payload);
+        auto fragment = Reassembler::parseIpv4(packet);
+        REQUIRE(fragment);
+        REQUIRE(fragment->key.id == 0x1234);
+        REQUIRE(fragment->key.protocol == 17);
+        REQUIRE(fragment->key.version == 4);
+        REQUIRE(fragment->key.src[3] == 1);
+        REQUIRE(fragment->offset == 800);
+        REQUIRE(fragment->moreFragments);
+        REQUIRE(vector<uint8_t>(fragment->payload.begin(), fragment->payload.end()) == payload);
+        packet.resize(30);
+        REQUIRE_FALSE(Reassembler::parseIpv4(packet));
+    }
+    SECTION("IPv6 behind an extension header") {
+        auto packet = ipv6Fragment(0xDEADBEEF, 1232, false, payload);
+        auto fragment = Reassembler::parseIpv6(packet);
+        REQUIRE(fragment);
+        REQUIRE(fragment->key.id == 0xDEADBEEF);
+        REQUIRE(fragment->key.protocol == 17);
+        REQUIRE(fragment->key.version == 6);
+        REQUIRE(fragment->key.dst[15] == 31);
+        REQUIRE(fragment->offset == 1232);
+        REQUIRE_FALSE(fragment->moreFragments);
+        REQUIRE(vector<uint8_t>(fragment->payload.begin(), fragment->payload.end()) == payload);
+        REQUIRE_FALSE(Reassembler::parseIpv4(packet));
+    }
+}
+
+TEST_CASE("Fragment reassembly") {
+    Reassembler reassembler(std::chrono::seconds(1), 1);
+    auto now = Clock::now();
+    auto payload = bytes(3000, 7);
+    auto add = [&](const vector<uint8_t>& packet) {
+        return reassembler.add(*Reassembler::parseIpv4(packet), now);
+    };
+
+    SECTION("in any order") {
+        REQUIRE_FALSE(add(ipv4Fragment(1, 1000, true, slice(payload, 1000, 1000))));
+        REQUIRE_FALSE(add(ipv4Fragment(1, 2000, false, slice(payload, 2000, 1000))));
+        REQUIRE(reassembler.pending() == 1);
+        auto datagram = add(ipv4Fragment(1, 0, true, slice(payload, 0, 1000)));
+        REQUIRE(datagram);
+        REQUIRE(contents(*datagram) == payload);
+        REQUIRE(datagram->key.id == 1);
+        REQUIRE(reassembler.pending() == 0);
+        REQUIRE(reassembler.stats().completed == 1);
+    }
+    SECTION("an unfragmented packet completes at once") {
+        auto datagram = add(ipv4Fragment(2, 0, false, slice(payload, 0, 100)));
+        REQUIRE(datagram);
+        REQUIRE(contents(*datagram) == slice(payload, 0, 100));
+    }
+    SECTION("interleaved datagrams") {
+        auto other = bytes(2000, 99);
+        add(ipv4Fragment(1, 0, true, slice(payload, 0, 1496)));
+        add(ipv4Fragment(2, 1000, false, slice(other, 1000, 1000)));
+        auto first = add(ipv4Fragment(1, 1496, false, slice(payload, 1496, 1504)));
+        auto second = add(ipv4Fragment(2, 0, true, slice(other, 0, 1000)));
+        REQUIRE(first);
+        REQUIRE(second);
+        REQUIRE(contents(*first) == payload);
+        REQUIRE(contents(*second) == other);
+    }
+    SECTION("overlaps drop the datagram") {
+        add(ipv4Fragment(1, 0, true, slice(payload, 0, 1000)));
+        REQUIRE_FALSE(add(ipv4Fragment(1, 992, true, slice(payload, 992, 1000))));
+        REQUIRE(reassembler.stats().overlaps == 1);
+        REQUIRE(reassembler.pending() == 0);
+        // The rest starts a new datagram, which never completes
+        REQUIRE_FALSE(add(ipv4Fragment(1, 2000, false, slice(payload, 2000, 1000))));
+        REQUIRE(reassembler.pending() == 1);
+    }
+    SECTION("too many holes drop the datagram") {
+        for (size_t offset = 0; offset < 8 * 400; offset += 400) {
+            add(ipv4Fragment(1, offset, true, slice(payload, offset, 200)));
+        }
+        REQUIRE(reassembler.stats().malformed == 1);
+    }
+    SECTION("inconsistent or oversized lengths are malformed") {
+        add(ipv4Fragment(1, 0, true, slice(payload, 0, 1000)));
+        add(ipv4Fragment(1, 2000, false, slice(payload, 2000, 100)));
+        REQUIRE_FALSE(add(ipv4Fragment(1, 1000, false, slice(payload, 1000, 1000))));
+        REQUIRE(reassembler.stats().malformed == 1);
+        REQUIRE_FALSE(add(ipv4Fragment(3, 4000, false, slice(payload, 0, 200))));
+        REQUIRE(reassembler.stats().malformed == 2);
+        REQUIRE(reassembler.pending() == 0);
+    }
+    SECTION("timeouts") {
+        add(ipv4Fragment(1, 0, true, slice(payload, 0, 1000)));
+        now += std::chrono::seconds(2);
+        // A late fragment starts over rather than completing stale data
+        REQUIRE_FALSE(add(ipv4Fragment(1, 1000, false, slice(payload, 1000, 1000))));
+        REQUIRE(reassembler.stats().timeouts == 1);
+        add(ipv4Fragment(2, 0, true, slice(payload, 0, 1000)));
+        now += std::chrono::seconds(2);
+        REQUIRE(reassembler.expire(now) == 2);
+        REQUIRE(reassembler.pending() == 0);
+    }
+    SECTION("memory is capped") {
+        for (uint16_t id = 0; id < 8; ++id) {
+            add(ipv4Fragment(id, 0, true, slice(payload, 0, 8)));
+        }
+        REQUIRE(reassembler.pending() == 8);
+        REQUIRE_FALSE(add(ipv4Fragment(100, 0, true, slice(payload, 0, 8))));
+        REQUIRE(reassembler.stats().noMemory == 1);
+        // Completed datagrams held by the caller count against the pool
+        for (uint16_t id = 0; id < 8; ++id) {
+            add(ipv4Fragment(id, 8, true, slice(payload, 0, 8)));
+        }
+        auto held = add(ipv4Fragment(0, 16, false, slice(payload, 0, 8)));
+        REQUIRE(held);
+        auto alsoHeld = add(ipv4Fragment(1, 16, false, slice(payload, 0, 8)));
+        REQUIRE(alsoHeld);
+        // Slots are free but the one spare buffer is the last
+        auto lastBuffer = add(ipv4Fragment(200, 0, false, slice(payload, 0, 8)));
+        REQUIRE(lastBuffer);
+        REQUIRE(reassembler.pending() == 6);
+        REQUIRE_FALSE(add(ipv4Fragment(201, 0, true, slice(payload, 0, 8))));
+        REQUIRE(reassembler.stats().noMemory == 2);
+    }
+    SECTION("index stays consistent through many adds and drops") {
+        for (uint16_t round = 0; round < 200; ++round) {
+            for (uint16_t i = 0; i < 8; ++i) {
+                add(ipv4Fragment(round * 8 + i, 0, true, slice(payload, 0, 8)));
+            }
+            for (uint16_t i = 0; i < 8; ++i) {
+                uint16_t id = round * 8 + ((i * 3) % 8);
+                REQUIRE(add(ipv4Fragment(id, 8, false, slice(payload, 8, 8))));
+            }
+            REQUIRE(reassembler.pending() == 0);
+        }
+    }
+    SECTION("IPv6") {
+        auto datagram = reassembler.add(*Reassembler::parseIpv6(ipv6Fragment(9, 1000, false, slice(payload, 1000, 500))), now);
+        REQUIRE_FALSE(datagram);
+        datagram = reassembler.add(*Reassembler::parseIpv6(ipv6Fragment(9, 0, true, slice(payload, 0, 1000))), now);
+        REQUIRE(datagram);
+        REQUIRE(contents(*datagram) == slice(payload, 0, 1500));
+        REQUIRE(datagram->key.version == 6);
+    }
+}
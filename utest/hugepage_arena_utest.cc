@@ -0,0 +1,70 @@
+#include "catch.hpp"
+
+#include "buffer_pool.hpp"
+#include "hugepage_arena.hpp"
+#include "network_buffer.hpp"
+
+#include <cstdint>
+#include <new>
+
+using namespace std;
+
+TEST_CASE("HugePageArena") {
+    SECTION("rounds up to whole huge pages") {
+        auto arena = HugePageArena::create(1);
+        REQUIRE(arena);
+        REQUIRE(arena->size() == HugePageArena::hugePageSize);
+        REQUIRE(arena->used() == 0);
+        // Explicit huge pages are only there if reserved
+        REQUIRE(arena->pages() != HugePageArena::Pages::Small);
+        REQUIRE(arena->hugePages() <= 1);
+    }
+    SECTION("allocates aligned until full") {
+        auto arena = HugePageArena::create(HugePageArena::hugePageSize, HugePageArena::Pages::Small);
+        REQUIRE(arena);
+        REQUIRE(arena->pages() == HugePageArena::Pages::Small);
+        REQUIRE(arena->hugePages() == 0);
+        REQUIRE(reinterpret_cast<uintptr_t>(arena->allocate(1)) % HugePageArena::hugePageSize == 0);
+        auto* second = arena->allocate(100, 64);
+        REQUIRE(reinterpret_cast<uintptr_t>(second) % 64 == 0);
+        REQUIRE(arena->used() == 164);
+        REQUIRE_FALSE(arena->allocate(HugePageArena::hugePageSize));
+        REQUIRE(arena->allocate(HugePageArena::hugePageSize - 164, 1));
+        REQUIRE(arena->used() == arena->size());
+        REQUIRE_FALSE(arena->allocate(1, 1));
+    }
+    SECTION("transparent huge pages are counted") {
+        auto arena = HugePageArena::create(8 * HugePageArena::hugePageSize, HugePageArena::Pages::Transparent);
+        REQUIRE(arena);
+        REQUIRE(arena->pages() == HugePageArena::Pages::Transparent);
+        // Up to the kernel (and its configuration), but never more
+        //  than the arena holds
+        REQUIRE(arena->hugePages() <= 8);
+    }
+    SECTION("move") {
+        auto arena = HugePageArena::create(1);
+        HugePageArena moved = std::move(*arena);
+        REQUIRE(moved.size() == HugePageArena::hugePageSize);
+        REQUIRE(moved.allocate(64));
+    }
+}
+
+TEST_CASE("BufferPool in an arena") {
+    using Buffer = NetworkBuffer<1500>;
+    auto arena = HugePageArena::create(4 * sizeof(Buffer));
+    REQUIRE(arena);
+
+    SECTION("buffers are placed in the arena") {
+        BufferPool<Buffer> pool(4, *arena);
+        REQUIRE(arena->used() == 4 * sizeof(Buffer));
+        auto first = pool.acquire();
+        auto second = pool.acquire();
+        REQUIRE((*first)->empty());
+        REQUIRE(reinterpret_cast<uint8_t*>(&**second) - reinterpret_cast<uint8_t*>(&**first) == sizeof(Buffer));
+        (*first)->write(static_cast<uint32_t>(42));
+        REQUIRE((*first)->read32() == 42);
+    }
+    SECTION("a pool that doesn't fit throws") {
+        REQUIRE_THROWS_AS(BufferPool<Buffer>(arena->size() / sizeof(Buffer) + 1, *arena), std::bad_alloc);
+    }
+}
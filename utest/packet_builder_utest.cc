@@ -0,0 +1,233 @@
+#include "catch.hpp"
+
+#include "network_buffer.hpp"
+#include "packet_builder.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <vector>
+
+using namespace std;
+
+namespace {
+    // Straight from RFC 1071, one big-endian word at a time
+    uint16_t referenceSum(const vector<uint8_t>& data, uint32_t sum = 0) {
+        for (size_t i = 0; i < data.size(); i += 2) {
+            sum += (data[i] << 8) | (i + 1 < data.size() ? data[i + 1] : 0);
+        }
+        while (sum >> 16) {
+            sum = (sum & 0xFFFF) + (sum >> 16);
+        }
+        return sum;
+    }
+
+    uint16_t pseudoHeaderSum(const uint8_t* ip, size_t transportSize) {
+        uint32_t sum = 0;
+        for (int i = 12; i < 20; i += 2) {
+            sum += (ip[i] << 8) | ip[i + 1];
+        }
+        return referenceSum({}, sum + ip[9] + transportSize);
+    }
+
+    // Verify both checksums of a packet, returning the transport one
+    //  folded over the whole transport segment (0xFFFF if correct)
+    uint16_t verify(const uint8_t* packet, size_t size) {
+        REQUIRE(referenceSum(vector<uint8_t>(packet, packet + 20)) == 0xFFFF);
+        vector<uint8_t> transport(packet + 20, packet + size);
+        return referenceSum(transport, pseudoHeaderSum(packet, transport.size()));
+    }
+
+    vector<uint8_t> bytes(size_t size) {
+        vector<uint8_t> data(size);
+        for (size_t i = 0; i < size; ++i) {
+            data[i] = i * 31 + 7;
+        }
+        return data;
+    }
+}
+
+TEST_CASE("Checksum sum") {
+    for (size_t size : { 0, 1, 2, 7, 8, 9, 20, 1499 }) {
+        auto data = bytes(size);
+        uint16_t expected = ~referenceSum(data);
+        REQUIRE(ntohs(checksum_detail::checksum(data.data(), data.size())) == expected);
+    }
+}
+
+TEST_CASE("UdpFlow") {
+    UdpFlow flow(0x0A000001, 5000, 0xC0A80102, 53, 32, 0x10);
+    NetworkBuffer<2048> buffer;
+
+    SECTION("fields and checksums") {
+        for (size_t size : { 0, 1, 100, 1471 }) {
+            auto payload = bytes(size);
+            uint16_t id = flow.nextId();
+            flow.write(buffer, payload);
+            REQUIRE(buffer.size() == 28 + size);
+            const uint8_t* packet = buffer.getBuffer();
+            REQUIRE(packet[0] == 0x45);
+            REQUIRE(packet[1] == 0x10);
+            REQUIRE(loadNetwork<uint16_t>(packet + 2) == 28 + size);
+            REQUIRE(loadNetwork<uint16_t>(packet + 4) == id);
+            REQUIRE(packet[8] == 32);
+            REQUIRE(packet[9] == 17);
+            REQUIRE(loadNetwork<uint32_t>(packet + 16) == 0xC0A80102);
+            REQUIRE(loadNetwork<uint16_t>(packet + 20) == 5000);
+            REQUIRE(loadNetwork<uint16_t>(packet + 22) == 53);
+            REQUIRE(loadNetwork<uint16_t>(packet + 24) == 8 + size);
+            REQUIRE(verify(packet, buffer.size()) == 0xFFFF);
+            REQUIRE(vector<uint8_t>(packet + 28, packet + buffer.size()) == payload);
+            buffer.read(buffer.size());
+            buffer.compact();
+        }
+    }
+    SECTION("header only") {
+        flow.write(buffer, span<const uint8_t>());
+        REQUIRE(buffer.size() == 28);
+        REQUIRE(loadNetwork<uint16_t>(buffer.getBuffer() + 24) == 8);
+        REQUIRE(verify(buffer.getBuffer(), buffer.size()) == 0xFFFF);
+    }
+    SECTION("batches") {
+        vector<NetworkBuffer<2048>> buffers(16);
+        auto payload = bytes(333);
+        flow.setNextId(0xFFF8);
+        flow.writeBatch(span(buffers), span<const uint8_t>(payload));
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            REQUIRE(loadNetwork<uint16_t>(buffers[i].getBuffer() + 4) == static_cast<uint16_t>(0xFFF8 + i));
+            REQUIRE(verify(buffers[i].getBuffer(), buffers[i].size()) == 0xFFFF);
+        }
+
+        vector<NetworkBuffer<2048>> others(3);
+        auto a = bytes(10);
+        auto b = bytes(11);
+        auto c = bytes(1000);
+        span<const uint8_t> payloads[] = { a, b, c };
+        flow.writeBatch(span(others), span<const span<const uint8_t>>(payloads));
+        REQUIRE(others[1].size() == 28 + 11);
+        for (auto& other : others) {
+            REQUIRE(verify(other.getBuffer(), other.size()) == 0xFFFF);
+        }
+    }
+    SECTION("pseudo-header checksum for offload") {
+        UdpFlow offloaded(0x0A000001, 5000, 0xC0A80102, 53, 64, 0, ChecksumMode::PseudoHeader);
+        auto payload = bytes(101);
+        offloaded.write(buffer, payload);
+        const uint8_t* packet = buffer.getBuffer();
+        REQUIRE(loadNetwork<uint16_t>(packet + 26) == pseudoHeaderSum(packet, 8 + 101));
+        // What the device does: sum the segment, field included
+        vector<uint8_t> transport(packet + 20, packet + buffer.size());
+        uint16_t completed = ~referenceSum(transport);
+        transport[6] = completed >> 8;
+        transport[7] = completed & 0xFF;
+        REQUIRE(referenceSum(transport, pseudoHeaderSum(packet, transport.size())) == 0xFFFF);
+    }
+}
+
+TEST_CASE("TcpFlow") {
+    TcpFlow flow(0x7F000001, 40000, 0x7F000002, 80, 4096);
+    NetworkBuffer<2048> buffer;
+
+    SECTION("fields and checksums") {
+        auto payload = bytes(999);
+        flow.write(buffer, 0x12345678, 0x9ABCDEF0, TcpFlow::psh | TcpFlow::ack, payload);
+        const uint8_t* packet = buffer.getBuffer();
+        REQUIRE(buffer.size() == 40 + 999);
+        REQUIRE(packet[9] == 6);
+        REQUIRE(loadNetwork<uint32_t>(packet + 24) == 0x12345678);
+        REQUIRE(loadNetwork<uint32_t>(packet + 28) == 0x9ABCDEF0);
+        REQUIRE(packet[32] == 0x50);
+        REQUIRE(packet[33] == (TcpFlow::psh | TcpFlow::ack));
+        REQUIRE(loadNetwork<uint16_t>(packet + 34) == 4096);
+        REQUIRE(verify(packet, buffer.size()) == 0xFFFF);
+    }
+    SECTION("header only") {
+        flow.write(buffer, 1, 2, TcpFlow::ack, span<const uint8_t>());
+        REQUIRE(buffer.size() == 40);
+        REQUIRE(loadNetwork<uint32_t>(buffer.getBuffer() + 28) == 2);
+        REQUIRE(verify(buffer.getBuffer(), buffer.size()) == 0xFFFF);
+    }
+    SECTION("batches advance the sequence number") {
+        vector<NetworkBuffer<2048>> buffers(4);
+        auto payload = bytes(1000);
+        flow.writeBatch(span(buffers), 1000, 1, TcpFlow::ack, span<const uint8_t>(payload));
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            REQUIRE(loadNetwork<uint32_t>(buffers[i].getBuffer() + 24) == 1000 + i * 1000);
+            REQUIRE(verify(buffers[i].getBuffer(), buffers[i].size()) == 0xFFFF);
+        }
+    }
+}
+
+TEST_CASE("Packets built by the flows are accepted by the kernel") {
+    int raw = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
+    if (raw < 0) {
+        WARN("raw sockets are unavailable here (needs CAP_NET_RAW)");
+        return;
+    }
+    sockaddr_in loopback{};
+    loopback.sin_family = AF_INET;
+    loopback.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    SECTION("UDP") {
+        int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in addr = loopback;
+        ::bind(receiver, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(receiver, reinterpret_cast<sockaddr*>(&addr), &len);
+        fcntl(receiver, F_SETFL, O_NONBLOCK);
+
+        UdpFlow flow(INADDR_LOOPBACK, 12345, INADDR_LOOPBACK, ntohs(addr.sin_port));
+        vector<NetworkBuffer<2048>> buffers(8);
+        auto payload = bytes(501);
+        flow.writeBatch(span(buffers), span<const uint8_t>(payload));
+        // Corrupt the last one's checksum: the kernel must drop it
+        buffers[7].getBuffer()[26] ^= 0xFF;
+        for (auto& buffer : buffers) {
+            REQUIRE(sendto(raw, buffer.getBuffer(), buffer.size(), 0,
+                           reinterpret_cast<sockaddr*>(&loopback), sizeof(loopback)) == static_cast<ssize_t>(buffer.size()));
+        }
+        size_t received = 0;
+        vector<uint8_t> datagram(2048);
+        ssize_t res;
+        while ((res = recv(receiver, datagram.data(), datagram.size(), 0)) > 0) {
+            REQUIRE(vector<uint8_t>(datagram.begin(), datagram.begin() + res) == payload);
+            ++received;
+        }
+        REQUIRE(received == 7);
+        close(receiver);
+    }
+    SECTION("TCP") {
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = loopback;
+        ::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+        listen(listener, 1);
+        // Sees every TCP segment on the host, including the SYN-ACK
+        int sniffer = socket(AF_INET, SOCK_RAW, IPPROTO_TCP);
+
+        TcpFlow flow(INADDR_LOOPBACK, 23456, INADDR_LOOPBACK, ntohs(addr.sin_port));
+        NetworkBuffer<2048> syn;
+        flow.write(syn, 1000, 0, TcpFlow::syn);
+        sendto(raw, syn.getBuffer(), syn.size(), 0, reinterpret_cast<sockaddr*>(&loopback), sizeof(loopback));
+
+        bool synAck = false;
+        vector<uint8_t> packet(2048);
+        pollfd pfd{sniffer, POLLIN, 0};
+        while (!synAck && poll(&pfd, 1, 1000) > 0) {
+            ssize_t res = recv(sniffer, packet.data(), packet.size(), 0);
+            if (res >= 40 && loadNetwork<uint16_t>(packet.data() + 22) == 23456 &&
+                (packet[33] & (TcpFlow::syn | TcpFlow::ack)) == (TcpFlow::syn | TcpFlow::ack)) {
+                REQUIRE(loadNetwork<uint32_t>(packet.data() + 28) == 1001);
+                synAck = true;
+            }
+        }
+        REQUIRE(synAck);
+        close(sniffer);
+        close(listener);
+    }
+    close(raw);
+}
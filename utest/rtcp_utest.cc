@@ -0,0 +1,149 @@
+#include "catch.hpp"
+
+#include "network_buffer.hpp"
+#include "rtcp.hpp"
+
+#include <vector>
+
+using namespace std;
+
+TEST_CASE("RTCP compound packets") {
+    NetworkBuffer<1500> buffer;
+    RtcpSenderInfo info{0x0102030405060708, 1000, 10, 12000};
+    RtcpReportBlock block{0x1234, 25, 3, 5000, 7, 0xAAAA, 0xBBBB};
+    RtcpWriter::writeSenderReport(buffer, 0xCAFE, info, {&block, 1});
+    RtcpWriter::writePli(buffer, 0xCAFE, 0xBEEF);
+    uint32_t rembSsrcs[] = { 0xBEEF, 0xF00D };
+    RtcpWriter::writeRemb(buffer, 0xCAFE, 1'500'000, rembSsrcs);
+
+    RtcpCompoundReader reader(buffer);
+
+    auto sr = reader.next();
+    REQUIRE(sr->type == RtcpType::SenderReport);
+    REQUIRE(sr->count == 1);
+    REQUIRE(sr->body.size() == 24 + 24);
+    REQUIRE(loadNetwork<uint32_t>(sr->body.data()) == 0xCAFE);
+    REQUIRE(loadNetwork<uint64_t>(sr->body.data() + 4) == 0x0102030405060708);
+    REQUIRE(loadNetwork<uint32_t>(sr->body.data() + 24) == 0x1234);
+    REQUIRE(sr->body[28] == 25);
+
+    auto pli = reader.next();
+    REQUIRE(pli->type == RtcpType::PayloadFeedback);
+    REQUIRE(pli->count == rtcpFmtPli);
+    REQUIRE(pli->senderSsrc() == 0xCAFE);
+    REQUIRE(pli->mediaSsrc() == 0xBEEF);
+
+    auto remb = reader.next();
+    REQUIRE(remb->count == rtcpFmtAfb);
+    REQUIRE(memcmp(remb->body.data() + 8, "REMB", 4) == 0);
+    uint32_t rembInfo = loadNetwork<uint32_t>(remb->body.data() + 12);
+    REQUIRE((rembInfo >> 24) == 2);
+    uint64_t mantissa = rembInfo & 0x3FFFF;
+    uint8_t exp = (rembInfo >> 18) & 0x3F;
+    REQUIRE((mantissa << exp) <= 1'500'000);
+    REQUIRE((mantissa << exp) > 1'500'000 - (uint64_t(1) << exp));
+
+    REQUIRE(!reader.next());
+    REQUIRE(!reader.malformed());
+}
+
+TEST_CASE("RTCP receiver reports are split at 31 blocks") {
+    NetworkBuffer<4096> buffer;
+    vector<RtcpReportBlock> blocks(40, RtcpReportBlock{1, 0, 0, 0, 0, 0, 0});
+    RtcpWriter::writeReceiverReport(buffer, 0xCAFE, blocks);
+    RtcpCompoundReader reader(buffer);
+    REQUIRE(reader.next()->count == 31);
+    REQUIRE(reader.next()->count == 9);
+    REQUIRE(!reader.next());
+}
+
+TEST_CASE("RTCP malformed compound packets") {
+    NetworkBuffer<1500> buffer;
+    RtcpWriter::writePli(buffer, 1, 2);
+    RtcpCompoundReader reader(span<const uint8_t>(buffer.getBuffer(), buffer.size() - 1));
+    REQUIRE(!reader.next());
+    REQUIRE(reader.malformed());
+
+    SECTION("feedback without SSRCs") {
+        // A PLI with length 0: just the header
+        const uint8_t shortPli[] = { 0x81, 206, 0x00, 0x00 };
+        RtcpCompoundReader shortReader(shortPli);
+        REQUIRE(!shortReader.next());
+        REQUIRE(shortReader.malformed());
+    }
+}
+
+TEST_CASE("RTCP generic NACK") {
+    NetworkBuffer<1500> buffer;
+    vector<uint16_t> lost{65530, 65531, 65535, 3, 10, 100};
+    RtcpWriter::writeNack(buffer, 1, 2, lost);
+    RtcpCompoundReader reader(buffer);
+    auto nack = reader.next();
+    REQUIRE(nack->type == RtcpType::TransportFeedback);
+    REQUIRE(nack->count == rtcpFmtNack);
+    // 65530 covers up to 65530 + 16 = 10 (wrapped), 100 needs its own item
+    REQUIRE(nack->body.size() == 8 + 2 * 4);
+    vector<uint16_t> decoded;
+    RtcpFeedbackReader::forEachNack(*nack, [&](uint16_t seq) { decoded.push_back(seq); });
+    REQUIRE(decoded == lost);
+}
+
+TEST_CASE("RTCP transport-wide CC") {
+    auto roundTrip = [](const vector<int32_t>& deltas) {
+        // Room for the worst case of every packet having a 2 byte delta
+        NetworkBuffer<16384> buffer;
+        RtcpWriter::writeTransportCc(buffer, 1, 2, 65500, 0x123456, 7, deltas);
+        REQUIRE(buffer.size() % 4 == 0);
+        RtcpCompoundReader reader(buffer);
+        auto packet = reader.next();
+        REQUIRE(packet);
+        REQUIRE(packet->count == rtcpFmtTransportCc);
+        REQUIRE(loadNetwork<uint32_t>(packet->body.data() + 12) == ((0x123456 << 8) | 7));
+        vector<int32_t> decoded;
+        uint16_t expectedSeq = 65500;
+        REQUIRE(RtcpFeedbackReader::forEachTransportCc(*packet, [&](uint16_t seq, optional<int32_t> delta) {
+            REQUIRE(seq == expectedSeq++);
+            decoded.push_back(delta ? *delta : RtcpWriter::notReceived);
+        }));
+        REQUIRE(!reader.next());
+        return decoded;
+    };
+    const int32_t lost = RtcpWriter::notReceived;
+
+    SECTION("runs") {
+        vector<int32_t> deltas(100, 4);
+        deltas.insert(deltas.end(), 20, lost);
+        deltas.insert(deltas.end(), 9, -5);
+        REQUIRE(roundTrip(deltas) == deltas);
+    }
+
+    SECTION("1-bit vectors") {
+        vector<int32_t> deltas;
+        for (int i = 0; i < 50; ++i) {
+            deltas.push_back(i % 3 ? i : lost);
+        }
+        REQUIRE(roundTrip(deltas) == deltas);
+    }
+
+    SECTION("2-bit vectors") {
+        vector<int32_t> deltas;
+        for (int i = 0; i < 50; ++i) {
+            deltas.push_back(i % 3 == 0 ? lost : i % 3 == 1 ? 1000 : 10);
+        }
+        REQUIRE(roundTrip(deltas) == deltas);
+    }
+
+    SECTION("mixed, every length") {
+        vector<int32_t> pattern{1, 1, lost, 300, 2, 2, 2, 2, 2, 2, 2, 2, lost, -1, 0, 255, 256};
+        for (size_t len = 1; len <= pattern.size(); ++len) {
+            vector<int32_t> deltas(pattern.begin(), pattern.begin() + len);
+            REQUIRE(roundTrip(deltas) == deltas);
+        }
+    }
+
+    SECTION("long runs") {
+        vector<int32_t> deltas(RtcpWriter::maxTransportCcPackets, lost);
+        deltas.back() = 1;
+        REQUIRE(roundTrip(deltas) == deltas);
+    }
+}
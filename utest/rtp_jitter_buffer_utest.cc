@@ -0,0 +1,140 @@
+#include "catch.hpp"
+
+#include "network_buffer.hpp"
+#include "rtp_jitter_buffer.hpp"
+
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+    using Buffer = NetworkBuffer<64>;
+    using Jitter = RtpJitterBuffer<Buffer, 64>;
+
+    Jitter::InsertResult insert(Jitter& jitter, BufferPool<Buffer>& pool, uint16_t seq) {
+        auto handle = pool.acquire();
+        (*handle)->write(seq);
+        return jitter.insert(seq, std::move(*handle));
+    }
+
+    vector<uint16_t> popAll(Jitter& jitter) {
+        vector<uint16_t> seqs;
+        while (auto packet = jitter.pop()) {
+            seqs.push_back((*packet)->read16());
+        }
+        return seqs;
+    }
+
+    vector<uint16_t> missing(const Jitter& jitter) {
+        vector<uint16_t> seqs;
+        jitter.forEachMissing([&](uint16_t seq) { seqs.push_back(seq); });
+        return seqs;
+    }
+}
+
+TEST_CASE("RtpJitterBuffer") {
+    BufferPool<Buffer> pool(256);
+    Jitter jitter;
+
+    SECTION("reorders") {
+        for (uint16_t seq : { 10, 12, 11, 14, 13 }) {
+            REQUIRE(insert(jitter, pool, seq) == Jitter::InsertResult::Inserted);
+        }
+        REQUIRE(jitter.size() == 5);
+        REQUIRE(popAll(jitter) == vector<uint16_t>{ 10, 11, 12, 13, 14 });
+        REQUIRE(jitter.empty());
+        REQUIRE(pool.available() == 256);
+    }
+    SECTION("waits for gaps and reports them") {
+        for (uint16_t seq : { 100, 101, 104, 106 }) {
+            insert(jitter, pool, seq);
+        }
+        REQUIRE(popAll(jitter) == vector<uint16_t>{ 100, 101 });
+        REQUIRE(jitter.head() == 102);
+        REQUIRE(jitter.window() == 5);
+        REQUIRE(missing(jitter) == vector<uint16_t>{ 102, 103, 105 });
+        uint16_t lost[2];
+        REQUIRE(jitter.missing(lost) == 2);
+        REQUIRE(lost[1] == 103);
+
+        insert(jitter, pool, 103);
+        REQUIRE(jitter.skip());
+        REQUIRE(popAll(jitter) == vector<uint16_t>{ 103, 104 });
+        REQUIRE(missing(jitter) == vector<uint16_t>{ 105 });
+    }
+    SECTION("duplicates and late packets are left with the caller") {
+        insert(jitter, pool, 5);
+        insert(jitter, pool, 6);
+        REQUIRE(insert(jitter, pool, 6) == Jitter::InsertResult::Duplicate);
+        popAll(jitter);
+        REQUIRE(insert(jitter, pool, 5) == Jitter::InsertResult::TooLate);
+        REQUIRE(pool.available() == 256);
+    }
+    SECTION("wraps around") {
+        for (uint16_t seq : { 65533, 65535, 1, 0, 65534 }) {
+            REQUIRE(insert(jitter, pool, seq) == Jitter::InsertResult::Inserted);
+        }
+        REQUIRE(missing(jitter) == vector<uint16_t>{});
+        REQUIRE(popAll(jitter) == vector<uint16_t>{ 65533, 65534, 65535, 0, 1 });
+        insert(jitter, pool, 4);
+        REQUIRE(missing(jitter) == vector<uint16_t>{ 2, 3 });
+    }
+    SECTION("missing spans the ring's end") {
+        insert(jitter, pool, 60);
+        popAll(jitter);
+        insert(jitter, pool, 75);
+        vector<uint16_t> expected;
+        for (uint16_t seq = 61; seq < 75; ++seq) {
+            expected.push_back(seq);
+        }
+        REQUIRE(missing(jitter) == expected);
+    }
+    SECTION("a packet beyond the window slides it forward") {
+        insert(jitter, pool, 0);
+        insert(jitter, pool, 2);
+        insert(jitter, pool, 63);
+        REQUIRE(insert(jitter, pool, 65) == Jitter::InsertResult::Inserted);
+        REQUIRE(jitter.head() == 2);
+        REQUIRE(jitter.overflowDrops() == 1);
+        REQUIRE(popAll(jitter).front() == 2);
+
+        // A jump beyond the whole window drops everything held
+        REQUIRE(insert(jitter, pool, 1000) == Jitter::InsertResult::Inserted);
+        REQUIRE(jitter.size() == 1);
+        REQUIRE(jitter.overflowDrops() == 3);
+        REQUIRE(jitter.head() == 1000 - 63);
+        REQUIRE(pool.available() == 255);
+    }
+    SECTION("a stream restart resyncs the window") {
+        for (uint16_t seq = 40000; seq < 40010; ++seq) {
+            insert(jitter, pool, seq);
+        }
+        popAll(jitter);
+        insert(jitter, pool, 40011);
+
+        // The sender restarts far behind: a few stragglers are just late
+        uint16_t seq = 10000;
+        for (; seq < 10000 + Jitter::resyncAfter - 1; ++seq) {
+            REQUIRE(insert(jitter, pool, seq) == Jitter::InsertResult::TooLate);
+        }
+        REQUIRE(jitter.resyncs() == 0);
+        // but a run of them restarts at the newest
+        REQUIRE(insert(jitter, pool, seq) == Jitter::InsertResult::Inserted);
+        REQUIRE(jitter.resyncs() == 1);
+        REQUIRE(jitter.head() == seq);
+        REQUIRE(jitter.overflowDrops() == 1);
+        REQUIRE(insert(jitter, pool, seq + 1) == Jitter::InsertResult::Inserted);
+        REQUIRE(popAll(jitter) == vector<uint16_t>{ seq, static_cast<uint16_t>(seq + 1) });
+        REQUIRE(pool.available() == 256);
+    }
+    SECTION("an occasional late packet doesn't resync") {
+        insert(jitter, pool, 10);
+        popAll(jitter);
+        for (std::size_t i = 0; i < 2 * Jitter::resyncAfter; ++i) {
+            REQUIRE(insert(jitter, pool, 5) == Jitter::InsertResult::TooLate);
+            REQUIRE(insert(jitter, pool, 11 + i) == Jitter::InsertResult::Inserted);
+        }
+        REQUIRE(jitter.resyncs() == 0);
+    }
+}
@@ -0,0 +1,140 @@
+#include "catch.hpp"
+
+#include "network_buffer.hpp"
+#include "rtp.hpp"
+
+#include <vector>
+
+using namespace std;
+
+namespace {
+    // V=2, X=1, CC=1, M=1, PT=96, seq=0x1234, ts=0xDEADBEEF, ssrc=0xCAFEBABE,
+    //  one CSRC, a one-byte extension block with two elements and a payload
+    const vector<uint8_t> packetBytes = {
+        0x91, 0xE0, 0x12, 0x34,
+        0xDE, 0xAD, 0xBE, 0xEF,
+        0xCA, 0xFE, 0xBA, 0xBE,
+        0x01, 0x02, 0x03, 0x04,
+        0xBE, 0xDE, 0x00, 0x02,
+        0x10, 0xAA, 0x00, 0x22,
+        0x01, 0x02, 0x03, 0x00,
+        'p', 'a', 'y', 'l', 'o', 'a', 'd',
+    };
+}
+
+TEST_CASE("RTP parsing") {
+    NetworkBuffer<1500> buffer;
+    buffer.write(packetBytes.data(), packetBytes.size());
+    auto packet = RtpPacket::parse(buffer);
+    REQUIRE(packet);
+
+    SECTION("fields") {
+        REQUIRE(packet->version() == 2);
+        REQUIRE(!packet->padding());
+        REQUIRE(packet->extension());
+        REQUIRE(packet->csrcCount() == 1);
+        REQUIRE(packet->marker());
+        REQUIRE(packet->payloadType() == 96);
+        REQUIRE(packet->sequenceNumber() == 0x1234);
+        REQUIRE(packet->timestamp() == 0xDEADBEEF);
+        REQUIRE(packet->ssrc() == 0xCAFEBABE);
+        REQUIRE(packet->csrc(0) == 0x01020304);
+        REQUIRE(packet->headerSize() == 28);
+        REQUIRE(packet->payload().size() == 7);
+        // Parsing doesn't consume the buffer
+        REQUIRE(buffer.size() == packetBytes.size());
+    }
+
+    SECTION("decoded header matches the getters") {
+        auto header = packet->header();
+        REQUIRE(header.version == 2);
+        REQUIRE(header.extension);
+        REQUIRE(!header.padding);
+        REQUIRE(header.csrcCount == 1);
+        REQUIRE(header.marker);
+        REQUIRE(header.payloadType == 96);
+        REQUIRE(header.sequenceNumber == 0x1234);
+        REQUIRE(header.timestamp == 0xDEADBEEF);
+        REQUIRE(header.ssrc == 0xCAFEBABE);
+    }
+
+    SECTION("one-byte extensions") {
+        REQUIRE(packet->extensionProfile() == 0xBEDE);
+        auto reader = packet->extensions();
+        auto first = reader.next();
+        REQUIRE(first->id == 1);
+        REQUIRE(first->data.size() == 1);
+        REQUIRE(first->data[0] == 0xAA);
+        auto second = reader.next();
+        REQUIRE(second->id == 2);
+        REQUIRE(second->data.size() == 3);
+        REQUIRE(second->data[0] == 0x01);
+        REQUIRE(!reader.next());
+    }
+
+    SECTION("in place rewrite") {
+        packet->setSsrc(0x11223344);
+        packet->setSequenceNumber(0xFFFF);
+        packet->setTimestamp(42);
+        packet->setMarker(false);
+        packet->setPayloadType(111);
+        (*packet->findExtension(1))[0] = 0x55;
+
+        auto reparsed = RtpPacket::parse(buffer);
+        REQUIRE(reparsed->ssrc() == 0x11223344);
+        REQUIRE(reparsed->sequenceNumber() == 0xFFFF);
+        REQUIRE(reparsed->timestamp() == 42);
+        REQUIRE(!reparsed->marker());
+        REQUIRE(reparsed->payloadType() == 111);
+        REQUIRE(reparsed->csrcCount() == 1);
+        REQUIRE((*reparsed->findExtension(1))[0] == 0x55);
+        REQUIRE(!reparsed->findExtension(5));
+    }
+}
+
+TEST_CASE("RTP two-byte extensions") {
+    vector<uint8_t> bytes = {
+        0x90, 0x60, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x01,
+        0x10, 0x00, 0x00, 0x02,
+        0x20, 0x00, 0x00, 0x21,
+        0x03, 0x01, 0x02, 0x03,
+    };
+    auto packet = RtpPacket::parse(bytes);
+    REQUIRE(packet);
+    auto reader = packet->extensions();
+    auto empty = reader.next();
+    REQUIRE(empty->id == 0x20);
+    REQUIRE(empty->data.empty());
+    auto ext = reader.next();
+    REQUIRE(ext->id == 0x21);
+    REQUIRE(ext->data.size() == 3);
+    REQUIRE(!reader.next());
+}
+
+TEST_CASE("RTP validation") {
+    SECTION("too short") {
+        vector<uint8_t> bytes(packetBytes.begin(), packetBytes.begin() + 11);
+        REQUIRE(!RtpPacket::parse(bytes));
+    }
+
+    SECTION("truncated extension") {
+        vector<uint8_t> bytes(packetBytes.begin(), packetBytes.begin() + 24);
+        REQUIRE(!RtpPacket::parse(bytes));
+    }
+
+    SECTION("wrong version") {
+        auto bytes = packetBytes;
+        bytes[0] = 0x51;
+        REQUIRE(!RtpPacket::parse(bytes));
+    }
+
+    SECTION("padding") {
+        auto bytes = packetBytes;
+        bytes[0] |= 0x20;
+        bytes.insert(bytes.end(), {0, 0, 3});
+        auto packet = RtpPacket::parse(bytes);
+        REQUIRE(packet->payload().size() == 7);
+    }
+}
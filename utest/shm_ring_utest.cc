@@ -0,0 +1,124 @@
+#include "catch.hpp"
+
+#include "shm_ring.hpp"
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <vector>
+
+using namespace std;
+
+namespace {
+    using Ring = ShmRing<256, 8>;
+
+    vector<uint8_t> message(size_t index) {
+        vector<uint8_t> data(index % 200 + 1);
+        for (size_t i = 0; i < data.size(); ++i) {
+            data[i] = index + i;
+        }
+        return data;
+    }
+}
+
+TEST_CASE("ShmRing") {
+    auto ring = Ring::create();
+    REQUIRE(ring);
+
+    SECTION("in one process") {
+        REQUIRE_FALSE(ring->peek());
+        for (size_t i = 0; i < 8; ++i) {
+            REQUIRE(ring->push(message(i)));
+        }
+        REQUIRE(ring->size() == 8);
+        REQUIRE_FALSE(ring->beginWrite());
+        REQUIRE_FALSE(ring->waitForSpace(1000));
+        for (size_t i = 0; i < 8; ++i) {
+            auto view = ring->peek();
+            REQUIRE(view);
+            REQUIRE(vector<uint8_t>(view->begin(), view->end()) == message(i));
+            ring->release();
+        }
+        REQUIRE_FALSE(ring->waitForData(1000));
+
+        // Slots are reused empty
+        auto* slot = ring->beginWrite();
+        REQUIRE(slot);
+        REQUIRE(slot->empty());
+        slot->write(static_cast<uint16_t>(0xABCD));
+        ring->commitWrite();
+        REQUIRE(ring->peek()->size() == 2);
+    }
+    SECTION("attaching checks the layout") {
+        int fd = fcntl(ring->fd(), F_DUPFD_CLOEXEC, 0);
+        REQUIRE_FALSE(ShmRing<256, 16>::attach(fd));
+        fd = fcntl(ring->fd(), F_DUPFD_CLOEXEC, 0);
+        auto other = Ring::attach(fd);
+        REQUIRE(other);
+        ring->push(message(3));
+        REQUIRE(other->size() == 1);
+        REQUIRE(other->peek()->size() == message(3).size());
+    }
+    SECTION("attaching checks the region's size") {
+        int fd = memfd_create("short_ring", MFD_CLOEXEC);
+        REQUIRE(fd >= 0);
+        REQUIRE(ftruncate(fd, 4096) == 0);
+        REQUIRE_FALSE(Ring::attach(fd));
+    }
+    SECTION("corrupt slots aren't read") {
+        // As a crashed or misbehaving producer might leave them
+        auto* slot = ring->beginWrite();
+        slot->write(static_cast<uint32_t>(1));
+        slot->_head = 10;
+        ring->commitWrite();
+        slot = ring->beginWrite();
+        slot->_tail = 60000;
+        ring->commitWrite();
+        ring->push(message(1));
+
+        REQUIRE(ring->corrupt());
+        REQUIRE_FALSE(ring->peek());
+        ring->release();
+        REQUIRE(ring->corrupt());
+        REQUIRE_FALSE(ring->peek());
+        ring->release();
+        REQUIRE_FALSE(ring->corrupt());
+        REQUIRE(ring->peek()->size() == message(1).size());
+    }
+    SECTION("between processes") {
+        constexpr size_t count = 10000;
+        int fd = ring->fd();
+        pid_t child = fork();
+        if (child == 0) {
+            // The producer attaches through the inherited descriptor,
+            //  at whatever address its mapping lands
+            auto producer = Ring::attach(fcntl(fd, F_DUPFD, 0));
+            if (!producer) {
+                _exit(1);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                while (!producer->push(message(i))) {
+                    producer->waitForSpace(-1);
+                }
+            }
+            _exit(0);
+        }
+        REQUIRE(child > 0);
+        size_t received = 0;
+        bool matched = true;
+        while (received < count && ring->waitForData(5'000'000'000)) {
+            while (auto view = ring->peek()) {
+                matched = matched && vector<uint8_t>(view->begin(), view->end()) == message(received);
+                ++received;
+                ring->release();
+            }
+        }
+        int status;
+        waitpid(child, &status, 0);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == 0);
+        REQUIRE(received == count);
+        REQUIRE(matched);
+    }
+}
@@ -0,0 +1,118 @@
+#include "catch.hpp"
+
+#include "size_class_pool.hpp"
+
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+TEST_CASE("SizeClassPool") {
+    using Pool = SizeClassPool<256, 1500, 9216>;
+    Pool pool({ 4, 2, 1 });
+    REQUIRE(pool.capacity(0) == 4);
+    REQUIRE(pool.capacity(2) == 1);
+    REQUIRE(pool.footprint() == 4 * sizeof(NetworkBuffer<256>) + 2 * sizeof(NetworkBuffer<1500>) + sizeof(NetworkBuffer<9216>));
+
+    SECTION("picks the smallest class that fits") {
+        auto small = pool.acquire(100);
+        auto exact = pool.acquire(256);
+        auto medium = pool.acquire(257);
+        auto large = pool.acquire(9000);
+        REQUIRE(small->sizeClass() == 0);
+        REQUIRE(small->capacity() == 256);
+        REQUIRE(exact->sizeClass() == 0);
+        REQUIRE(medium->sizeClass() == 1);
+        REQUIRE(large->sizeClass() == 2);
+        REQUIRE(pool.available(0) == 2);
+        REQUIRE(pool.available(1) == 1);
+        REQUIRE(pool.available(2) == 0);
+        REQUIRE(pool.fallbacks() == 0);
+    }
+    SECTION("too big for any class") {
+        REQUIRE_FALSE(pool.acquire(9217));
+        REQUIRE(pool.failures() == 1);
+    }
+    SECTION("falls back to a larger class") {
+        vector<Pool::Handle> handles;
+        for (int i = 0; i < 4; ++i) {
+            handles.push_back(std::move(*pool.acquire(10)));
+        }
+        auto next = pool.acquire(10);
+        REQUIRE(next);
+        REQUIRE(next->sizeClass() == 1);
+        REQUIRE(pool.fallbacks() == 1);
+        handles.push_back(std::move(*next));
+        handles.push_back(std::move(*pool.acquire(10)));
+        handles.push_back(std::move(*pool.acquire(10)));
+        REQUIRE(handles.back().sizeClass() == 2);
+        REQUIRE_FALSE(pool.acquire(10));
+        REQUIRE(pool.failures() == 1);
+        REQUIRE(pool.peakHeld() == array<size_t, 3>{ 7, 0, 0 });
+    }
+    SECTION("buffers are used through visit") {
+        auto handle = pool.acquire(2000);
+        handle->visit([](auto& buffer) {
+            buffer.write(static_cast<uint32_t>(0xDEADBEEF));
+        });
+        uint32_t value = handle->visit([](auto& buffer) {
+            return buffer.read32();
+        });
+        REQUIRE(value == 0xDEADBEEF);
+        size_t capacity = handle->visit([](auto& buffer) {
+            return buffer.remainingCapacity();
+        });
+        REQUIRE(capacity == 9216 - 4);
+    }
+    SECTION("records what was written at release") {
+        auto write = [&](size_t hint, size_t count) {
+            auto handle = pool.acquire(hint);
+            vector<uint8_t> data(count, 1);
+            handle->visit([&](auto& buffer) {
+                buffer.write(data.data(), data.size());
+                // Reading doesn't change what the buffer had to hold
+                buffer.read(data.size());
+            });
+        };
+        write(1500, 0);
+        write(1500, 100);
+        write(1500, 200);
+        write(1500, 1000);
+        write(9216, 5000);
+        REQUIRE(pool.histogram()[0] == 1);
+        // 100 is in [64, 128)
+        REQUIRE(pool.histogram()[7] == 1);
+        REQUIRE(pool.histogram()[8] == 1);
+        REQUIRE(pool.histogram()[10] == 1);
+        REQUIRE(pool.histogram()[13] == 1);
+        REQUIRE(pool.demand()[0] == 3);
+        REQUIRE(pool.demand()[1] == 1);
+        REQUIRE(pool.demand()[2] == 1);
+        // Everything went back
+        REQUIRE(pool.available(1) == 2);
+    }
+    SECTION("suggests capacities from what was seen") {
+        REQUIRE(pool.suggestCapacities() == array<size_t, 3>{ 4, 2, 1 });
+        {
+            vector<Pool::Handle> handles;
+            for (int i = 0; i < 3; ++i) {
+                handles.push_back(std::move(*pool.acquire(100)));
+            }
+            handles.push_back(std::move(*pool.acquire(5000)));
+        }
+        pool.acquire(100);
+        // Never more than 3 small and 1 large at once
+        REQUIRE(pool.peakHeld() == array<size_t, 3>{ 3, 0, 1 });
+        REQUIRE(pool.suggestCapacities(1.0) == array<size_t, 3>{ 3, 0, 1 });
+        REQUIRE(pool.suggestCapacities(1.5) == array<size_t, 3>{ 5, 0, 2 });
+    }
+    SECTION("moving a handle doesn't release it") {
+        auto handle = pool.acquire(10);
+        Pool::Handle moved = std::move(*handle);
+        REQUIRE(pool.available(0) == 3);
+        REQUIRE(pool.demand()[0] == 0);
+        moved.reset();
+        REQUIRE(pool.available(0) == 4);
+        REQUIRE(pool.demand()[0] == 1);
+    }
+}
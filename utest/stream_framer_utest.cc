@@ -0,0 +1,153 @@
+#include "catch.hpp"
+
+#include "network_buffer.hpp"
+#include "stream_framer.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+    // Feed data into the framer in pieces of the given size,
+    //  collecting the frames
+    template<typename Framer>
+    vector<string> feed(Framer& framer, const vector<uint8_t>& data, size_t pieceSize) {
+        vector<string> frames;
+        size_t pos = 0;
+        while (pos < data.size()) {
+            auto space = framer.writable();
+            size_t len = min({pieceSize, space.size(), data.size() - pos});
+            memcpy(space.data(), data.data() + pos, len);
+            framer.commit(len);
+            pos += len;
+            while (auto frame = framer.next()) {
+                frames.emplace_back(reinterpret_cast<char*>(frame->data()), frame->size());
+            }
+        }
+        return frames;
+    }
+
+    vector<uint8_t> toVector(const NetworkBuffer<1500>& buffer) {
+        return {buffer.getBuffer(), buffer.getBuffer() + buffer.size()};
+    }
+}
+
+TEST_CASE("Fixed header framing") {
+    NetworkBuffer<1500> stream;
+    vector<string> messages{"hello", "", "a longer message", "x"};
+    for (const auto& msg : messages) {
+        stream.writeLenPrefixed<uint16_t>(msg);
+    }
+    auto data = toVector(stream);
+
+    for (size_t pieceSize = 1; pieceSize <= data.size(); ++pieceSize) {
+        StreamFramer<FixedHeaderDecoder<uint16_t>, 64, 8> framer;
+        REQUIRE(feed(framer, data, pieceSize) == messages);
+        REQUIRE(framer.pending() == 0);
+        REQUIRE(!framer.error());
+    }
+}
+
+TEST_CASE("Fixed header framing with length at an offset") {
+    // 1 byte type, 2 byte length including the header, 1 reserved byte
+    StreamFramer<FixedHeaderDecoder<uint16_t, 4, 1, true>> framer;
+    uint8_t data[] = { 7, 0, 6, 0, 'a', 'b', 7, 0, 4, 0 };
+    memcpy(framer.writable().data(), data, sizeof(data));
+    framer.commit(sizeof(data));
+    auto first = framer.next();
+    REQUIRE(first->size() == 2);
+    REQUIRE((*first)[0] == 'a');
+    auto second = framer.next();
+    REQUIRE(second->empty());
+    REQUIRE(!framer.next());
+}
+
+TEST_CASE("Varint framing") {
+    NetworkBuffer<1500> stream;
+    vector<string> messages{"short", string(300, 'z'), "end"};
+    for (const auto& msg : messages) {
+        VarintDecoder::writeLength(stream, msg.size());
+        stream.write(reinterpret_cast<const uint8_t*>(msg.data()), msg.size());
+    }
+    auto data = toVector(stream);
+    // The 300 byte message takes a 2 byte varint
+    REQUIRE(data.size() == (1 + 5) + (2 + 300) + (1 + 3));
+
+    for (size_t pieceSize : {1, 2, 7, 100, 1500}) {
+        StreamFramer<VarintDecoder, 512> framer;
+        REQUIRE(feed(framer, data, pieceSize) == messages);
+    }
+}
+
+TEST_CASE("Delimiter framing") {
+    string text{"INVITE sip:bob SIP/2.0\r\nVia: x\r\n\r\nnext"};
+    vector<uint8_t> data(text.begin(), text.end());
+    for (size_t pieceSize = 1; pieceSize <= data.size(); ++pieceSize) {
+        StreamFramer<DelimiterDecoder, 64, 8> framer(DelimiterDecoder("\r\n"));
+        auto frames = feed(framer, data, pieceSize);
+        REQUIRE(frames == vector<string>{"INVITE sip:bob SIP/2.0", "Via: x", ""});
+        REQUIRE(framer.pending() == 4);
+    }
+}
+
+TEST_CASE("Partial frames stay in place until space runs low") {
+    StreamFramer<FixedHeaderDecoder<uint8_t>, 64, 8> framer;
+    uint8_t data[] = { 3, 'a', 'b', 'c', 4, 'd' };
+    auto space = framer.writable();
+    memcpy(space.data(), data, sizeof(data));
+    framer.commit(sizeof(data));
+    REQUIRE(framer.next());
+    REQUIRE(!framer.next());
+    // Plenty of room left, so the partial frame isn't moved
+    REQUIRE(framer.writable().data() == space.data() + sizeof(data));
+}
+
+TEST_CASE("Oversized frames are an error") {
+    StreamFramer<FixedHeaderDecoder<uint16_t>, 64> framer;
+    uint8_t data[] = { 0x01, 0x00 };
+    memcpy(framer.writable().data(), data, sizeof(data));
+    framer.commit(sizeof(data));
+    // Caught as soon as the header is in, not once the buffer fills
+    REQUIRE(!framer.next());
+    REQUIRE(framer.error());
+}
+
+TEST_CASE("Oversized frames are caught from the header") {
+    SECTION("4 GB declared length") {
+        StreamFramer<FixedHeaderDecoder<uint32_t>> framer;
+        uint8_t data[] = { 0xFF, 0xFF, 0xFF, 0xFF };
+        memcpy(framer.writable().data(), data, sizeof(data));
+        framer.commit(sizeof(data));
+        REQUIRE(!framer.next());
+        REQUIRE(framer.error());
+    }
+
+    SECTION("varint length") {
+        StreamFramer<VarintDecoder, 64> framer;
+        uint8_t data[] = { 0x80, 0x01 };
+        memcpy(framer.writable().data(), data, sizeof(data));
+        framer.commit(sizeof(data));
+        REQUIRE(!framer.next());
+        REQUIRE(framer.error());
+    }
+
+    SECTION("a frame that fits waits for the rest") {
+        StreamFramer<FixedHeaderDecoder<uint16_t>, 64> framer;
+        uint8_t data[] = { 0x00, 0x3E, 0xAA };
+        memcpy(framer.writable().data(), data, sizeof(data));
+        framer.commit(sizeof(data));
+        REQUIRE(!framer.next());
+        REQUIRE(!framer.error());
+    }
+}
+
+TEST_CASE("Commit rejects recv errors") {
+    StreamFramer<FixedHeaderDecoder<uint16_t>, 64> framer;
+    REQUIRE_FALSE(framer.commit(-1));
+    REQUIRE_FALSE(framer.commit(65));
+    REQUIRE(framer.writable().size() == 64);
+    REQUIRE(framer.commit(0));
+    REQUIRE(!framer.next());
+    REQUIRE(!framer.error());
+}
@@ -0,0 +1,135 @@
+#include "catch.hpp"
+
+#include "network_buffer.hpp"
+#include "tlv.hpp"
+
+#include <string_view>
+
+using namespace std;
+
+namespace {
+    span<const uint8_t> bytes(string_view str) {
+        return {reinterpret_cast<const uint8_t*>(str.data()), str.size()};
+    }
+
+    string_view str(span<const uint8_t> data) {
+        return {reinterpret_cast<const char*>(data.data()), data.size()};
+    }
+
+    struct LittleEndianFormat : TlvFormat<uint16_t, uint32_t> {
+        static constexpr bool bigEndian = false;
+    };
+}
+
+TEST_CASE("STUN attributes") {
+    NetworkBuffer<1500> buffer;
+    TlvWriter<StunAttributeFormat>::write(buffer, 0x8022, bytes("agent"));
+    TlvWriter<StunAttributeFormat>::write(buffer, 0x0006, bytes("user:name"));
+    TlvWriter<StunAttributeFormat>::write(buffer, 0x8028, bytes("\x01\x02\x03\x04"));
+
+    SECTION("values are padded to 4 bytes") {
+        REQUIRE(buffer.size() == (4 + 8) + (4 + 12) + (4 + 4));
+    }
+
+    SECTION("walk") {
+        TlvReader<StunAttributeFormat> reader(buffer);
+        auto first = reader.next();
+        REQUIRE(first);
+        REQUIRE(first->type == 0x8022);
+        REQUIRE(str(first->value) == "agent");
+        auto second = reader.next();
+        REQUIRE(second);
+        REQUIRE(second->type == 0x0006);
+        REQUIRE(str(second->value) == "user:name");
+        auto third = reader.next();
+        REQUIRE(third);
+        REQUIRE(third->value.size() == 4);
+        REQUIRE(!reader.next());
+        REQUIRE(!reader.malformed());
+        // Walking does not consume the buffer
+        REQUIRE(buffer.size() == 36);
+    }
+
+    SECTION("views point into the buffer") {
+        TlvReader<StunAttributeFormat> reader(buffer);
+        REQUIRE(reader.next()->value.data() == buffer.getBuffer() + 4);
+    }
+
+    SECTION("range-for") {
+        int count = 0;
+        TlvReader<StunAttributeFormat> reader(buffer);
+        for (const auto& attr : reader) {
+            REQUIRE(attr.value.size() > 0);
+            ++count;
+        }
+        REQUIRE(count == 3);
+    }
+
+    SECTION("truncated") {
+        TlvReader<StunAttributeFormat> reader(buffer.getBuffer(), 14);
+        REQUIRE(reader.next());
+        REQUIRE(!reader.next());
+        REQUIRE(reader.malformed());
+    }
+}
+
+TEST_CASE("DHCP options") {
+    NetworkBuffer<1500> buffer;
+    TlvWriter<DhcpOptionFormat>::write(buffer, 53, bytes("\x01"));
+    TlvWriter<DhcpOptionFormat>::writePad(buffer);
+    TlvWriter<DhcpOptionFormat>::write(buffer, 12, bytes("host"));
+    TlvWriter<DhcpOptionFormat>::writeEnd(buffer);
+    // Anything after the end option is ignored
+    TlvWriter<DhcpOptionFormat>::write(buffer, 12, bytes("junk"));
+
+    TlvReader<DhcpOptionFormat> reader(buffer);
+    auto msgType = reader.next();
+    REQUIRE(msgType->type == 53);
+    REQUIRE(msgType->value[0] == 1);
+    auto host = reader.next();
+    REQUIRE(host->type == 12);
+    REQUIRE(str(host->value) == "host");
+    REQUIRE(!reader.next());
+    REQUIRE(!reader.malformed());
+}
+
+TEST_CASE("TCP options") {
+    NetworkBuffer<1500> buffer;
+    // MSS, NOP, NOP, SACK permitted
+    TlvWriter<TcpOptionFormat>::write(buffer, 2, bytes("\x05\xb4"));
+    TlvWriter<TcpOptionFormat>::writePad(buffer);
+    TlvWriter<TcpOptionFormat>::writePad(buffer);
+    TlvWriter<TcpOptionFormat>::write(buffer, 4, {});
+    REQUIRE(buffer.size() == 8);
+    // Length includes the type and length fields
+    REQUIRE(buffer.getBuffer()[1] == 4);
+
+    TlvReader<TcpOptionFormat> reader(buffer);
+    auto mss = reader.next();
+    REQUIRE(mss->type == 2);
+    REQUIRE(loadNetwork<uint16_t>(mss->value.data()) == 1460);
+    auto sackPermitted = reader.next();
+    REQUIRE(sackPermitted->type == 4);
+    REQUIRE(sackPermitted->value.empty());
+    REQUIRE(!reader.next());
+
+    SECTION("length shorter than header") {
+        uint8_t bad[] = { 2, 1, 0, 0 };
+        TlvReader<TcpOptionFormat> badReader(bad, sizeof(bad));
+        REQUIRE(!badReader.next());
+        REQUIRE(badReader.malformed());
+    }
+}
+
+TEST_CASE("Little endian format") {
+    using Format = LittleEndianFormat;
+    NetworkBuffer<1500> buffer;
+    TlvWriter<Format>::write(buffer, 0x0102, bytes("abc"));
+    REQUIRE(buffer.getBuffer()[0] == 0x02);
+    REQUIRE(buffer.getBuffer()[2] == 3);
+
+    TlvReader<Format> reader(buffer);
+    auto tlv = reader.next();
+    REQUIRE(tlv->type == 0x0102);
+    REQUIRE(str(tlv->value) == "abc");
+}
@@ -0,0 +1,140 @@
+#include "catch.hpp"
+
+#include "udp_gro.hpp"
+#include "udp_gso.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+TEST_CASE("GRO receive") {
+    int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(receiver, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(receiver, reinterpret_cast<sockaddr*>(&addr), &len);
+    fcntl(receiver, F_SETFL, O_NONBLOCK);
+    bool groEnabled = GroReader<>::enable(receiver);
+
+    {
+        GsoWriter<> writer(sender, reinterpret_cast<sockaddr*>(&addr), sizeof(addr), 100);
+        vector<uint8_t> payload;
+        for (uint8_t i = 0; i < 40; ++i) {
+            payload.assign(100, i);
+            writer.append(payload);
+        }
+        payload.assign(30, 0xFF);
+        writer.append(payload);
+    }
+
+    auto reader = make_unique<GroReader<>>();
+    vector<vector<uint8_t>> datagrams;
+    size_t reads = 0;
+    while (reader->receive(receiver) > 0) {
+        ++reads;
+        REQUIRE(reader->remainingDatagrams() > 0);
+        while (auto datagram = reader->next()) {
+            datagrams.emplace_back(datagram->begin(), datagram->end());
+        }
+        REQUIRE(reader->remainingDatagrams() == 0);
+    }
+
+    REQUIRE(datagrams.size() == 41);
+    for (uint8_t i = 0; i < 40; ++i) {
+        REQUIRE(datagrams[i] == vector<uint8_t>(100, i));
+    }
+    REQUIRE(datagrams[40] == vector<uint8_t>(30, 0xFF));
+    if (!groEnabled || reads == datagrams.size()) {
+        WARN("datagrams were not coalesced: UDP GRO is unavailable here");
+    }
+
+    close(sender);
+    close(receiver);
+}
+
+TEST_CASE("GRO receive rejects truncated reads") {
+    int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(receiver, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(receiver, reinterpret_cast<sockaddr*>(&addr), &len);
+    fcntl(receiver, F_SETFL, O_NONBLOCK);
+
+    vector<uint8_t> payload(100, 0xAB);
+    sendto(sender, payload.data(), payload.size(), 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    sendto(sender, payload.data(), 50, 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+
+    GroReader<64> reader;
+    REQUIRE(reader.receive(receiver) == -1);
+    REQUIRE(errno == EMSGSIZE);
+    REQUIRE(reader.remainingDatagrams() == 0);
+    REQUIRE_FALSE(reader.next());
+
+    // The next datagram fits
+    REQUIRE(reader.receive(receiver) == 50);
+    auto datagram = reader.next();
+    REQUIRE(datagram);
+    REQUIRE(datagram->size() == 50);
+
+    close(sender);
+    close(receiver);
+}
+
+TEST_CASE("GRO receive alongside other ancillary data") {
+    int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(receiver, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(receiver, reinterpret_cast<sockaddr*>(&addr), &len);
+    fcntl(receiver, F_SETFL, O_NONBLOCK);
+    bool groEnabled = GroReader<>::enable(receiver);
+    int on = 1;
+    REQUIRE(setsockopt(receiver, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == 0);
+    REQUIRE(setsockopt(receiver, IPPROTO_IP, IP_PKTINFO, &on, sizeof(on)) == 0);
+
+    {
+        GsoWriter<> writer(sender, reinterpret_cast<sockaddr*>(&addr), sizeof(addr), 100);
+        vector<uint8_t> payload;
+        for (uint8_t i = 0; i < 20; ++i) {
+            payload.assign(100, i);
+            writer.append(payload);
+        }
+    }
+
+    GroReader<> reader;
+    vector<vector<uint8_t>> datagrams;
+    size_t reads = 0;
+    while (reader.receive(receiver) > 0) {
+        ++reads;
+        while (auto datagram = reader.next()) {
+            datagrams.emplace_back(datagram->begin(), datagram->end());
+        }
+    }
+    // Every read succeeded and was split, rather than a coalesced
+    // read being handed out whole
+    REQUIRE(errno == EAGAIN);
+    REQUIRE(datagrams.size() == 20);
+    for (uint8_t i = 0; i < 20; ++i) {
+        REQUIRE(datagrams[i] == vector<uint8_t>(100, i));
+    }
+    if (!groEnabled || reads == datagrams.size()) {
+        WARN("datagrams were not coalesced: UDP GRO is unavailable here");
+    }
+
+    close(sender);
+    close(receiver);
+}
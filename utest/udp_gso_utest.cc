@@ -0,0 +1,178 @@
+#include "catch.hpp"
+
+#include "udp_gso.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+namespace {
+    struct LoopbackPair {
+        int sender;
+        int receiver;
+        sockaddr_in addr{};
+
+        LoopbackPair() {
+            sender = socket(AF_INET, SOCK_DGRAM, 0);
+            receiver = socket(AF_INET, SOCK_DGRAM, 0);
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            ::bind(receiver, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+            socklen_t len = sizeof(addr);
+            getsockname(receiver, reinterpret_cast<sockaddr*>(&addr), &len);
+            fcntl(receiver, F_SETFL, O_NONBLOCK);
+        }
+
+        ~LoopbackPair() {
+            close(sender);
+            close(receiver);
+        }
+
+        vector<vector<uint8_t>> receiveAll() {
+            vector<vector<uint8_t>> datagrams;
+            uint8_t buf[65536];
+            ssize_t len;
+            while ((len = recv(receiver, buf, sizeof(buf), 0)) >= 0) {
+                datagrams.emplace_back(buf, buf + len);
+            }
+            return datagrams;
+        }
+    };
+
+    void sendDatagrams(bool useGso) {
+        LoopbackPair sockets;
+        auto writer = make_unique<GsoWriter<>>(sockets.sender,
+            reinterpret_cast<sockaddr*>(&sockets.addr), sizeof(sockets.addr), 100);
+        if (!useGso) {
+            writer->disableGso();
+        }
+        vector<uint8_t> payload(100);
+        for (uint8_t i = 0; i < 70; ++i) {
+            payload.assign(100, i);
+            REQUIRE(writer->append(payload) >= 0);
+        }
+        // The 64 segment limit forced one flush
+        REQUIRE(writer->pendingSegments() == 6);
+        // A short datagram ends the batch
+        payload.assign(10, 0xFF);
+        REQUIRE(writer->append(payload) == 7);
+        REQUIRE(writer->pendingSegments() == 0);
+
+        auto datagrams = sockets.receiveAll();
+        REQUIRE(datagrams.size() == 71);
+        for (uint8_t i = 0; i < 70; ++i) {
+            REQUIRE(datagrams[i] == vector<uint8_t>(100, i));
+        }
+        REQUIRE(datagrams[70] == vector<uint8_t>(10, 0xFF));
+        if (useGso && !writer->gsoAvailable()) {
+            WARN("UDP GSO is not supported here, the sendmmsg fallback was used");
+        }
+    }
+}
+
+TEST_CASE("GSO send") {
+    sendDatagrams(true);
+}
+
+TEST_CASE("GSO sendmmsg fallback") {
+    sendDatagrams(false);
+}
+
+TEST_CASE("GSO flush on destruction") {
+    LoopbackPair sockets;
+    {
+        GsoWriter<4096> writer(sockets.sender,
+            reinterpret_cast<sockaddr*>(&sockets.addr), sizeof(sockets.addr), 1000);
+        uint8_t payload[1000] = {};
+        writer.append(payload);
+        writer.append(payload);
+        writer.append(payload);
+        writer.append(payload);
+        // Only 4 segments fit in the buffer: the 5th flushes
+        writer.append(payload);
+        REQUIRE(writer.pendingSegments() == 1);
+    }
+    REQUIRE(sockets.receiveAll().size() == 5);
+}
+
+TEST_CASE("GSO short payload after a full batch") {
+    LoopbackPair sockets;
+    GsoWriter<4096> writer(sockets.sender,
+        reinterpret_cast<sockaddr*>(&sockets.addr), sizeof(sockets.addr), 1000);
+    uint8_t payload[1000] = {};
+    for (int i = 0; i < 4; ++i) {
+        REQUIRE(writer.append(payload) == 0);
+    }
+    // Flushes the full batch of 4, then itself
+    REQUIRE(writer.append(span<const uint8_t>(payload, 10)) == 5);
+    REQUIRE(writer.pendingSegments() == 0);
+    REQUIRE(sockets.receiveAll().size() == 5);
+}
+
+TEST_CASE("GSO empty payload after full segments") {
+    for (bool useGso : { true, false }) {
+        LoopbackPair sockets;
+        GsoWriter<4096> writer(sockets.sender,
+            reinterpret_cast<sockaddr*>(&sockets.addr), sizeof(sockets.addr), 1000);
+        if (!useGso) {
+            writer.disableGso();
+        }
+        uint8_t payload[1000] = {};
+        REQUIRE(writer.append(payload) == 0);
+        REQUIRE(writer.append(payload) == 0);
+        // Flushes the two full segments, then sends itself alone
+        REQUIRE(writer.append(span<const uint8_t>()) == 3);
+        REQUIRE(writer.pendingSegments() == 0);
+
+        auto datagrams = sockets.receiveAll();
+        REQUIRE(datagrams.size() == 3);
+        REQUIRE(datagrams[0].size() == 1000);
+        REQUIRE(datagrams[1].size() == 1000);
+        REQUIRE(datagrams[2].empty());
+    }
+}
+
+namespace {
+    // Queues a batch GSO refuses: more segments than the kernel allows
+    struct BadBatchWriter : GsoWriter<4096> {
+        using GsoWriter<4096>::GsoWriter;
+
+        ssize_t sendBadBatch() {
+            uint8_t payload[200] = {};
+            _buffer.write(payload, sizeof(payload));
+            _segmentSize = 1;
+            _segments = 2;
+            ssize_t res = flush();
+            _segmentSize = 100;
+            return res;
+        }
+    };
+}
+
+TEST_CASE("GSO survives one rejected batch") {
+    LoopbackPair sockets;
+    BadBatchWriter writer(sockets.sender,
+        reinterpret_cast<sockaddr*>(&sockets.addr), sizeof(sockets.addr), 100);
+    if (!writer.gsoAvailable()) {
+        WARN("UDP GSO is not supported here");
+        return;
+    }
+    // Sent with sendmmsg instead
+    REQUIRE(writer.sendBadBatch() == 2);
+    REQUIRE(writer.gsoAvailable());
+    // A good batch resets the count
+    uint8_t payload[100] = {};
+    writer.append(payload);
+    REQUIRE(writer.append(span<const uint8_t>(payload, 10)) == 2);
+    REQUIRE(writer.sendBadBatch() == 2);
+    REQUIRE(writer.gsoAvailable());
+    // but rejections in a row turn it off
+    REQUIRE(writer.sendBadBatch() == 2);
+    REQUIRE_FALSE(writer.gsoAvailable());
+    REQUIRE(sockets.receiveAll().size() == 2 + 2 + 2 + 2);
+}
@@ -3,7 +3,16 @@
 
 #include "network_buffer.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
@@ -39,6 +48,14 @@ TEST_CASE("Basic read/write tests") {
         REQUIRE(readVal == writeVal);
     }
 
+    SECTION("uint64_t") {
+        uint64_t writeVal = 0xDEADBEEFCAFEF00D;
+        buffer.write(writeVal);
+        REQUIRE(buffer.getBuffer()[0] == 0xDE);
+        uint64_t readVal = buffer.read64();
+        REQUIRE(readVal == writeVal);
+    }
+
     SECTION("buffer") {
         NetworkBuffer<4> buffer;
         uint8_t writeVal[4] = { 0xDE, 0xAD, 0xBE, 0XEF };
@@ -174,6 +191,143 @@ TEST_CASE("Direct read/write") {
     }
 }
 
+TEST_CASE("Fixed size read/write") {
+    NetworkBuffer<32> buffer;
+    const uint8_t mac[6] = { 0x02, 0x42, 0xAC, 0x11, 0x00, 0x02 };
+    const std::array<uint8_t, 4> magic = { 0x21, 0x12, 0xA4, 0x42 };
+    const uint8_t id[12] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+
+    buffer.write(mac);
+    buffer.write(magic);
+    buffer.write(std::span<const uint8_t, 12>(id));
+    REQUIRE(buffer.size() == 22);
+    REQUIRE(buffer.remainingCapacity() == 10);
+
+    std::span<uint8_t, 6> readMac = buffer.read<6>();
+    REQUIRE(std::equal(readMac.begin(), readMac.end(), mac));
+    REQUIRE(buffer.read32() == 0x2112A442);
+    auto readId = buffer.read<12>();
+    static_assert(decltype(readId)::extent == 12);
+    REQUIRE(std::equal(readId.begin(), readId.end(), id));
+    REQUIRE(buffer.empty());
+
+    // Fixed size writes mix with the other kinds
+    buffer.compact();
+    buffer.write(static_cast<uint16_t>(7));
+    buffer.write(mac);
+    buffer.write(mac, 2);
+    REQUIRE(buffer.read16() == 7);
+    REQUIRE(buffer.read<8>()[7] == 0x42);
+
+    // What read<N> returns can be written straight into another buffer
+    NetworkBuffer<32> other;
+    buffer.write(magic);
+    other.write(buffer.read<4>());
+    REQUIRE(other.size() == 4);
+    REQUIRE(other.read32() == 0x2112A442);
+}
+
+TEST_CASE("Peek, mark and rewind") {
+    NetworkBuffer<64> buffer;
+    buffer.write(static_cast<uint8_t>(0x80));
+    buffer.write(static_cast<uint16_t>(0x1234));
+    buffer.write(static_cast<uint32_t>(0xDEADBEEF));
+    buffer.write(static_cast<uint64_t>(42));
+
+    SECTION("peek") {
+        REQUIRE(buffer.peek<uint8_t>() == 0x80);
+        REQUIRE(buffer.peek<uint16_t>() == 0x8012);
+        REQUIRE(buffer.size() == 15);
+        REQUIRE(buffer.read8() == 0x80);
+        REQUIRE(buffer.peek<uint16_t>() == 0x1234);
+        REQUIRE(buffer.read16() == 0x1234);
+        REQUIRE(buffer.peek<uint32_t>() == 0xDEADBEEF);
+        buffer.read32();
+        REQUIRE(buffer.peek<uint64_t>() == 42);
+        REQUIRE(buffer.read64() == 42);
+    }
+    SECTION("rewind a read") {
+        auto mark = buffer.mark();
+        REQUIRE(buffer.read8() == 0x80);
+        REQUIRE(buffer.read16() == 0x1234);
+        buffer.rewind(mark);
+        REQUIRE(buffer.size() == 15);
+        REQUIRE(buffer.read8() == 0x80);
+    }
+    SECTION("rewind a write") {
+        buffer.read8();
+        auto mark = buffer.mark();
+        buffer.write(static_cast<uint32_t>(7));
+        REQUIRE(buffer.size() == 18);
+        buffer.rewind(mark);
+        REQUIRE(buffer.size() == 14);
+        REQUIRE(buffer.remainingCapacity() == 64 - 15);
+        REQUIRE(buffer.read16() == 0x1234);
+    }
+    SECTION("rewind one cursor") {
+        auto mark = buffer.mark();
+        buffer.read8();
+        buffer.write(static_cast<uint8_t>(9));
+        buffer.rewindRead(mark);
+        REQUIRE(buffer.size() == 16);
+        REQUIRE(buffer.read8() == 0x80);
+
+        buffer.rewindWrite(mark);
+        REQUIRE(buffer.size() == 14);
+        REQUIRE(buffer.read16() == 0x1234);
+    }
+    SECTION("clear") {
+        buffer.read16();
+        buffer.clear();
+        REQUIRE(buffer.empty());
+        REQUIRE(buffer.size() == 0);
+        REQUIRE(buffer.remainingCapacity() == 64);
+        buffer.write(static_cast<uint16_t>(5));
+        REQUIRE(buffer.read16() == 5);
+    }
+}
+
+TEST_CASE("Streaming copies") {
+    vector<uint8_t> src(9000);
+    for (size_t i = 0; i < src.size(); ++i) {
+        src[i] = static_cast<uint8_t>(i * 7 + 3);
+    }
+
+    SECTION("any alignment and length") {
+        vector<uint8_t> dst(9100);
+        for (size_t offset : { 0, 1, 17, 63 }) {
+            for (size_t len : { 0, 1, 100, 1023, 1024, 1025, 4096 + 13, 9000 - 63 }) {
+                fill(dst.begin(), dst.end(), 0);
+                copyStreaming(dst.data() + offset, src.data(), len);
+                REQUIRE(memcmp(dst.data() + offset, src.data(), len) == 0);
+                // Nothing outside the range is touched
+                REQUIRE(count(dst.begin(), dst.begin() + offset, 0) == static_cast<ptrdiff_t>(offset));
+                REQUIRE(dst[offset + len] == 0);
+            }
+        }
+    }
+    SECTION("nothing to copy") {
+        copyStreaming(nullptr, nullptr, 0);
+        NetworkBuffer<64> small;
+        small.writeStreaming(nullptr, 0);
+        small.readStreaming(nullptr, 0);
+        REQUIRE(small.empty());
+    }
+    SECTION("write and read") {
+        auto buffer = make_unique<NetworkBuffer<9216>>();
+        buffer->write(static_cast<uint16_t>(42));
+        buffer->writeStreaming(src.data(), src.size());
+        REQUIRE(buffer->size() == 2 + src.size());
+        REQUIRE(buffer->read16() == 42);
+
+        vector<uint8_t> out(src.size());
+        buffer->readStreaming(out.data(), 10);
+        buffer->readStreaming(out.data() + 10, src.size() - 10);
+        REQUIRE(buffer->empty());
+        REQUIRE(out == src);
+    }
+}
+
 TEST_CASE("Size corner cases") {
     NetworkBuffer<4> buf;
 
@@ -182,3 +336,197 @@ TEST_CASE("Size corner cases") {
     // Make sure no assert was hit
     REQUIRE(true);
 }
+
+TEST_CASE("Length-prefixed fields") {
+    NetworkBuffer<1500> buffer;
+
+    SECTION("round trip") {
+        buffer.writeLenPrefixed<uint8_t>(std::string_view{"key"});
+        buffer.writeLenPrefixed<uint16_t>(std::string_view{"value"});
+        uint8_t blob[3] = { 0xDE, 0xAD, 0xBE };
+        buffer.writeLenPrefixed<uint32_t>(std::span<const uint8_t>(blob, 3));
+        REQUIRE(buffer.size() == (1 + 3) + (2 + 5) + (4 + 3));
+
+        REQUIRE(buffer.readLenPrefixedString<uint8_t>() == "key");
+        REQUIRE(buffer.readLenPrefixedString<uint16_t>() == "value");
+        auto view = buffer.readLenPrefixed<uint32_t>();
+        REQUIRE(view);
+        REQUIRE(view->size() == 3);
+        REQUIRE(memcmp(view->data(), blob, 3) == 0);
+        REQUIRE(buffer.empty() == true);
+    }
+
+    SECTION("empty fields") {
+        buffer.writeLenPrefixed<uint8_t>(std::string_view{});
+        buffer.writeLenPrefixed<uint16_t>(std::span<const uint8_t>());
+        buffer.write(nullptr, 0);
+        REQUIRE(buffer.size() == 1 + 2);
+        REQUIRE(buffer.readLenPrefixedString<uint8_t>()->empty());
+        REQUIRE(buffer.readLenPrefixed<uint16_t>()->empty());
+        REQUIRE(buffer.empty());
+    }
+
+    SECTION("view points into the buffer") {
+        buffer.writeLenPrefixed<uint16_t>(std::string_view{"abc"});
+        const uint8_t* start = buffer.getBuffer();
+        auto view = buffer.readLenPrefixed<uint16_t>();
+        REQUIRE(view->data() == start + sizeof(uint16_t));
+    }
+
+    SECTION("length longer than the remaining data") {
+        buffer.write(static_cast<uint16_t>(10));
+        buffer.write(reinterpret_cast<const uint8_t*>("abc"), 3);
+        REQUIRE(!buffer.readLenPrefixed<uint16_t>());
+        REQUIRE(!buffer.readLenPrefixedString<uint16_t>());
+        REQUIRE(buffer.size() == 2 + 3);
+        REQUIRE(buffer.read16() == 10);
+    }
+
+    SECTION("truncated length") {
+        buffer.write(static_cast<uint8_t>(0));
+        REQUIRE(!buffer.readLenPrefixed<uint16_t>());
+        REQUIRE(buffer.size() == 1);
+    }
+
+    SECTION("length is in network order") {
+        buffer.writeLenPrefixed<uint16_t>(std::string_view{"abc"});
+        REQUIRE(buffer.read16() == 3);
+    }
+
+    SECTION("back-patched nested fields") {
+        buffer.writeLenPrefixed<uint16_t>([](auto& buf) {
+            buf.write(static_cast<uint32_t>(0xDEADBEEF));
+            buf.template writeLenPrefixed<uint8_t>([](auto& inner) {
+                inner.write(static_cast<uint16_t>(42));
+            });
+        });
+        REQUIRE(buffer.size() == 2 + 4 + 1 + 2);
+        REQUIRE(buffer.read16() == 7);
+        REQUIRE(buffer.read32() == 0xDEADBEEF);
+        REQUIRE(buffer.read8() == 2);
+        REQUIRE(buffer.read16() == 42);
+    }
+}
+
+TEST_CASE("Searching") {
+    NetworkBuffer<1500> buffer;
+    string request{"GET / HTTP/1.1\r\nHost: example.com\r\nAccept: */*\r\n\r\nbody"};
+    buffer.write(reinterpret_cast<const uint8_t*>(request.data()), request.size());
+
+    SECTION("find byte") {
+        REQUIRE(buffer.find(':') == request.find(':'));
+        REQUIRE(buffer.find('#') == buffer.npos);
+    }
+
+    SECTION("find substring") {
+        REQUIRE(buffer.find("\r\n") == request.find("\r\n"));
+        REQUIRE(buffer.find("\r\n\r\n") == request.find("\r\n\r\n"));
+        REQUIRE(buffer.find("HTTP/2") == buffer.npos);
+    }
+
+    SECTION("find any") {
+        REQUIRE(buffer.findAny(":*") == request.find_first_of(":*"));
+        REQUIRE(buffer.findAny("#$") == buffer.npos);
+        // Sets too large to vectorize
+        REQUIRE(buffer.findAny("0123456789:*") == request.find_first_of("0123456789:*"));
+    }
+
+    SECTION("offsets are relative to the read position") {
+        buffer.read(4);
+        REQUIRE(buffer.find('/') == 0);
+    }
+
+    SECTION("matches across vector boundaries") {
+        // Make sure every position is covered by the vector loops
+        // and the scalar tail
+        for (size_t len = 1; len < 100; ++len) {
+            NetworkBuffer<1500> buf;
+            string data(len - 1, 'a');
+            data += "\r\n";
+            buf.write(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+            REQUIRE(buf.find('\r') == len - 1);
+            REQUIRE(buf.find("\r\n") == len - 1);
+            REQUIRE(buf.findAny("\n\r") == len - 1);
+        }
+    }
+
+    SECTION("read until") {
+        auto line = buffer.readUntil("\r\n");
+        REQUIRE(line);
+        REQUIRE(string((char*)line->data(), line->size()) == "GET / HTTP/1.1");
+        auto name = buffer.readUntil(':');
+        REQUIRE(string((char*)name->data(), name->size()) == "Host");
+        buffer.readUntil("\r\n\r\n");
+        REQUIRE(buffer.size() == 4);
+        // Nothing is consumed when the delimiter isn't there
+        REQUIRE(!buffer.readUntil("\r\n"));
+        REQUIRE(buffer.size() == 4);
+    }
+}
+
+TEST_CASE("Copying and moving") {
+    static_assert(std::is_trivially_copyable_v<NetworkBuffer<1500>>);
+    static_assert(alignof(NetworkBuffer<1500>) == 64);
+    static_assert(sizeof(NetworkBuffer<1500>) == 1536);
+    static_assert(sizeof(NetworkBuffer<1500>::Index) == 2);
+    static_assert(sizeof(NetworkBuffer<65536>::Index) == 4);
+
+    NetworkBuffer<64> buffer;
+    buffer.write(static_cast<uint32_t>(0x01020304));
+    buffer.write(static_cast<uint32_t>(0x05060708));
+    buffer.read8();
+
+    auto check = [](NetworkBuffer<64>& copy) {
+        REQUIRE(copy.size() == 7);
+        REQUIRE(copy.remainingCapacity() == 56);
+        REQUIRE(copy.read8() == 0x02);
+        copy.write(static_cast<uint8_t>(0x09));
+        REQUIRE(copy.size() == 7);
+    };
+
+    SECTION("copies are independent") {
+        NetworkBuffer<64> copy = buffer;
+        REQUIRE(copy.getBuffer() != buffer.getBuffer());
+        check(copy);
+        // The original is untouched
+        REQUIRE(buffer.size() == 7);
+        REQUIRE(buffer.read8() == 0x02);
+    }
+    SECTION("assignment") {
+        NetworkBuffer<64> other;
+        other.write(static_cast<uint8_t>(1));
+        other = buffer;
+        check(other);
+    }
+    SECTION("move") {
+        NetworkBuffer<64> moved = std::move(buffer);
+        check(moved);
+    }
+    SECTION("vector growth relocates buffers") {
+        vector<NetworkBuffer<64>> buffers;
+        for (uint8_t i = 0; i < 100; ++i) {
+            buffers.push_back(buffer);
+            buffers.back().write(i);
+        }
+        for (uint8_t i = 0; i < 100; ++i) {
+            REQUIRE(buffers[i].size() == 8);
+            REQUIRE(buffers[i].read32() == 0x02030405);
+            buffers[i].read(3);
+            REQUIRE(buffers[i].read8() == i);
+        }
+    }
+    SECTION("memcpy") {
+        void* raw = aligned_alloc(alignof(NetworkBuffer<64>), sizeof(NetworkBuffer<64>));
+        memcpy(raw, &buffer, sizeof(buffer));
+        check(*static_cast<NetworkBuffer<64>*>(raw));
+        free(raw);
+    }
+    SECTION("length slots survive a move") {
+        NetworkBuffer<64> source;
+        auto slot = source.beginLenPrefixed<uint16_t>();
+        source.write(static_cast<uint32_t>(0));
+        NetworkBuffer<64> moved = source;
+        moved.endLenPrefixed(slot);
+        REQUIRE(moved.read16() == 4);
+    }
+}
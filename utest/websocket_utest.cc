@@ -0,0 +1,145 @@
+#include "catch.hpp"
+
+#include "network_buffer.hpp"
+#include "websocket.hpp"
+
+#include <vector>
+
+using namespace std;
+
+TEST_CASE("WebSocket headers") {
+    NetworkBuffer<1500> buffer;
+
+    SECTION("header sizes") {
+        for (auto [len, size] : vector<pair<uint64_t, size_t>>{{0, 2}, {125, 2}, {126, 4}, {65535, 4}, {65536, 10}}) {
+            WebSocketFrameHeader header;
+            header.payloadLength = len;
+            NetworkBuffer<16> buf;
+            WebSocketCodec::writeHeader(buf, header);
+            REQUIRE(buf.size() == size);
+            REQUIRE(header.size() == size);
+            auto parsed = WebSocketCodec::readHeader(buf);
+            REQUIRE(parsed);
+            REQUIRE(parsed->payloadLength == len);
+            REQUIRE(buf.empty());
+        }
+    }
+
+    SECTION("round trip") {
+        WebSocketFrameHeader header;
+        header.fin = false;
+        header.opcode = WebSocketOpcode::Text;
+        header.masked = true;
+        header.maskingKey = {0x37, 0xfa, 0x21, 0x3d};
+        header.payloadLength = 300;
+        WebSocketCodec::writeHeader(buffer, header);
+        REQUIRE(buffer.size() == 8);
+        auto parsed = WebSocketCodec::readHeader(buffer);
+        REQUIRE(!parsed->fin);
+        REQUIRE(parsed->opcode == WebSocketOpcode::Text);
+        REQUIRE(parsed->masked);
+        REQUIRE(parsed->maskingKey == header.maskingKey);
+        REQUIRE(parsed->payloadLength == 300);
+    }
+
+    SECTION("incomplete header is not consumed") {
+        uint8_t partial[] = { 0x82, 0xFE, 0x01 };
+        buffer.write(partial, sizeof(partial));
+        REQUIRE(!WebSocketCodec::readHeader(buffer));
+        REQUIRE(buffer.size() == 3);
+    }
+}
+
+TEST_CASE("WebSocket frames") {
+    NetworkBuffer<1500> buffer;
+
+    SECTION("RFC 6455 masked Hello example") {
+        uint8_t frame[] = { 0x81, 0x85, 0x37, 0xfa, 0x21, 0x3d, 0x7f, 0x9f, 0x4d, 0x51, 0x58 };
+        buffer.write(frame, sizeof(frame));
+        WebSocketFrameHeader header;
+        auto payload = WebSocketCodec::readFrame(buffer, header);
+        REQUIRE(payload);
+        REQUIRE(string(reinterpret_cast<char*>(payload->data()), payload->size()) == "Hello");
+        REQUIRE(header.opcode == WebSocketOpcode::Text);
+        REQUIRE(buffer.empty());
+    }
+
+    SECTION("masked round trip") {
+        vector<uint8_t> payload(1000);
+        for (size_t i = 0; i < payload.size(); ++i) {
+            payload[i] = static_cast<uint8_t>(i * 7);
+        }
+        WebSocketFrameHeader header;
+        header.masked = true;
+        header.maskingKey = {1, 2, 3, 4};
+        WebSocketCodec::writeFrame(buffer, header, payload);
+        REQUIRE(buffer.size() == 8 + 1000);
+        // The payload on the wire is masked
+        REQUIRE(buffer.getBuffer()[8] == (payload[0] ^ 1));
+
+        WebSocketFrameHeader parsed;
+        auto read = WebSocketCodec::readFrame(buffer, parsed);
+        REQUIRE(read);
+        REQUIRE(vector<uint8_t>(read->begin(), read->end()) == payload);
+    }
+
+    SECTION("incomplete payload is not consumed") {
+        uint8_t frame[] = { 0x82, 0x05, 'a', 'b' };
+        buffer.write(frame, sizeof(frame));
+        WebSocketFrameHeader header;
+        REQUIRE(!WebSocketCodec::readFrame(buffer, header));
+        REQUIRE(buffer.size() == 4);
+    }
+}
+
+TEST_CASE("WebSocket masking") {
+    array<uint8_t, 4> key = {0xA1, 0xB2, 0xC3, 0xD4};
+    for (size_t len = 0; len < 80; ++len) {
+        vector<uint8_t> data(len);
+        for (size_t i = 0; i < len; ++i) {
+            data[i] = static_cast<uint8_t>(i);
+        }
+        for (size_t split = 0; split <= len; split += 5) {
+            auto masked = data;
+            // Mask in two pieces, continuing the key where the first left off
+            size_t offset = WebSocketCodec::mask({masked.data(), split}, key);
+            WebSocketCodec::mask({masked.data() + split, len - split}, key, offset);
+            for (size_t i = 0; i < len; ++i) {
+                REQUIRE(masked[i] == (data[i] ^ key[i % 4]));
+            }
+        }
+    }
+}
+
+TEST_CASE("WebSocket stream framing") {
+    NetworkBuffer<1500> stream;
+    WebSocketFrameHeader header;
+    uint8_t payload[200] = {};
+    WebSocketCodec::writeFrame(stream, header, {payload, 10});
+    WebSocketCodec::writeFrame(stream, header, {payload, 200});
+
+    StreamFramer<WebSocketDecoder, 1024> framer;
+    auto space = framer.writable();
+    memcpy(space.data(), stream.getBuffer(), 20);
+    framer.commit(20);
+    REQUIRE(framer.next()->size() == 10);
+    REQUIRE(!framer.next());
+    space = framer.writable();
+    memcpy(space.data(), stream.getBuffer() + 20, stream.size() - 20);
+    framer.commit(stream.size() - 20);
+    REQUIRE(framer.next()->size() == 200);
+}
+
+TEST_CASE("WebSocket oversized frames are caught from the header") {
+    NetworkBuffer<1500> stream;
+    WebSocketFrameHeader header;
+    header.payloadLength = 1ull << 40;
+    WebSocketCodec::writeHeader(stream, header);
+
+    StreamFramer<WebSocketDecoder, 1024> framer;
+    auto space = framer.writable();
+    memcpy(space.data(), stream.getBuffer(), stream.size());
+    framer.commit(stream.size());
+    REQUIRE(!framer.next());
+    REQUIRE(framer.error());
+}
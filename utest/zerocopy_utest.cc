@@ -0,0 +1,144 @@
+#include "catch.hpp"
+
+#include "zerocopy.hpp"
+#include "network_buffer.hpp"
+#include "test_sockets.hpp"
+
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+TEST_CASE("Zero copy send over loopback TCP") {
+    using Buffer = NetworkBuffer<16384>;
+    auto [sender, receiver] = tcpPair();
+    if (!ZeroCopyWriter<Buffer>::enable(sender)) {
+        WARN("SO_ZEROCOPY is unavailable here");
+        close(sender);
+        close(receiver);
+        return;
+    }
+
+    BufferPool<Buffer> pool(8);
+    ZeroCopyWriter<Buffer> writer(sender);
+    REQUIRE(writer.zeroCopyEnabled());
+    vector<uint8_t> expected;
+    vector<uint8_t> received;
+    for (uint8_t i = 0; i < 20; ++i) {
+        auto buffer = pool.acquire();
+        if (!buffer) {
+            // Wait for the kernel to give some back
+            pollfd pfd{sender, 0, 0};
+            poll(&pfd, 1, 1000);
+            writer.reap();
+            buffer = pool.acquire();
+        }
+        REQUIRE(buffer);
+        vector<uint8_t> payload(10000, i);
+        (*buffer)->write(payload.data(), payload.size());
+        expected.insert(expected.end(), payload.begin(), payload.end());
+        REQUIRE(writer.send(std::move(*buffer)) == 10000);
+
+        // Keep the receive side drained so sends never block
+        vector<uint8_t> chunk(65536);
+        ssize_t res;
+        while ((res = recv(receiver, chunk.data(), chunk.size(), MSG_DONTWAIT)) > 0) {
+            received.insert(received.end(), chunk.begin(), chunk.begin() + res);
+        }
+    }
+
+    for (int i = 0; i < 100 && writer.inFlight() > 0; ++i) {
+        pollfd pfd{sender, 0, 0};
+        poll(&pfd, 1, 10);
+        writer.reap();
+    }
+    vector<uint8_t> chunk(65536);
+    ssize_t res;
+    while (received.size() < expected.size() && (res = recv(receiver, chunk.data(), chunk.size(), 0)) > 0) {
+        received.insert(received.end(), chunk.begin(), chunk.begin() + res);
+    }
+    REQUIRE(received == expected);
+    REQUIRE(writer.inFlight() == 0);
+    REQUIRE(pool.available() == 8);
+    REQUIRE(writer.completions() == 20);
+    // Loopback always copies
+    REQUIRE(writer.copiedCompletions() == 20);
+
+    close(sender);
+    close(receiver);
+}
+
+TEST_CASE("Zero copy writer drains on destruction") {
+    using Buffer = NetworkBuffer<16384>;
+    auto [sender, receiver] = tcpPair();
+    if (!ZeroCopyWriter<Buffer>::enable(sender)) {
+        WARN("SO_ZEROCOPY is unavailable here");
+        close(sender);
+        close(receiver);
+        return;
+    }
+
+    BufferPool<Buffer> pool(4);
+    {
+        ZeroCopyWriter<Buffer> writer(sender);
+        for (int i = 0; i < 4; ++i) {
+            auto buffer = pool.acquire();
+            vector<uint8_t> payload(10000, static_cast<uint8_t>(i));
+            (*buffer)->write(payload.data(), payload.size());
+            REQUIRE(writer.send(std::move(*buffer)) == 10000);
+        }
+        REQUIRE(pool.available() < 4);
+    }
+    // Every buffer came back, after its completion
+    REQUIRE(pool.available() == 4);
+
+    vector<uint8_t> chunk(65536);
+    size_t received = 0;
+    ssize_t res;
+    while (received < 40000 && (res = recv(receiver, chunk.data(), chunk.size(), 0)) > 0) {
+        received += res;
+    }
+    REQUIRE(received == 40000);
+
+    close(sender);
+    close(receiver);
+}
+
+TEST_CASE("Zero copy writer without SO_ZEROCOPY") {
+    using Buffer = NetworkBuffer<16384>;
+    auto [sender, receiver] = tcpPair();
+
+    BufferPool<Buffer> pool(4);
+    auto start = chrono::steady_clock::now();
+    {
+        ZeroCopyWriter<Buffer> writer(sender);
+        REQUIRE_FALSE(writer.zeroCopyEnabled());
+        for (int i = 0; i < 4; ++i) {
+            auto buffer = pool.acquire();
+            vector<uint8_t> payload(10000, static_cast<uint8_t>(i));
+            (*buffer)->write(payload.data(), payload.size());
+            REQUIRE(writer.send(std::move(*buffer)) == 10000);
+        }
+        // Copied sends are done with straight away
+        REQUIRE(writer.inFlight() == 0);
+        REQUIRE(pool.available() == 4);
+    }
+    // and there's nothing to wait for
+    REQUIRE(chrono::steady_clock::now() - start < chrono::milliseconds(500));
+
+    vector<uint8_t> chunk(65536);
+    size_t received = 0;
+    ssize_t res;
+    while (received < 40000 && (res = recv(receiver, chunk.data(), chunk.size(), 0)) > 0) {
+        received += res;
+    }
+    REQUIRE(received == 40000);
+
+    close(sender);
+    close(receiver);
+}